@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+namespace automat {
+
+// Compact set of pointers, used for the edges of the object graph (connections & observers of each
+// Location).
+//
+// Most Locations have only a handful of edges so up to kInline pointers are stored inline, without
+// any allocation. Larger sets move to a sorted array on the heap. Elements are ordered by their
+// key (see `SelfKey` & `ConnectionKey`), so lookups are binary searches and elements with the same
+// key are adjacent - `equal_range` works like in a std::unordered_multiset.
+//
+// Unlike std containers, `equal_range` of a missing key returns an empty range which may not be
+// located at `end()`.
+template <typename T, typename Key, int kInline = 2>
+struct AdjacencySet {
+  using iterator = T* const*;
+
+  AdjacencySet() = default;
+  AdjacencySet(const AdjacencySet&) = delete;
+  AdjacencySet& operator=(const AdjacencySet&) = delete;
+  ~AdjacencySet() { Free(); }
+
+  iterator begin() const { return Data(); }
+  iterator end() const { return Data() + count; }
+  bool empty() const { return count == 0; }
+  size_t size() const { return count; }
+  T* back() const { return Data()[count - 1]; }
+
+  // First element with the given key or `end()`.
+  iterator find(const void* key) const {
+    iterator it = LowerBound(key);
+    return it != end() && Key()(*it) == key ? it : end();
+  }
+
+  std::pair<iterator, iterator> equal_range(const void* key) const {
+    return {LowerBound(key), UpperBound(key)};
+  }
+
+  bool contains(const void* key) const { return find(key) != end(); }
+
+  // Adds the element, even if some other element has the same key.
+  void emplace(T* value) { InsertAt(UpperBound(Key()(value)) - begin(), value); }
+
+  // Adds the element unless some element already has the same key. Returns true if it was added.
+  bool insert(T* value) {
+    const void* key = Key()(value);
+    iterator it = LowerBound(key);
+    if (it != end() && Key()(*it) == key) {
+      return false;
+    }
+    InsertAt(it - begin(), value);
+    return true;
+  }
+
+  // Removes the given element (compared by address). Returns the number of removed elements.
+  size_t erase(T* value) {
+    auto [first, last] = equal_range(Key()(value));
+    // Elements are usually removed in reverse order of insertion, so start from the back.
+    for (iterator it = last; it != first;) {
+      --it;
+      if (*it == value) {
+        EraseAt(it - begin());
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  size_t HeapBytes() const { return OnHeap() ? capacity * sizeof(T*) : 0; }
+
+ private:
+  union {
+    T* inline_items[kInline] = {};
+    T** heap;
+  };
+  uint32_t count = 0;
+  uint32_t capacity = kInline;
+
+  bool OnHeap() const { return capacity > kInline; }
+  T* const* Data() const { return OnHeap() ? heap : inline_items; }
+  T** Data() { return OnHeap() ? heap : inline_items; }
+
+  static bool Less(const void* a, const void* b) { return std::less<const void*>()(a, b); }
+
+  iterator LowerBound(const void* key) const {
+    return std::lower_bound(begin(), end(), key,
+                            [](T* element, const void* key) { return Less(Key()(element), key); });
+  }
+
+  iterator UpperBound(const void* key) const {
+    return std::upper_bound(begin(), end(), key,
+                            [](const void* key, T* element) { return Less(key, Key()(element)); });
+  }
+
+  void InsertAt(size_t index, T* value) {
+    if (count == capacity) {
+      uint32_t new_capacity = capacity * 2;
+      T** new_heap = new T*[new_capacity];
+      memcpy(new_heap, Data(), count * sizeof(T*));
+      Free();
+      heap = new_heap;
+      capacity = new_capacity;
+    }
+    T** data = Data();
+    memmove(data + index + 1, data + index, (count - index) * sizeof(T*));
+    data[index] = value;
+    ++count;
+  }
+
+  void EraseAt(size_t index) {
+    T** data = Data();
+    memmove(data + index, data + index + 1, (count - index - 1) * sizeof(T*));
+    --count;
+    if (count == 0 && OnHeap()) {
+      // Release the memory of sets that were emptied.
+      Free();
+      capacity = kInline;
+      inline_items[0] = nullptr;
+    }
+  }
+
+  void Free() {
+    if (OnHeap()) {
+      delete[] heap;
+    }
+  }
+};
+
+// Key of the sets that hold each element at most once (observers).
+struct SelfKey {
+  const void* operator()(const void* element) const { return element; }
+};
+
+}  // namespace automat
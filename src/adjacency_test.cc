@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "adjacency.hh"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace automat;
+
+struct Edge {
+  int key;
+};
+
+struct EdgeKey {
+  const void* operator()(const Edge* edge) const { return &kKeys[edge->key]; }
+  static const int kKeys[4];
+};
+
+const int EdgeKey::kKeys[4] = {};
+
+using EdgeSet = AdjacencySet<Edge, EdgeKey>;
+
+static std::vector<Edge*> Range(std::pair<EdgeSet::iterator, EdgeSet::iterator> range) {
+  return std::vector<Edge*>(range.first, range.second);
+}
+
+TEST(AdjacencySetTest, SmallSetsDontAllocate) {
+  EXPECT_EQ(24, sizeof(EdgeSet));
+  Edge a{0}, b{1};
+  EdgeSet set;
+  set.emplace(&a);
+  set.emplace(&b);
+  EXPECT_EQ(0, set.HeapBytes());
+  EXPECT_EQ(2, set.size());
+}
+
+TEST(AdjacencySetTest, GroupsElementsByKey) {
+  std::vector<Edge> edges = {{2}, {1}, {2}, {3}, {1}, {2}};
+  EdgeSet set;
+  for (auto& edge : edges) {
+    set.emplace(&edge);
+  }
+  EXPECT_EQ(6, set.size());
+  EXPECT_GT(set.HeapBytes(), 0);
+  // Elements with the same key are kept in the order of insertion.
+  EXPECT_EQ(Range(set.equal_range(&EdgeKey::kKeys[2])),
+            (std::vector<Edge*>{&edges[0], &edges[2], &edges[5]}));
+  EXPECT_EQ(&edges[1], *set.find(&EdgeKey::kKeys[1]));
+  EXPECT_EQ(set.end(), set.find(&EdgeKey::kKeys[0]));
+  auto missing = set.equal_range(&EdgeKey::kKeys[0]);
+  EXPECT_EQ(missing.first, missing.second);
+
+  EXPECT_EQ(1, set.erase(&edges[2]));
+  EXPECT_EQ(0, set.erase(&edges[2]));
+  EXPECT_EQ(Range(set.equal_range(&EdgeKey::kKeys[2])),
+            (std::vector<Edge*>{&edges[0], &edges[5]}));
+  while (!set.empty()) {
+    set.erase(set.back());
+  }
+  EXPECT_EQ(0, set.HeapBytes());
+}
+
+TEST(AdjacencySetTest, InsertKeepsElementsUnique) {
+  int a, b;
+  AdjacencySet<int, SelfKey> set;
+  EXPECT_TRUE(set.insert(&a));
+  EXPECT_TRUE(set.insert(&b));
+  EXPECT_FALSE(set.insert(&a));
+  EXPECT_EQ(2, set.size());
+  EXPECT_TRUE(set.contains(&a));
+  set.erase(&a);
+  EXPECT_FALSE(set.contains(&a));
+}
@@ -0,0 +1,182 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "arena.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace automat {
+
+thread_local Arena* Arena::current = nullptr;
+
+namespace {
+
+// Precedes every block carved out of an arena chunk. Blocks allocated on the heap have no header.
+struct alignas(16) Header {
+  Arena* arena;
+  uint32_t size_class;
+};
+
+// Marks the `kChunkSize`-aligned regions of memory that are arena chunks, so that `Free` can tell
+// the arena blocks apart from the header-less heap blocks.
+//
+// Two levels of bitmaps, indexed by `address / kChunkSize`. Leaves are allocated when the first
+// chunk in their part of the address space is created & never freed. Lookups don't take any locks.
+struct ChunkMap {
+  static constexpr int kAddressBits = 48;
+  static constexpr int kChunkBits = 16;  // log2(Arena::kChunkSize)
+  static constexpr int kLeafBits = 16;
+  static constexpr int kRootBits = kAddressBits - kChunkBits - kLeafBits;
+  static_assert(size_t(1) << kChunkBits == Arena::kChunkSize);
+
+  struct Leaf {
+    std::atomic<uint64_t> bits[(1 << kLeafBits) / 64];
+  };
+
+  std::atomic<Leaf*> root[1 << kRootBits] = {};
+  std::mutex leaves_mutex;
+
+  bool Contains(const void* ptr) {
+    uintptr_t chunk = reinterpret_cast<uintptr_t>(ptr) >> kChunkBits;
+    if (chunk >> (kRootBits + kLeafBits)) {
+      return false;
+    }
+    Leaf* leaf = root[chunk >> kLeafBits].load(std::memory_order_acquire);
+    if (leaf == nullptr) {
+      return false;
+    }
+    uint32_t i = chunk & ((1 << kLeafBits) - 1);
+    return leaf->bits[i / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (i % 64));
+  }
+
+  void Set(const void* chunk_ptr, bool value) {
+    uintptr_t chunk = reinterpret_cast<uintptr_t>(chunk_ptr) >> kChunkBits;
+    auto& slot = root[chunk >> kLeafBits];
+    Leaf* leaf = slot.load(std::memory_order_acquire);
+    if (leaf == nullptr) {
+      std::lock_guard lock(leaves_mutex);
+      leaf = slot.load(std::memory_order_relaxed);
+      if (leaf == nullptr) {
+        leaf = new Leaf();
+        slot.store(leaf, std::memory_order_release);
+      }
+    }
+    uint32_t i = chunk & ((1 << kLeafBits) - 1);
+    uint64_t bit = uint64_t(1) << (i % 64);
+    if (value) {
+      leaf->bits[i / 64].fetch_or(bit, std::memory_order_relaxed);
+    } else {
+      leaf->bits[i / 64].fetch_and(~bit, std::memory_order_relaxed);
+    }
+  }
+};
+
+// Constant-initialized, so the untouched parts of the root stay in zero pages.
+constinit ChunkMap chunk_map;
+
+}  // namespace
+
+Arena* Arena::Create() { return new Arena(); }
+
+Arena::~Arena() {
+  while (Chunk* chunk = chunks) {
+    chunks = chunk->next;
+    chunk_map.Set(chunk, false);
+    ::operator delete(chunk, std::align_val_t(kChunkSize));
+  }
+}
+
+void Arena::Release() {
+  std::unique_lock lock(mutex);
+  released = true;
+  if (stats.live_blocks == 0) {
+    lock.unlock();
+    delete this;
+  }
+}
+
+void* Arena::AllocLocked(uint32_t size_class) {
+  ++stats.allocations;
+  size_t size = Blocks::BlockSize(size_class);
+  stats.live_bytes += size;
+  stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+  ++stats.live_blocks;
+  if (void* block = free_blocks.Pop(size_class)) {
+    ++stats.reused;
+    return block;
+  }
+  if (bump_end - bump < (ptrdiff_t)size) {
+    // The rest of the current chunk is wasted. It's at most `kMaxBlockSize`.
+    Chunk* chunk = static_cast<Chunk*>(::operator new(kChunkSize, std::align_val_t(kChunkSize)));
+    chunk_map.Set(chunk, true);
+    chunk->next = chunks;
+    chunks = chunk;
+    stats.reserved_bytes += kChunkSize;
+    bump = reinterpret_cast<char*>(chunk) + kGranularity;
+    bump_end = reinterpret_cast<char*>(chunk) + kChunkSize;
+  }
+  void* block = bump;
+  bump += size;
+  return block;
+}
+
+void* Arena::Alloc(Arena* arena, size_t size) {
+  if (arena == nullptr) {
+    return ::operator new(size);
+  }
+  size += sizeof(Header);
+  if (size > kMaxBlockSize) {
+    std::lock_guard lock(arena->mutex);
+    ++arena->stats.allocations;
+    ++arena->stats.large_blocks;
+    return ::operator new(size - sizeof(Header));
+  }
+  uint32_t size_class = Blocks::SizeClass(size);
+  Header* header;
+  {
+    std::lock_guard lock(arena->mutex);
+    header = static_cast<Header*>(arena->AllocLocked(size_class));
+  }
+  *header = {arena, size_class};
+  return header + 1;
+}
+
+void* Arena::Alloc(Arena* arena, size_t size, std::align_val_t alignment) {
+  if (arena) {
+    std::lock_guard lock(arena->mutex);
+    ++arena->stats.allocations;
+    ++arena->stats.large_blocks;
+  }
+  return ::operator new(size, alignment);
+}
+
+void Arena::Free(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (!chunk_map.Contains(ptr)) {
+    ::operator delete(ptr);
+    return;
+  }
+  Header* header = static_cast<Header*>(ptr) - 1;
+  Arena* arena = header->arena;
+  uint32_t size_class = header->size_class;
+  std::unique_lock lock(arena->mutex);
+  --arena->stats.live_blocks;
+  arena->stats.live_bytes -= Blocks::BlockSize(size_class);
+  arena->free_blocks.Push(header, size_class);  // overwrites the header
+  if (arena->released && arena->stats.live_blocks == 0) {
+    lock.unlock();
+    delete arena;
+  }
+}
+
+void Arena::Free(void* ptr, std::align_val_t alignment) { ::operator delete(ptr, alignment); }
+
+Arena::Stats Arena::GetStats() {
+  std::lock_guard lock(mutex);
+  return stats;
+}
+
+}  // namespace automat
@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "size_class_pool.hh"
+
+namespace automat {
+
+// Memory owned by a single Machine.
+//
+// Locations, Connections & Objects created by a Machine are carved out of large chunks that belong
+// to the Machine (see `Machine::arena`) instead of being scattered across the general-purpose heap.
+// Blocks are rounded up to 64-byte size classes & released blocks are kept on per-class free lists,
+// so that later allocations of a similar size can reuse them. The chunks are returned to the heap
+// all at once, when the Machine is destroyed.
+//
+// Blocks remember their Arena so they can outlive their Machine (for example when a Location is
+// extracted & dropped into another Machine). Released arenas stay alive until their last block
+// is freed. Blocks may be freed from any thread.
+//
+// Only the blocks carved out of the chunks carry a header. Allocations without an Arena, blocks
+// larger than `kMaxBlockSize` & over-aligned types go straight to the heap, with no overhead.
+struct Arena {
+  static constexpr size_t kGranularity = 64;
+  using Blocks = SizeClassPool<kGranularity, 64>;
+  static constexpr size_t kMaxBlockSize = Blocks::kMaxBlockSize;  // larger blocks go to the heap
+  static constexpr size_t kChunkSize = 64 * 1024;  // chunks are aligned to their size
+
+  struct Stats {
+    uint64_t allocations = 0;     // all allocations, including the reused & large ones
+    uint64_t reused = 0;          // allocations served from the free lists
+    uint64_t large_blocks = 0;    // allocations passed to the heap (too large or over-aligned)
+    uint64_t live_blocks = 0;     // excluding the large blocks
+    uint64_t live_bytes = 0;      // rounded up to the size class
+    uint64_t peak_bytes = 0;
+    uint64_t reserved_bytes = 0;  // size of the chunks
+  };
+
+  // Arenas are never destroyed directly. See `Release`.
+  static Arena* Create();
+
+  // Deleter for `std::unique_ptr<Arena, Arena::Releaser>`.
+  struct Releaser {
+    void operator()(Arena* arena) const { arena->Release(); }
+  };
+
+  // Called by the owner of the Arena when it's destroyed. Frees the chunks as soon as the last
+  // block is freed (immediately, if there are no live blocks).
+  void Release();
+
+  // Allocates `size` bytes from the given Arena or from the heap if `arena` is null.
+  static void* Alloc(Arena* arena, size_t size);
+
+  // Over-aligned blocks are always allocated on the heap. The Arena only counts them.
+  static void* Alloc(Arena* arena, size_t size, std::align_val_t alignment);
+
+  // Frees a block returned by `Alloc`.
+  static void Free(void* ptr);
+  static void Free(void* ptr, std::align_val_t alignment);
+
+  Stats GetStats();
+
+  // Arena used by `operator new` of Locations, Connections & Objects on this thread. Null means
+  // that they're allocated on the heap. See `ArenaScope`.
+  static thread_local Arena* current;
+
+ private:
+  struct Chunk {
+    Chunk* next;
+  };
+
+  Arena() = default;
+  ~Arena();
+  void* AllocLocked(uint32_t size_class);
+
+  std::mutex mutex;
+  Blocks free_blocks;
+  Chunk* chunks = nullptr;
+  char* bump = nullptr;  // unused part of the newest chunk
+  char* bump_end = nullptr;
+  bool released = false;
+  Stats stats;
+};
+
+// Directs the allocations of Locations, Connections & Objects on this thread to the given Arena.
+struct ArenaScope {
+  Arena* previous;
+  ArenaScope(Arena* arena) : previous(Arena::current) { Arena::current = arena; }
+  ~ArenaScope() { Arena::current = previous; }
+};
+
+}  // namespace automat
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "arena.hh"
+
+#include <gtest/gtest.h>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+struct ArenaTest : TestBase {
+  Argument arg = Argument("arg", Argument::kRequiresObject);
+};
+
+TEST_F(ArenaTest, LocationsLiveInTheArenaOfTheirMachine) {
+  auto stats = machine.arena->GetStats();
+  Location& a = machine.Create<Text>("a");
+  Location& b = machine.Create<Text>("b");
+  a.ConnectTo(b, arg);
+  // At least two Locations, two Texts & a Connection.
+  EXPECT_GE(machine.arena->GetStats().live_blocks, stats.live_blocks + 5);
+  machine.ClearLocations();
+  EXPECT_EQ(machine.arena->GetStats().live_blocks, stats.live_blocks);
+}
+
+TEST_F(ArenaTest, FreedBlocksAreReused) {
+  machine.Create<Text>();
+  machine.ClearLocations();
+  auto stats = machine.arena->GetStats();
+  machine.Create<Text>();
+  EXPECT_GE(machine.arena->GetStats().reused, stats.reused + 2);
+  EXPECT_EQ(machine.arena->GetStats().reserved_bytes, stats.reserved_bytes);
+}
+
+TEST_F(ArenaTest, ExtractedLocationsOutliveTheirMachine) {
+  std::unique_ptr<Location> extracted;
+  {
+    Location& other = machine.Create<Machine>();
+    Machine& inner = *other.ThisAs<Machine>();
+    Location& text = inner.Create<Text>();
+    text.SetText("survivor");
+    extracted = inner.Extract(text);
+    machine.ClearLocations();  // destroys `inner` & releases its arena
+  }
+  EXPECT_EQ(extracted->GetText(), "survivor");
+  extracted.reset();  // frees the arena of `inner`
+}
+
+TEST_F(ArenaTest, OverAlignedBlocksGoToTheHeap) {
+  auto stats = machine.arena->GetStats();
+  void* block = Arena::Alloc(machine.arena.get(), 24, std::align_val_t(128));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % 128, 0);
+  EXPECT_EQ(machine.arena->GetStats().large_blocks, stats.large_blocks + 1);
+  EXPECT_EQ(machine.arena->GetStats().live_blocks, stats.live_blocks);
+  Arena::Free(block, std::align_val_t(128));
+
+  // Blocks allocated without an Arena are plain heap blocks.
+  void* heap_block = Arena::Alloc(nullptr, 24);
+  Arena::Free(heap_block);
+}
@@ -6,6 +6,7 @@
 
 #include "base.hh"
 #include "drag_action.hh"
+#include "executor.hh"
 #include "gui_connection_widget.hh"
 #include "svg.hh"
 #include "window.hh"
@@ -19,21 +20,42 @@ Argument next_arg("next", Argument::kOptional);
 Argument::FinalLocationResult Argument::GetFinalLocation(
     Location& here, std::source_location source_location) const {
   FinalLocationResult result(GetObject(here, source_location));
-  if (auto live_object = dynamic_cast<LiveObject*>(result.object)) {
+  if (auto live_object = InterfaceCast<LiveObject>(result.object)) {
     result.final_location = live_object->here;
   }
   return result;
 }
 
+ArgumentCacheStats argument_cache_stats;
+
 Argument::LocationResult Argument::GetLocation(Location& here,
                                                std::source_location source_location) const {
   LocationResult result;
+  // The cache isn't synchronized so worker threads don't use it.
+  bool use_cache = !executor::OnWorkerThread();
+  if (use_cache) {
+    if (auto* resolved = here.FindResolvedArgument(*this)) {
+      ++argument_cache_stats.hits;
+      result.location = resolved->location;
+      result.follow_pointers = resolved->follow_pointers;
+      return result;
+    }
+    ++argument_cache_stats.misses;
+  }
   auto conn_it = here.outgoing.find(this);
   if (conn_it != here.outgoing.end()) {  // explicit connection
     auto* c = *conn_it;
     result.location = &c->to;
     result.follow_pointers = c->pointer_behavior == Connection::kFollowPointers;
+    if (use_cache) {
+      here.resolved_arguments.push_back({
+          .argument = this,
+          .location = result.location,
+          .follow_pointers = result.follow_pointers,
+      });
+    }
   } else {  // otherwise, search for other locations in this machine
+    // Not cached - the result depends on the names & positions of the other locations.
     if (auto machine = here.ParentAs<Machine>()) {
       result.location = reinterpret_cast<Location*>(
           machine->Nearby(here.position, HUGE_VALF, [&](Location& other) -> void* {
@@ -55,6 +77,18 @@ Argument::LocationResult Argument::GetLocation(Location& here,
 
 Argument::ObjectResult Argument::GetObject(Location& here,
                                            std::source_location source_location) const {
+  bool use_cache = !executor::OnWorkerThread();
+  if (use_cache) {
+    if (auto* resolved = here.FindResolvedArgument(*this); resolved && resolved->object) {
+      ++argument_cache_stats.hits;
+      ObjectResult result(LocationResult{
+          .follow_pointers = resolved->follow_pointers,
+          .location = resolved->location,
+      });
+      result.object = resolved->object;
+      return result;
+    }
+  }
   ObjectResult result(GetLocation(here, source_location));
   if (result.location) {
     if (result.follow_pointers) {
@@ -62,6 +96,12 @@ Argument::ObjectResult Argument::GetObject(Location& here,
     } else {
       result.object = result.location->object.get();
     }
+    // Objects reached through pointers must be followed again on every call.
+    if (use_cache && result.object && result.object == result.location->object.get()) {
+      if (auto* resolved = here.FindResolvedArgument(*this)) {
+        resolved->object = result.object;
+      }
+    }
     if (result.object == nullptr && precondition >= kRequiresObject) {
       here.ReportError(f("The %s argument of %s is empty.", name.c_str(), here.ToStr().c_str()),
                        source_location);
@@ -71,6 +111,17 @@ Argument::ObjectResult Argument::GetObject(Location& here,
   return result;
 }
 
+Location::ResolvedArgument* Argument::CachedObject(Location& here, Object* object) const {
+  if (executor::OnWorkerThread()) {
+    return nullptr;
+  }
+  auto* resolved = here.FindResolvedArgument(*this);
+  if (resolved == nullptr || resolved->object != object) {
+    return nullptr;
+  }
+  return resolved;
+}
+
 struct DrawableSkPath : PaintDrawable {
   SkPath path;
   DrawableSkPath(SkPath path) : path(std::move(path)) {}
@@ -180,8 +231,9 @@ Location* Argument::FindLocation(Location& here, const FindConfig& cfg) const {
       if (auto machine = here.ParentAs<Machine>()) {
         Location& l = machine->Create(*prototype);
         result = &l;
-        Rect object_bounds = result->object->Shape().getBounds();
+        Rect object_bounds = l.ObjectShape().getBounds();
         l.position = here.position + here.object->ArgStart(*this).pos - object_bounds.TopCenter();
+        machine->UpdateIndex(l);
         l.UpdateAutoconnectArgs();
         PositionBelow(here, l);
         AnimateGrowFrom(here, l);
@@ -206,7 +258,7 @@ void LiveArgument::Detach(Location& here) {
   }
   // If there were no connections, try to find nearby objects instead.
   if (auto machine = here.ParentAs<Machine>()) {
-    if (connections.first == here.outgoing.end()) {
+    if (connections.first == connections.second) {
       machine->Nearby(here.position, HUGE_VALF, [&](Location& other) {
         if (other.name == name) {
           here.StopObservingUpdates(other);
@@ -224,7 +276,7 @@ void LiveArgument::Attach(Location& here) {
     here.ObserveUpdates(connection->to);
   }
   // If there were no connections, try to find nearby objects instead.
-  if (connections.first == here.outgoing.end()) {
+  if (connections.first == connections.second) {
     if (auto machine = here.ParentAs<Machine>()) {
       machine->Nearby(here.position, HUGE_VALF, [&](Location& other) {
         if (other.name == name) {
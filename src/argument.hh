@@ -14,6 +14,14 @@
 
 namespace automat {
 
+// Counts the calls to `Argument::GetLocation` & `GetObject` on the Automat thread.
+struct ArgumentCacheStats {
+  uint64_t hits = 0;    // served from `Location::resolved_arguments`
+  uint64_t misses = 0;  // had to search the connections of the Location
+};
+
+extern ArgumentCacheStats argument_cache_stats;
+
 enum class CableTexture {
   Smooth,
   Braided,
@@ -82,7 +90,7 @@ struct Argument {
   Argument& RequireInstanceOf() {
     requirements.emplace_back([name = name](Location* location, Object* object,
                                             std::string& error) {
-      if (dynamic_cast<T*>(object) == nullptr) {
+      if (InterfaceCast<T>(object) == nullptr) {
         error =
             maf::f("The %s argument must be an instance of %s.", name.c_str(), typeid(T).name());
       }
@@ -99,6 +107,8 @@ struct Argument {
     }
   }
 
+  // Results of `GetLocation` & `GetObject` are cached in `Location::resolved_arguments` (on the
+  // Automat thread).
   struct LocationResult {
     bool ok = true;
     bool follow_pointers = true;
@@ -124,6 +134,9 @@ struct Argument {
   FinalLocationResult GetFinalLocation(
       Location& here, std::source_location source_location = std::source_location::current()) const;
 
+  // Cache entry of this argument, if it holds the given object. Used by `GetTyped`.
+  Location::ResolvedArgument* CachedObject(Location& here, Object* object) const;
+
   template <typename T>
   struct TypedResult : ObjectResult {
     T* typed = nullptr;
@@ -135,7 +148,16 @@ struct Argument {
                           std::source_location source_location = std::source_location::current()) {
     TypedResult<T> result(GetObject(here, source_location));
     if (result.object) {
-      result.typed = dynamic_cast<T*>(result.object);
+      auto* resolved = CachedObject(here, result.object);
+      if (resolved && resolved->typed_as == &typeid(T)) {
+        result.typed = static_cast<T*>(resolved->typed);
+      } else {
+        result.typed = InterfaceCast<T>(result.object);
+        if (resolved) {
+          resolved->typed_as = &typeid(T);
+          resolved->typed = result.typed;
+        }
+      }
       if (result.typed == nullptr && precondition >= kRequiresConcreteType) {
         here.ReportError(
             maf::f("The %s argument is not an instance of %s.", name.c_str(), typeid(T).name()),
@@ -227,7 +249,7 @@ struct Argument {
 
   template <typename T>
   T* FindObject(Location& here, const FindConfig& cfg = kDefaultFindConfig) const {
-    return dynamic_cast<T*>(FindObject(here, cfg));
+    return InterfaceCast<T>(FindObject(here, cfg));
   }
 
   void InvalidateConnectionWidgets(Location& here) const;
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "argument.hh"
+
+#include <gtest/gtest.h>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+struct ArgumentCacheTest : TestBase {
+  Argument arg = Argument("arg", Argument::kRequiresObject);
+  Location& here = machine.Create<Text>("here");
+  Location& a = machine.Create<Text>("a");
+  Location& b = machine.Create<Text>("b");
+};
+
+TEST_F(ArgumentCacheTest, RepeatedLookupsHitTheCache) {
+  here.ConnectTo(a, arg);
+  EXPECT_EQ(arg.GetObject(here).object, a.object.get());
+  auto stats = argument_cache_stats;
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(arg.GetTyped<Text>(here).typed, a.object.get());
+  }
+  EXPECT_EQ(argument_cache_stats.hits, stats.hits + 10);
+  EXPECT_EQ(argument_cache_stats.misses, stats.misses);
+}
+
+TEST_F(ArgumentCacheTest, ConnectionsInvalidate) {
+  Connection* connection = here.ConnectTo(a, arg);
+  EXPECT_EQ(arg.GetObject(here).object, a.object.get());
+  delete connection;
+  EXPECT_FALSE(arg.GetObject(here).ok);
+  here.ClearError();
+  here.ConnectTo(b, arg);
+  EXPECT_EQ(arg.GetObject(here).object, b.object.get());
+}
+
+TEST_F(ArgumentCacheTest, ReplacedObjectsInvalidate) {
+  here.ConnectTo(a, arg);
+  EXPECT_EQ(arg.GetObject(here).object, a.object.get());
+  EXPECT_NE(arg.GetTyped<Text>(here).typed, nullptr);
+  a.Create<Number>();
+  EXPECT_EQ(arg.GetObject(here).object, a.object.get());
+  EXPECT_EQ(arg.GetTyped<Text>(here).typed, nullptr);
+}
+
+TEST_F(ArgumentCacheTest, PointersAreFollowedEveryTime) {
+  Location& label = machine.Create<Text>();
+  Location& complex = machine.Create<Complex>();
+  Location& field = machine.Create<ComplexField>();
+  label.SetText("X");
+  field.ConnectTo(label, "label");
+  field.ConnectTo(complex, "complex");
+  here.ConnectTo(field, arg);
+  EXPECT_FALSE(arg.GetObject(here).ok);
+  here.ClearError();
+  field.Put(Create<Text>());
+  EXPECT_EQ(arg.GetObject(here).object, field.Follow());
+  label.SetText("Y");  // the field now points to a different (empty) slot
+  EXPECT_FALSE(arg.GetObject(here).ok);
+}
@@ -4,14 +4,6 @@
 
 #pragma comment(lib, "skia")
 
-#include "automat.hh"
-
-#include "persistence.hh"
-#include "root.hh"
-#include "window.hh"
-
-using namespace automat::gui;
-
 #pragma region Main
 #if defined(_WIN32)
 
@@ -28,23 +20,3 @@ int main() { return WinMain(GetModuleHandle(NULL), NULL, GetCommandLine(), SW_SH
 int main(int argc, char* argv[]) { return LinuxMain(argc, argv); }
 
 #endif
-
-#pragma region Initialization
-namespace automat {
-void InitAutomat(maf::Status& status) {
-  InitRoot();
-  window.reset(new Window());
-  window->RequestResize = [&](Vec2 new_size) { window->Resize(new_size); };
-  window->RequestMaximize = [&](bool horizontally, bool vertically) {
-    window->maximized_horizontally = horizontally;
-    window->maximized_vertically = vertically;
-  };
-  gui::keyboard = std::make_unique<gui::Keyboard>(*window);
-  LoadState(*window, status);
-  RunOnAutomatThread([&] {
-    // nothing to do here - just make sure that memory allocated in main thread is synchronized to
-    // automat thread
-  });
-}
-
-}  // namespace automat
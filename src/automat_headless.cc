@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma maf main
+
+#pragma comment(lib, "skia")
+
+#include "headless.hh"
+
+#if defined(__linux__)
+#pragma comment(lib, "freetype2")
+#endif
+
+int main(int argc, char* argv[]) { return automat::HeadlessMain(argc, argv); }
@@ -16,13 +16,18 @@
 #include <include/effects/SkRuntimeEffect.h>
 #include <include/pathops/SkPathOps.h>
 
+#include "bulk_edit.hh"
 #include "drag_action.hh"
 #include "embedded.hh"
+#include "executor.hh"
 #include "gui_connection_widget.hh"
+#include "offload.hh"
 #include "root.hh"
+#include "task_pool.hh"
 #include "tasks.hh"
 #include "thread_name.hh"
 #include "timer_thread.hh"
+#include "trace.hh"
 #include "window.hh"
 
 using namespace std;
@@ -31,33 +36,46 @@ using namespace maf;
 namespace automat {
 
 Location* Machine::LocationAtPoint(Vec2 point) {
-  for (auto& loc : locations) {
+  vector<Location*> candidates;
+  index.AtPoint(point, candidates);
+  for (auto* loc : candidates) {
     Vec2 local_point = (point - loc->position) / loc->scale;
-    SkPath shape;
-    if (loc->object) {
-      shape = loc->object->Shape(nullptr);
-    }
-    if (shape.contains(local_point.x, local_point.y)) {
-      return loc.get();
+    if (loc->ObjectShape().contains(local_point.x, local_point.y)) {
+      return loc;
     }
   }
   return nullptr;
 }
 
-void* Machine::Nearby(Vec2 start, float radius, std::function<void*(Location&)> callback) {
-  float radius2 = radius * radius;
+void Machine::UpdateIndex(Location& location) {
+  if (!index.Contains(location)) {
+    return;
+  }
+  Rect bounds = location.ObjectShape().getBounds();
+  float s = location.scale;
+  bounds = Rect(bounds.left * s, bounds.bottom * s, bounds.right * s, bounds.top * s);
+  index.Update(location, bounds.MoveBy(location.position));
+  journal::LocationMoved(location);
+}
+
+string Machine::MemoryReport() const {
+  size_t total = 0;
   for (auto& loc : locations) {
-    auto dist2 = (loc->object ? Rect(loc->object->Shape().getBounds()) : Rect{})
-                     .MoveBy(loc->position)
-                     .DistanceSquared(start);
-    if (dist2 > radius2) {
-      continue;
-    }
-    if (auto ret = callback(*loc)) {
-      return ret;
-    }
+    total += loc->MemoryUsage();
   }
-  return nullptr;
+  size_t n = locations.size();
+  double per_location = n ? (double)total / n : 0;
+  auto a = arena->GetStats();
+  return f("%zu locations, %.1f bytes per Location (%zu inline, %.1f on the heap)", n,
+           per_location, sizeof(Location), n ? per_location - sizeof(Location) : 0.) +
+         f("; arena: %zu live blocks, %zu KiB live (peak %zu KiB, reserved %zu KiB), %zu of %zu "
+           "allocations reused",
+           (size_t)a.live_blocks, (size_t)(a.live_bytes / 1024), (size_t)(a.peak_bytes / 1024),
+           (size_t)(a.reserved_bytes / 1024), (size_t)a.reused, (size_t)a.allocations);
+}
+
+void* Machine::Nearby(Vec2 start, float radius, std::function<void*(Location&)> callback) {
+  return index.Nearby(start, radius, std::move(callback));
 }
 
 const Machine Machine::proto;
@@ -67,16 +85,69 @@ int log_executed_tasks = 0;
 LogTasksGuard::LogTasksGuard() { ++log_executed_tasks; }
 LogTasksGuard::~LogTasksGuard() { --log_executed_tasks; }
 
-std::deque<Task*> queue;
+TaskQueue queue;
+uint64_t executed_tasks = 0;
+time::SteadyClock::time_point run_loop_finished;
+std::function<void()> on_idle;
 std::unordered_set<Location*> no_scheduling;
-std::vector<Task*> global_successors;
+std::mutex no_scheduling_mutex;
+thread_local SuccessorList* global_successors = nullptr;
 
 channel events;
+std::unordered_map<uint64_t, uint64_t> dead_targets;
+
+// Guards count themselves in the slot of the current generation. The Automat thread advances the
+// generation when it wants to forget the tombstones & then waits for the previous slot to drain.
+static std::atomic<uint64_t> send_generation = 0;
+static std::atomic<int> sends_in_flight[2] = {};
+// Whether the Automat thread waits for the guards of the previous generation.
+static bool retiring_dead_targets = false;
+
+SendGuard::SendGuard() {
+  while (true) {
+    uint64_t generation = send_generation.load();
+    slot = generation & 1;
+    sends_in_flight[slot].fetch_add(1);
+    if (send_generation.load() == generation) {
+      return;
+    }
+    // The generation advanced in the meantime, so the slot may have already been seen empty.
+    sends_in_flight[slot].fetch_sub(1);
+  }
+}
+
+SendGuard::~SendGuard() { sends_in_flight[slot].fetch_sub(1); }
+
+void AddDeadTarget(uint64_t incarnation) {
+  if (events.size() > 0 || sends_in_flight[0].load() > 0 || sends_in_flight[1].load() > 0) {
+    dead_targets.emplace(incarnation, send_generation.load());
+  }
+}
+
+// Forgets the tombstones once no task that targets their Locations can arrive anymore.
+static void RetireDeadTargets() {
+  if (events.size() > 0) {
+    return;
+  }
+  if (!retiring_dead_targets) {
+    send_generation.fetch_add(1);
+    retiring_dead_targets = true;
+  }
+  uint64_t previous = send_generation.load() - 1;
+  // Guards send their tasks before they're released, so once the slot is empty, `events` holds
+  // all of the tasks of the previous generation.
+  if (sends_in_flight[previous & 1].load() > 0 || events.size() > 0) {
+    return;
+  }
+  std::erase_if(dead_targets, [&](auto& entry) { return entry.second <= previous; });
+  retiring_dead_targets = false;
+}
 
 struct AutodeleteTaskWrapper : Task {
   std::unique_ptr<Task> wrapped;
   AutodeleteTaskWrapper(std::unique_ptr<Task>&& task)
       : Task(task->target), wrapped(std::move(task)) {}
+  Task& Traced() override { return *wrapped; }
   void Execute() override {
     wrapped->Execute();
     delete this;
@@ -90,6 +161,30 @@ struct ShutdownTask : Task {
   void Execute() override {}
 };
 
+// Moves the tasks sent by other threads to the task queue. When `wait` is true, blocks until at
+// least one task arrives.
+static void ReceiveEvents(bool wait) {
+  if (!wait && events.size() == 0) {
+    return;
+  }
+  // Everything that arrived in the meantime is processed in a single batch.
+  constexpr size_t kMaxBatch = 256;
+  void* batch[kMaxBatch];
+  size_t n = events.recv_bulk(batch, kMaxBatch);
+  for (size_t i = 0; i < n; ++i) {
+    std::unique_ptr<Task> task(static_cast<Task*>(batch[i]));
+    if (!dead_targets.empty() && dead_targets.contains(task->target_incarnation)) {
+      continue;  // the target was destroyed while the task was on its way
+    }
+    auto* wrapper = new AutodeleteTaskWrapper(std::move(task));
+    wrapper->priority = wrapper->wrapped->priority;
+    wrapper->Schedule();  // Will delete itself after executing.
+  }
+  if (!dead_targets.empty()) {
+    RetireDeadTargets();
+  }
+}
+
 void RunThread(std::stop_token stop_token) {
   StartTimeThread(stop_token);
   std::stop_callback wakeup_for_shutdown(stop_token,
@@ -98,12 +193,22 @@ void RunThread(std::stop_token stop_token) {
   SetThreadName("Automat Loop");
   while (!stop_token.stop_requested()) {
     RunLoop();
-    std::unique_ptr<Task> task = events.recv<Task>();
-    if (task) {
-      auto* wrapper = new AutodeleteTaskWrapper(std::move(task));
-      wrapper->Schedule();  // Will delete itself after executing.
+    // In virtual time there is no point in waiting for the timers - the clock jumps straight to the
+    // next deadline.
+    if (time::VirtualTimeEnabled() && events.size() == 0) {
+      JumpToNextTimer();
+    }
+    // RunLoop may have already received the ShutdownTask.
+    if (stop_token.stop_requested()) {
+      break;
     }
+    if (on_idle && events.size() == 0) {
+      on_idle();
+    }
+    ReceiveEvents(true);
   }
+  executor::Stop();
+  offload::Stop();
   automat_thread_finished = true;
   automat_thread_finished.notify_all();
 }
@@ -113,19 +218,55 @@ void RunLoop(const int max_iterations) {
     LOG << "RunLoop(" << queue.size() << " tasks)";
     LOG_Indent();
   }
+  auto& pool_stats = task_pool::ThreadStats();
+  uint64_t pool_reused_before = pool_stats.reused;
   int iterations = 0;
-  while (!queue.empty() && (max_iterations < 0 || iterations < max_iterations)) {
-    Task* task = queue.front();
-    queue.pop_front();
+  Priority outer_lane = queue.current;
+  while (max_iterations < 0 || iterations < max_iterations) {
+    // Input shouldn't wait until the background work is done, so the events are received as soon
+    // as they arrive. Their lanes decide when they're executed.
+    ReceiveEvents(false);
+    Priority lane;
+    Task* task = queue.Pop(&lane);
+    if (task == nullptr) {
+      // When the executor is running, workers may still send some tasks back to this thread.
+      if (executor::WaitForPinnedTasks()) {
+        continue;
+      }
+      break;
+    }
+    ++iterations;
+    if (executor::TrySubmit(*task)) {
+      continue;
+    }
+    // Regular tasks may modify the graph of objects (observers, connections, arguments) that the
+    // workers read, so they're executed only once the workers are idle.
+    executor::Quiesce();
     task->scheduled = false;
+    ++executed_tasks;
+    trace::TaskScope trace_scope(task->Traced(), queue.size());
+    // Only the tasks that were queued in their own lane pass it on. Tasks that inherited their lane
+    // don't, so a cascade started by input or a timer falls back to the background after one hop.
+    queue.current = lane == task->priority ? lane : Priority::Dataflow;
     task->Execute();
-    ++iterations;
+    queue.current = outer_lane;
+  }
+  if (iterations > 0) {
+    run_loop_finished = time::SteadyClock::now();
   }
+  pool_stats.last_run_loop_reused = pool_stats.reused - pool_reused_before;
+  journal::Flush();
   if (log_executed_tasks) {
     LOG_Unindent();
+    LOG << "Task pool saved " << pool_stats.last_run_loop_reused << " allocations";
   }
 }
 bool NoScheduling(Location* location) {
+  if (executor::OnWorkerThread()) {
+    std::lock_guard lock(no_scheduling_mutex);
+    return no_scheduling.find(location) != no_scheduling.end();
+  }
+  // `no_scheduling` is only modified by the Automat thread.
   return no_scheduling.find(location) != no_scheduling.end();
 }
 
@@ -158,9 +299,12 @@ void Machine::SerializeState(Serializer& writer, const char* key) const {
   if (!locations.empty()) {
     writer.Key("locations");
     writer.StartArray();
-    std::unordered_map<Location*, int> location_ids;
+    // Locations are referenced by their position in the array. It's looked up by the slot index
+    // of each Location so no hash map is needed.
+    Vec<int> location_ids(location_slots.Capacity());
+    int next_id = 0;
     for (auto& location : locations) {
-      location_ids.emplace(location.get(), location_ids.size());
+      location_ids[location->handle.index] = next_id++;
     }
     for (auto& location : locations) {
       writer.StartObject();
@@ -183,8 +327,13 @@ void Machine::SerializeState(Serializer& writer, const char* key) const {
         writer.Key("connections");
         writer.StartObject();
         for (auto* conn : location->outgoing) {
+          if (Find(conn->to.handle) != &conn->to) {
+            ERROR << "Skipping connection from " << *location << " to " << conn->to
+                  << ", which is outside of " << *this;
+            continue;
+          }
           writer.Key(conn->argument.name.data(), conn->argument.name.size());
-          writer.Int(location_ids.at(&conn->to));
+          writer.Int(location_ids[conn->to.handle.index]);
         }
         writer.EndObject();
       }
@@ -200,6 +349,8 @@ void Machine::DeserializeState(Location& l, Deserializer& d) {
     if (key == "name") {
       d.Get(name, status);
     } else if (key == "locations") {
+      // Connections are announced & the Locations are updated once the whole graph is loaded.
+      BulkEdit bulk;
       Vec<Location*> location_idx;
       struct ConnectionRecord {
         Str label;
@@ -261,6 +412,9 @@ void Machine::DeserializeState(Location& l, Deserializer& d) {
           from->ConnectTo(*location_idx[connection_record.to], arg);
         });
       }
+      for (auto* location : location_idx) {
+        UpdateIndex(*location);
+      }
     }
   }
   if (!OK(status)) {
@@ -268,7 +422,7 @@ void Machine::DeserializeState(Location& l, Deserializer& d) {
   }
 }
 
-Machine::Machine() {}
+Machine::Machine() : arena(Arena::Create()) {}
 
 ControlFlow Machine::VisitChildren(gui::Visitor& visitor) {
   int i = 0;
@@ -374,7 +528,11 @@ void Machine::SnapPosition(Vec2& position, float& scale, Object* object, Vec2* f
 
 void Machine::DropLocation(std::unique_ptr<Location>&& l) {
   l->parent = here;
-  locations.insert(locations.begin(), std::move(l));
+  l->handle = location_slots.Insert(l.get());
+  index.Insert(*l, Rect{});
+  UpdateIndex(*l);
+  Location& dropped = *locations.insert(locations.begin(), std::move(l))->get();
+  journal::LocationCreated(dropped);
   audio::Play(embedded::assets_SFX_canvas_drop_wav);
   InvalidateDrawCache();
 }
@@ -385,7 +543,10 @@ std::unique_ptr<Location> Machine::Extract(Location& location) {
                    [&location](const unique_ptr<Location>& l) { return l.get() == &location; });
   if (it != locations.end()) {
     std::unique_ptr<Location> result = std::move(*it);
+    journal::LocationDeleted(*result);
     locations.erase(it);
+    index.Remove(*result);
+    location_slots.Remove(result->handle);
     for (int i = 0; i < front.size(); ++i) {
       if (front[i] == result.get()) {
         front.erase(front.begin() + i);
@@ -393,11 +554,12 @@ std::unique_ptr<Location> Machine::Extract(Location& location) {
       }
     }
     for (int i = 0; i < children_with_errors.size(); ++i) {
-      if (children_with_errors[i] == result.get()) {
+      if (children_with_errors[i] == result->handle) {
         children_with_errors.erase(children_with_errors.begin() + i);
         break;
       }
     }
+    result->handle = {};
     InvalidateDrawCache();
     audio::Play(embedded::assets_SFX_canvas_pick_wav);
     return result;
@@ -11,13 +11,16 @@
 #include <cassert>
 #include <deque>
 #include <functional>
+#include <initializer_list>
 #include <memory>
+#include <mutex>
 #include <source_location>
 #include <stop_token>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "animation.hh"
@@ -28,11 +31,13 @@
 #include "deserializer.hh"
 #include "drag_action.hh"
 #include "format.hh"
+#include "journal.hh"
 #include "location.hh"
 #include "log.hh"
 #include "pointer.hh"
 #include "prototypes.hh"
 #include "run_button.hh"
+#include "spatial_index.hh"
 #include "tasks.hh"
 #include "text_field.hh"
 #include "widget.hh"
@@ -92,6 +97,14 @@ struct LiveObject : Object {
       live_arg->ConnectionAdded(here, connection);
     }
   }
+  // Objects are redrawn whenever their state changes so this is also the moment when their shape
+  // may have changed.
+  void InvalidateDrawCache() const override {
+    if (here) {
+      here->InvalidateShape();
+    }
+    Object::InvalidateDrawCache();
+  }
 };
 
 template <typename T>
@@ -104,25 +117,64 @@ struct Machine : LiveObject, gui::DropTarget {
   static const Machine proto;
   Machine();
   string name = "";
+  // Memory of the Locations, Connections & Objects created by this Machine. Declared before
+  // `locations` so that it's released after them.
+  std::unique_ptr<Arena, Arena::Releaser> arena;
   deque<unique_ptr<Location>> locations;
   vector<Location*> front;
-  vector<Location*> children_with_errors;
+  // Handles of the `locations` with errors (see `Find`).
+  vector<SlotHandle> children_with_errors;
+
+  // Bounds of the `locations`, used by `LocationAtPoint` & `Nearby`.
+  SpatialIndex index;
+
+  // Handles of the `locations` (see `Location::handle`).
+  SlotMap<Location*> location_slots;
 
   std::unique_ptr<Location> Extract(Location& location);
 
+  // Delete all of the locations.
+  void ClearLocations() {
+    locations.clear();
+    index.Clear();
+    location_slots.Clear();
+    children_with_errors.clear();
+  }
+
+  // Returns the location referenced by the handle or nullptr if it was deleted or extracted from
+  // this Machine. Also checks whether a Location belongs to this Machine:
+  // `Find(location.handle) == &location`.
+  Location* Find(SlotHandle handle) const {
+    Location* const* location = location_slots.Get(handle);
+    return location ? *location : nullptr;
+  }
+
   Location& CreateEmpty(const string& name = "") {
+    ArenaScope scope(arena.get());
     auto& it = locations.emplace_front(new Location(here));
     Location* h = it.get();
     h->name = name;
+    h->handle = location_slots.Insert(h);
+    index.Insert(*h, Rect{});
     return *h;
   }
 
   Location& Create(const Object& prototype, const string& name = "") {
     auto& h = CreateEmpty(name);
-    h.Create(prototype);
+    {
+      ArenaScope scope(arena.get());
+      h.Create(prototype);
+    }
+    UpdateIndex(h);
+    journal::LocationCreated(h);
     return h;
   }
 
+  // Refresh the bounds of the given location in the spatial index. Should be called after its
+  // position, scale or shape changes. Does nothing for locations that are not indexed (for
+  // example because they're being dragged).
+  void UpdateIndex(Location&);
+
   // Create an instance of T and return its location.
   //
   // The new instance is created from a prototype instance in `T::proto`.
@@ -135,19 +187,24 @@ struct Machine : LiveObject, gui::DropTarget {
 
   void DeserializeState(Location& l, Deserializer& d) override;
 
+  // Returns the topmost location whose shape contains the given point.
   Location* LocationAtPoint(Vec2);
 
-  // Iterate over all nearby objects (within the given radius around start point).
+  // Iterate over all nearby objects (within the given radius around start point). Objects are
+  // visited in the order of increasing distance.
   //
   // Return non-null to stop iteration and return from Nearby.
   void* Nearby(Vec2 center, float radius, std::function<void*(Location&)> callback);
 
+  // Human-readable summary of the memory used by the Locations of this Machine (see
+  // `Location::MemoryUsage`) & of its arena.
+  string MemoryReport() const;
+
   string_view Name() const override { return name; }
   std::unique_ptr<Object> Clone() const override {
     Machine* m = new Machine();
     for (auto& my_it : locations) {
-      auto& other_h = m->CreateEmpty(my_it->name);
-      other_h.Create(*my_it->object);
+      m->Create(*my_it->object, my_it->name);
     }
     return std::unique_ptr<Object>(m);
   }
@@ -216,7 +273,7 @@ struct Machine : LiveObject, gui::DropTarget {
     // If the error hasn't been cleared by other Errored calls, then propagate
     // it to the parent.
     if (errored.HasError()) {
-      children_with_errors.push_back(&errored);
+      children_with_errors.push_back(errored.handle);
       for (Location* observer : here.error_observers) {
         observer->ScheduleErrored(errored);
       }
@@ -231,7 +288,7 @@ struct Machine : LiveObject, gui::DropTarget {
   }
 
   void ClearChildError(Location& child) {
-    if (auto it = std::find(children_with_errors.begin(), children_with_errors.end(), &child);
+    if (auto it = std::find(children_with_errors.begin(), children_with_errors.end(), child.handle);
         it != children_with_errors.end()) {
       children_with_errors.erase(it);
       if (!here->HasError()) {
@@ -295,28 +352,38 @@ struct LogTasksGuard {
 
 struct Task;
 
-extern std::deque<Task*> queue;
+extern TaskQueue queue;
 extern std::unordered_set<Location*> no_scheduling;
-extern vector<Task*> global_successors;
+// Guards `no_scheduling` against the executor's workers, which also check it. Only the Automat
+// thread modifies `no_scheduling`, so it reads it without locking.
+extern std::mutex no_scheduling_mutex;
+// Each thread of the executor (see executor.hh) keeps its own successors. Tasks created while this
+// list is set become predecessors of its tasks. Doesn't hold a reference - the list is owned by the
+// currently executing task or by a `NextGuard`.
+extern thread_local SuccessorList* global_successors;
 
 bool NoScheduling(Location* location);
 
+// Tasks created within the scope of this guard become predecessors of the given `successors`. Once
+// the guard goes out of scope, successors are scheduled as soon as all of their predecessors
+// finish.
 struct NextGuard {
-  std::vector<Task*> successors;
-  std::vector<Task*> old_global_successors;
-  NextGuard(std::vector<Task*>&& successors) : successors(std::move(successors)) {
-    old_global_successors = global_successors;
-    global_successors = this->successors;
+  SuccessorList* successors = nullptr;
+  SuccessorList* old_global_successors;
+  NextGuard(std::initializer_list<Task*> tasks) {
+    // The guard itself is also a predecessor so that successors are not scheduled before the
+    // guard's scope ends.
+    for (Task* task : tasks) {
+      task->pending_predecessors.fetch_add(1, std::memory_order_relaxed);
+      successors = new SuccessorList(task, successors);
+    }
+    old_global_successors = std::exchange(global_successors, successors);
   }
   ~NextGuard() {
     assert(global_successors == successors);
     global_successors = old_global_successors;
-    for (Task* successor : successors) {
-      auto& pred = successor->predecessors;
-      if (pred.empty()) {
-        successor->Schedule();
-      }
-    }
+    SuccessorList::PredecessorFinished(successors);
+    SuccessorList::Release(successors);
   }
 };
 
@@ -325,8 +392,14 @@ struct NextGuard {
 // arguments without triggering re-runs.
 struct NoSchedulingGuard {
   Location& location;
-  NoSchedulingGuard(Location& location) : location(location) { no_scheduling.insert(&location); }
-  ~NoSchedulingGuard() { no_scheduling.erase(&location); }
+  NoSchedulingGuard(Location& location) : location(location) {
+    std::lock_guard lock(no_scheduling_mutex);
+    no_scheduling.insert(&location);
+  }
+  ~NoSchedulingGuard() {
+    std::lock_guard lock(no_scheduling_mutex);
+    no_scheduling.erase(&location);
+  }
 };
 
 // Types of objects that sholud work nicely with data updates:
@@ -343,9 +416,43 @@ struct NoSchedulingGuard {
 
 void RunLoop(const int max_iterations = -1);
 
+// Number of tasks executed by `RunLoop` on the Automat thread. Tasks executed by the executor's
+// workers are counted in `executor::GetStats`.
+extern uint64_t executed_tasks;
+
+// Moment when `RunLoop` last ran out of tasks (including the tasks of the executor's workers). Only
+// updated by the calls that executed something.
+extern time::SteadyClock::time_point run_loop_finished;
+
+// Called on the Automat thread whenever it runs out of work, right before it starts waiting for
+// `events`. Must be set before `InitRoot`.
+extern std::function<void()> on_idle;
+
 // THIS IS THE MOST IMPORTANT OBJECT IN AUTOMAT - the only entry into the main loop.
 extern channel events;
 
+// Incarnations (see `Location::incarnation`) of the Locations that were destroyed while some tasks
+// may still be on their way through `events`. Such tasks are dropped when they're received. Only
+// accessed from the Automat thread.
+//
+// Each tombstone remembers the generation of the `SendGuard`s from the moment of its Location's
+// destruction. It's kept until all of the guards of that generation are released & their tasks
+// are received.
+extern std::unordered_map<uint64_t, uint64_t> dead_targets;
+
+// Called by `~Location` (after the Location was removed from the structures that other threads
+// take their tasks from).
+void AddDeadTarget(uint64_t incarnation);
+
+// Threads that take tasks out of the structures cleaned up by `~Location` (like the timer wheel) &
+// then send them through `events` hold this guard from before they take the tasks until they're
+// sent. This way the Automat thread knows when such tasks could still target destroyed Locations.
+struct SendGuard {
+  int slot;
+  SendGuard();
+  ~SendGuard();
+};
+
 void RunThread(std::stop_token);
 
 }  // namespace automat
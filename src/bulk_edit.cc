@@ -0,0 +1,130 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "bulk_edit.hh"
+
+#include <unordered_map>
+#include <vector>
+
+#include "base.hh"
+
+namespace automat {
+
+namespace {
+
+struct Update {
+  Location* target;   // nullptr once the Location is destroyed
+  Location* updated;  // nullptr once the Location is destroyed
+};
+
+int depth = 0;
+std::vector<Connection*> connections;  // destroyed Connections are set to nullptr
+std::unordered_map<Connection*, int> connection_index;
+std::vector<Update> updates;
+std::unordered_map<Location*, std::vector<int>> update_index;  // by target
+bulk_edit::Stats stats;
+
+}  // namespace
+
+BulkEdit::BulkEdit() { ++depth; }
+
+BulkEdit::~BulkEdit() {
+  if (!committed) {
+    Commit();
+  }
+}
+
+void BulkEdit::Commit() {
+  if (committed) {
+    return;
+  }
+  committed = true;
+  if (depth > 1) {
+    --depth;
+    return;
+  }
+  ++stats.commits;
+  // Notifications may connect more Locations (or schedule more updates) so the queue is indexed.
+  // Updates scheduled by them are still collected.
+  for (int i = 0; i < (int)connections.size(); ++i) {
+    if (Connection* c = connections[i]) {
+      connection_index.erase(c);
+      connections[i] = nullptr;
+      c->from.object->ConnectionAdded(c->from, *c);
+    }
+  }
+  connections.clear();
+  connection_index.clear();
+  --depth;
+  auto collected = std::move(updates);
+  updates.clear();
+  update_index.clear();
+  for (auto& update : collected) {
+    if (update.target && update.updated) {
+      ++stats.updates_scheduled;
+      update.target->ScheduleLocalUpdate(*update.updated);
+    }
+  }
+}
+
+namespace bulk_edit {
+
+bool Active() { return depth > 0; }
+
+bool DeferConnectionAdded(Connection& connection) {
+  if (depth == 0) {
+    return false;
+  }
+  ++stats.connections;
+  connection_index[&connection] = connections.size();
+  connections.push_back(&connection);
+  return true;
+}
+
+bool DeferUpdate(Location& target, Location& updated) {
+  if (depth == 0) {
+    return false;
+  }
+  ++stats.updates_requested;
+  auto& indices = update_index[&target];
+  for (int i : indices) {
+    if (updates[i].updated == &updated) {
+      return true;
+    }
+  }
+  indices.push_back(updates.size());
+  updates.push_back({&target, &updated});
+  return true;
+}
+
+bool Forget(Connection& connection) {
+  auto it = connection_index.find(&connection);
+  if (it == connection_index.end()) {
+    return false;
+  }
+  connections[it->second] = nullptr;
+  connection_index.erase(it);
+  return true;
+}
+
+void Forget(Location& location) {
+  if (updates.empty()) {
+    return;
+  }
+  if (auto it = update_index.find(&location); it != update_index.end()) {
+    for (int i : it->second) {
+      updates[i].target = nullptr;
+    }
+    update_index.erase(it);
+  }
+  for (auto& update : updates) {
+    if (update.updated == &location) {
+      update.updated = nullptr;
+    }
+  }
+}
+
+Stats GetStats() { return stats; }
+
+}  // namespace bulk_edit
+
+}  // namespace automat
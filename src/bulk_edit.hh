@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+
+namespace automat {
+
+struct Connection;
+struct Location;
+
+// Defers the notifications of graph changes until the whole graph is built.
+//
+// Normally every `Location::ConnectTo` immediately calls `ConnectionAdded`, which (for
+// LiveArguments) starts observing the target & schedules an update. Loading a graph with many
+// edges would schedule an update for every one of them before anything runs.
+//
+// While a BulkEdit is alive, `ConnectionAdded` notifications are queued & updates scheduled through
+// `Location::ScheduleLocalUpdate` are collected. Just like `ScheduleLocalUpdate`, repeated updates
+// of a Location by the same input are coalesced - updates by different inputs are all kept, because
+// `Updated` tells the objects which input changed. When the (outermost) BulkEdit is committed, the
+// queued notifications are delivered in order & then the collected updates are scheduled. All of those updates are scheduled together so
+// they're delivered in a single dataflow wave (see dataflow.hh).
+//
+// BulkEdits can be nested. Only the outermost one commits. Automat thread only.
+//
+//   {
+//     BulkEdit bulk;
+//     for (...) {
+//       a.ConnectTo(b, arg);
+//     }
+//   }  // notifications & updates are issued here
+struct BulkEdit {
+  BulkEdit();
+  ~BulkEdit();  // calls `Commit` if it wasn't called yet
+
+  BulkEdit(const BulkEdit&) = delete;
+  BulkEdit& operator=(const BulkEdit&) = delete;
+
+  void Commit();
+
+ private:
+  bool committed = false;
+};
+
+namespace bulk_edit {
+
+// True while a BulkEdit is alive.
+bool Active();
+
+// Queues the `ConnectionAdded` notification of a new Connection. Returns false if there is no
+// active BulkEdit & the notification should be delivered immediately.
+bool DeferConnectionAdded(Connection&);
+
+// Collects an update of `target` by `updated`, unless the same pair was already collected. Returns
+// false if there is no active BulkEdit & the update should be scheduled immediately.
+bool DeferUpdate(Location& target, Location& updated);
+
+// Called when a Connection is destroyed. Returns true if its `ConnectionAdded` notification was
+// still queued (in which case it's dropped & `ConnectionRemoved` shouldn't be called either).
+bool Forget(Connection&);
+
+// Called when a Location is destroyed. Drops its collected updates.
+void Forget(Location&);
+
+struct Stats {
+  uint64_t commits = 0;
+  uint64_t connections = 0;        // deferred `ConnectionAdded` notifications
+  uint64_t updates_requested = 0;  // calls to `DeferUpdate`
+  uint64_t updates_scheduled = 0;  // updates scheduled by the commits
+};
+
+Stats GetStats();
+
+}  // namespace bulk_edit
+
+}  // namespace automat
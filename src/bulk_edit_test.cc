@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "bulk_edit.hh"
+
+#include <gtest/gtest.h>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+// Counts the updates of its inputs.
+struct Counter : LiveObject {
+  static const Counter proto;
+  static LiveArgument inputs_arg;
+  int updates = 0;
+  string_view Name() const override { return "Counter"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<Counter>(); }
+  void Args(std::function<void(Argument&)> cb) override { cb(inputs_arg); }
+  void Updated(Location& here, Location& updated) override { ++updates; }
+};
+
+const Counter Counter::proto;
+LiveArgument Counter::inputs_arg = LiveArgument("counter inputs", Argument::kRequiresObject);
+
+struct BulkEditTest : TestBase {
+  Location& counter = machine.Create<Counter>();
+  std::vector<Location*> inputs;
+
+  BulkEditTest() {
+    for (int i = 0; i < 10; ++i) {
+      inputs.push_back(&machine.Create<Text>());
+    }
+  }
+
+  void ConnectAll() {
+    for (auto* input : inputs) {
+      counter.ConnectTo(*input, Counter::inputs_arg);
+    }
+  }
+
+  int Updates() { return counter.ThisAs<Counter>()->updates; }
+};
+
+TEST_F(BulkEditTest, WithoutBulkEditEveryConnectionUpdates) {
+  ConnectAll();
+  RunLoop();
+  EXPECT_EQ(Updates(), 10);
+}
+
+// Every input is delivered once, no matter how many times it was updated during the edit.
+TEST_F(BulkEditTest, CoalescesUpdatesByTheSameInput) {
+  auto stats = bulk_edit::GetStats();
+  {
+    BulkEdit bulk;
+    ConnectAll();
+    EXPECT_TRUE(counter.observing_updates.empty());
+    for (auto* input : inputs) {
+      counter.ScheduleLocalUpdate(*input);
+    }
+  }
+  EXPECT_EQ(counter.observing_updates.size(), 10);
+  RunLoop();
+  EXPECT_EQ(Updates(), 10);
+  EXPECT_EQ(bulk_edit::GetStats().connections, stats.connections + 10);
+  EXPECT_EQ(bulk_edit::GetStats().updates_requested, stats.updates_requested + 20);
+  EXPECT_EQ(bulk_edit::GetStats().updates_scheduled, stats.updates_scheduled + 10);
+}
+
+TEST_F(BulkEditTest, NestedEditsCommitOnce) {
+  BulkEdit outer;
+  {
+    BulkEdit inner;
+    ConnectAll();
+  }
+  EXPECT_TRUE(counter.observing_updates.empty());
+  outer.Commit();
+  EXPECT_EQ(counter.observing_updates.size(), 10);
+}
+
+TEST_F(BulkEditTest, RemovedConnectionsAreNeverAnnounced) {
+  {
+    BulkEdit bulk;
+    delete counter.ConnectTo(*inputs[0], Counter::inputs_arg);
+    counter.ConnectTo(*inputs[1], Counter::inputs_arg);
+    machine.Extract(*inputs[1]);  // destroys the input together with its connection
+    counter.ConnectTo(*inputs[2], Counter::inputs_arg);
+  }
+  RunLoop();
+  EXPECT_EQ(counter.observing_updates.size(), 1);
+  EXPECT_EQ(Updates(), 1);
+}
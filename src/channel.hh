@@ -5,74 +5,107 @@
 // atomic is sometimes defined in <atomic> and sometimes in <memory>
 #include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <memory>
 
+#include "concurrentqueue.hh"
+
 namespace automat {
 
-// A channel allows one thread to send a value (by pointer) to another thread.
+// A channel allows many threads to send values (by pointer) to another thread.
 //
 // Passing a value through a channel assumes that ownership is also transferred.
 //
-// A channel contains a one-element buffer so at least one value can be sent
-// wait-free. Every subsequent send may block until the receiver has consumed
-// the value.
+// Values are kept in a lock-free queue so senders never block (unless the allocator blocks). The
+// order of values sent by a single thread is preserved. Values sent by different threads may be
+// interleaved arbitrarily.
+//
+// A channel may optionally be given a capacity. It's only enforced by `try_send` and allows
+// producers to implement back-pressure. `send` ignores the capacity.
 //
 // This channel implementation assumes a single consumer.
 struct channel {
-  std::atomic<void*> atomic{nullptr};
+  moodycamel::ConcurrentQueue<void*> queue;
+
+  // Number of values that were sent but not yet received. The consumer waits on this value when
+  // the queue is empty.
+  //
+  // It's incremented before a value is added to the queue so it's never lower than the actual
+  // number of values in the queue.
+  std::atomic<ptrdiff_t> pending{0};
+
+  // 0 means unbounded.
+  const size_t capacity;
+
+  channel(size_t capacity = 0) : capacity(capacity) {}
 
-  // May block. `ptr` must not be `nullptr`.
+  // Will never block. `ptr` must not be `nullptr`.
   void send(void* ptr) {
     assert(ptr != nullptr);
-    void* expected = nullptr;
-    // We're using the "strong" version because in the next step we wait on the
-    // expected value. If that value would be `nullptr` (which might happen in
-    // the compare_exchange_weak) then we might block forever!
-    while (!atomic.compare_exchange_strong(expected, ptr, std::memory_order_release,
-                                           std::memory_order_relaxed)) {
-      atomic.wait(expected, std::memory_order_relaxed);
-      expected = nullptr;
-    }
-    // Consumer may be waiting so notify it. Side-effect of this is that other
-    // produces will also be notified but it shouldn't matter.
-    // TODO: maybe create a separate condition_variable for the consumer?
-    // TODO: maybe allow for passing stop_token to recv()? (see
-    // condition_variable_any::wait)
-    atomic.notify_all();
+    Enqueue(pending.fetch_add(1, std::memory_order_relaxed), ptr);
   }
 
+  // Returns `nullptr` if the value was sent or `ptr` if the channel was at its capacity.
   void* try_send(void* ptr) {
     assert(ptr != nullptr);
-    void* expected = nullptr;
-    bool success = atomic.compare_exchange_strong(expected, ptr, std::memory_order_release,
-                                                  std::memory_order_relaxed);
-    if (success) {
-      atomic.notify_all();
+    if (capacity == 0) {
+      send(ptr);
       return nullptr;
     }
-    return ptr;
+    ptrdiff_t old_pending = pending.load(std::memory_order_relaxed);
+    do {
+      if (old_pending >= (ptrdiff_t)capacity) {
+        return ptr;
+      }
+    } while (!pending.compare_exchange_weak(old_pending, old_pending + 1,
+                                            std::memory_order_relaxed));
+    Enqueue(old_pending, ptr);
+    return nullptr;
   }
 
   // Will never block.
-  void send_force(void* ptr) {
-    assert(ptr != nullptr);
-    atomic.store(ptr, std::memory_order_release);
-    atomic.notify_all();
-  }
+  //
+  // Kept for compatibility with the single-slot channel, where it used to overwrite the value
+  // waiting in the slot. Now it's equivalent to `send`.
+  void send_force(void* ptr) { send(ptr); }
 
-  void* peek() { return atomic.load(std::memory_order_acquire); }
+  // Will never block. Returns `nullptr` if there is nothing to receive.
+  void* try_recv() {
+    void* ptr = nullptr;
+    if (queue.try_dequeue(ptr)) {
+      pending.fetch_sub(1, std::memory_order_relaxed);
+      return ptr;
+    }
+    return nullptr;
+  }
 
   // May block.
   void* recv() {
-    void* ptr = atomic.exchange(nullptr, std::memory_order_acquire);
-    while (ptr == nullptr) {
-      atomic.wait(nullptr, std::memory_order_relaxed);
-      ptr = atomic.exchange(nullptr, std::memory_order_acquire);
+    void* ptr;
+    while ((ptr = try_recv()) == nullptr) {
+      // When `pending` is non-zero then some value is about to appear in the queue.
+      pending.wait(0, std::memory_order_acquire);
     }
-    atomic.notify_one();
     return ptr;
   }
 
+  // May block until at least one value is available. Then receives up to `max` values without
+  // blocking. Returns the number of received values.
+  size_t recv_bulk(void** out, size_t max) {
+    assert(max > 0);
+    out[0] = recv();
+    size_t n = 1;
+    if (max > 1) {
+      size_t more = queue.try_dequeue_bulk(out + 1, max - 1);
+      pending.fetch_sub(more, std::memory_order_relaxed);
+      n += more;
+    }
+    return n;
+  }
+
+  // Number of values that were sent but not yet received.
+  size_t size() const { return pending.load(std::memory_order_relaxed); }
+
   template <typename T>
   void send(std::unique_ptr<T> ptr) {
     send(ptr.release());
@@ -88,14 +121,22 @@ struct channel {
     return std::unique_ptr<T>(static_cast<T*>(try_send(ptr.release())));
   }
 
+  template <typename T>
+  std::unique_ptr<T> try_recv() {
+    return std::unique_ptr<T>(static_cast<T*>(try_recv()));
+  }
+
   template <typename T>
   std::unique_ptr<T> recv() {
     return std::unique_ptr<T>(static_cast<T*>(recv()));
   }
 
-  template <typename T>
-  T* peek() {
-    return static_cast<T*>(peek());
+  void Enqueue(ptrdiff_t old_pending, void* ptr) {
+    queue.enqueue(ptr);
+    if (old_pending == 0) {
+      // Consumer may be waiting so notify it.
+      pending.notify_one();
+    }
   }
 };
 
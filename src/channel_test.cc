@@ -5,7 +5,10 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <thread>
+#include <vector>
 
 using namespace automat;
 
@@ -38,3 +41,119 @@ TEST(ChannelTest, RecvBeforeSend) {
   }).detach();
   EXPECT_EQ(*c.recv<int>(), 1);
 }
+
+TEST(ChannelTest, TrySendRespectsCapacity) {
+  channel c(2);
+  EXPECT_EQ(c.try_send(std::make_unique<int>(1)), nullptr);
+  EXPECT_EQ(c.try_send(std::make_unique<int>(2)), nullptr);
+  auto rejected = c.try_send(std::make_unique<int>(3));
+  ASSERT_NE(rejected, nullptr);
+  EXPECT_EQ(*rejected, 3);
+  EXPECT_EQ(*c.recv<int>(), 1);
+  EXPECT_EQ(c.try_send(std::make_unique<int>(4)), nullptr);
+  EXPECT_EQ(*c.recv<int>(), 2);
+  EXPECT_EQ(*c.recv<int>(), 4);
+  EXPECT_EQ(c.try_recv<int>(), nullptr);
+}
+
+TEST(ChannelTest, SendNeverBlocks) {
+  channel c;
+  for (int i = 0; i < 1000; ++i) {
+    c.send(std::make_unique<int>(i));
+  }
+  EXPECT_EQ(c.size(), 1000);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(*c.recv<int>(), i);  // single producer keeps its order
+  }
+}
+
+TEST(ChannelTest, RecvBulk) {
+  channel c;
+  for (int i = 0; i < 10; ++i) {
+    c.send(std::make_unique<int>(i));
+  }
+  void* batch[4];
+  EXPECT_EQ(c.recv_bulk(batch, 4), 4);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(*std::unique_ptr<int>(static_cast<int*>(batch[i])), i);
+  }
+  void* rest[16];
+  EXPECT_EQ(c.recv_bulk(rest, 16), 6);
+  for (int i = 0; i < 6; ++i) {
+    delete static_cast<int*>(rest[i]);
+  }
+  EXPECT_EQ(c.size(), 0);
+}
+
+// Benchmarks. They don't check anything beyond the delivery of all messages but print the
+// throughput & latency of the channel with different numbers of producers. Disabled by default -
+// run with `--gtest_also_run_disabled_tests --gtest_filter=*Benchmark*`.
+
+constexpr int kBenchmarkProducers[] = {1, 2, 4, 8, 16, 32, 64};
+
+TEST(ChannelTest, DISABLED_BenchmarkThroughput) {
+  constexpr int kMessages = 1 << 20;
+  for (int producers : kBenchmarkProducers) {
+    channel c;
+    int per_producer = kMessages / producers;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::jthread> threads;
+    for (int p = 0; p < producers; ++p) {
+      threads.emplace_back([&c, per_producer] {
+        for (int i = 0; i < per_producer; ++i) {
+          c.send(reinterpret_cast<void*>(uintptr_t(i + 1)));
+        }
+      });
+    }
+    constexpr size_t kBatch = 256;
+    void* batch[kBatch];
+    int received = 0;
+    while (received < per_producer * producers) {
+      received += c.recv_bulk(batch, kBatch);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    threads.clear();
+    EXPECT_EQ(received, per_producer * producers);
+    printf("%2d producers: %6.1f M messages / s\n", producers,
+           received / elapsed.count() / 1'000'000);
+  }
+}
+
+TEST(ChannelTest, DISABLED_BenchmarkLatency) {
+  constexpr int kMessages = 1 << 14;
+  using Clock = std::chrono::steady_clock;
+  for (int producers : kBenchmarkProducers) {
+    channel c;
+    int per_producer = kMessages / producers;
+    int total = per_producer * producers;
+    std::vector<Clock::time_point> sent(total);
+    std::vector<double> latencies;
+    latencies.reserve(total);
+    std::vector<std::jthread> threads;
+    for (int p = 0; p < producers; ++p) {
+      threads.emplace_back([&, p] {
+        for (int i = 0; i < per_producer; ++i) {
+          auto& slot = sent[p * per_producer + i];
+          slot = Clock::now();
+          c.send(&slot);
+          if (i % 16 == 0) {
+            // Give the consumer a chance to go to sleep so that wake-ups are also measured.
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (int i = 0; i < total; ++i) {
+      auto* slot = static_cast<Clock::time_point*>(c.recv());
+      latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - *slot).count());
+    }
+    threads.clear();
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (double l : latencies) {
+      sum += l;
+    }
+    printf("%2d producers: mean %7.2f us, p50 %7.2f us, p99 %8.2f us\n", producers,
+           sum / total, latencies[total / 2], latencies[total * 99 / 100]);
+  }
+}
@@ -2,26 +2,21 @@
 // SPDX-License-Identifier: MIT
 #include "connection.hh"
 
+#include "bulk_edit.hh"
+#include "journal.hh"
 #include "location.hh"
 
 namespace automat {
 
 Connection::~Connection() {
-  from.object->ConnectionRemoved(from, *this);
-  auto [begin, end] = from.outgoing.equal_range(this);
-  for (auto it = begin; it != end; ++it) {
-    if (*it == this) {
-      from.outgoing.erase(it);
-      break;
-    }
-  }
-  auto [begin2, end2] = to.incoming.equal_range(this);
-  for (auto it = begin2; it != end2; ++it) {
-    if (*it == this) {
-      to.incoming.erase(it);
-      break;
-    }
+  journal::ConnectionRemoved(*this);
+  // Connections whose `ConnectionAdded` is still queued by a BulkEdit were never announced.
+  if (!bulk_edit::Forget(*this)) {
+    from.object->ConnectionRemoved(from, *this);
   }
+  from.outgoing.erase(this);
+  from.resolved_arguments.clear();
+  to.incoming.erase(this);
 }
 
 Connection::Connection(Argument& arg, Location& from, Location& to,
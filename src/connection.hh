@@ -2,8 +2,7 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
-#include <functional>
-#include <type_traits>
+#include "arena.hh"
 
 namespace automat {
 
@@ -17,23 +16,21 @@ struct Connection {
   PointerBehavior pointer_behavior;
   Connection(Argument&, Location& from, Location& to, PointerBehavior);
   ~Connection();
-};
 
-struct ConnectionHasher {
-  using is_transparent = std::true_type;
-  size_t operator()(const Connection* c) const {
-    return std::hash<const Argument*>{}(&c->argument);
+  // Connections live in the arena of the Machine that holds their `from` Location.
+  static void* operator new(size_t size) { return Arena::Alloc(Arena::current, size); }
+  static void* operator new(size_t size, std::align_val_t alignment) {
+    return Arena::Alloc(Arena::current, size, alignment);
+  }
+  static void operator delete(void* ptr) { Arena::Free(ptr); }
+  static void operator delete(void* ptr, std::align_val_t alignment) {
+    Arena::Free(ptr, alignment);
   }
-  size_t operator()(const Argument* a) const { return std::hash<const Argument*>{}(a); }
 };
 
-struct ConnectionEqual {
-  using is_transparent = std::true_type;
-  bool operator()(const Connection* a, const Connection* b) const {
-    return &a->argument == &b->argument;
-  }
-  bool operator()(const Connection* a, const Argument* b) const { return &a->argument == b; }
-  bool operator()(const Argument* a, const Connection* b) const { return a == &b->argument; }
+// Connections are looked up by their Argument. See `AdjacencySet`.
+struct ConnectionKey {
+  const void* operator()(const Connection* c) const { return &c->argument; }
 };
 
 }  // namespace automat
\ No newline at end of file
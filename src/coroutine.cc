@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "coroutine.hh"
+
+#include <cstdlib>
+
+#include "task_pool.hh"
+
+namespace automat {
+
+// Pool of coroutine frames. Frames are usually larger than tasks so they get their own size
+// classes: frames up to 2 KiB are pooled, at most 64 per size class.
+using FramePool = task_pool::ThreadPool<64, 32, 64>;
+
+void* Coroutine::promise_type::operator new(std::size_t size) { return FramePool::Alloc(size); }
+
+void Coroutine::promise_type::operator delete(void* ptr, std::size_t size) {
+  FramePool::Free(ptr, size);
+}
+
+void Coroutine::promise_type::unhandled_exception() { std::abort(); }
+
+void Coroutine::Reset() {
+  if (handle) {
+    handle.destroy();
+    handle = nullptr;
+  }
+}
+
+CoroutineFrameStats& GetCoroutineFrameStats() { return FramePool::ThreadStats(); }
+
+LongRunning* CoRunnable::OnRun(Location& here) {
+  routine_here = &here;
+  cancelled = false;
+  waiting = Wait::Nothing;
+  coroutine = Routine(here);
+  coroutine.handle.resume();
+  if (coroutine.handle.done()) {
+    coroutine.Reset();
+    return nullptr;
+  }
+  return this;
+}
+
+void CoRunnable::Resume() {
+  waiting = Wait::Nothing;
+  coroutine.handle.resume();
+  if (coroutine.handle.done()) {
+    coroutine.Reset();
+    Done(*routine_here);
+  }
+}
+
+void CoRunnable::Cancel() {
+  if (!coroutine.handle) {
+    return;
+  }
+  cancelled = true;
+  if (waiting == Wait::Timer) {
+    CancelScheduledAt(*routine_here, wake_time);
+  }
+  waiting = Wait::Nothing;
+  // Awaitables complete immediately from now on so the coroutine should run to its end.
+  coroutine.handle.resume();
+  coroutine.Reset();
+}
+
+void CoRunnable::OnTimerNotification(Location&, time::SteadyPoint time) {
+  // Notifications of the timers that were already cancelled or rescheduled (for example by
+  // `RescheduleSleep`) may still be on their way. They're ignored.
+  if (waiting == Wait::Timer && time == wake_time) {
+    Resume();
+  }
+}
+
+bool CoRunnable::ResumeOnUpdate(Location& updated) {
+  if (waiting != Wait::Update) {
+    return false;
+  }
+  update = &updated;
+  Resume();
+  return true;
+}
+
+void CoRunnable::RescheduleSleep(time::SteadyPoint deadline) {
+  if (waiting != Wait::Timer) {
+    return;
+  }
+  CancelScheduledAt(*routine_here, wake_time);
+  wake_time = deadline;
+  ScheduleAt(*routine_here, wake_time);
+}
+
+void CoRunnable::SleepAwaiter::await_suspend(std::coroutine_handle<>) {
+  runnable.waiting = Wait::Timer;
+  runnable.wake_time = deadline;
+  ScheduleAt(*runnable.routine_here, deadline);
+}
+
+void CoRunnable::UpdateAwaiter::await_suspend(std::coroutine_handle<>) {
+  runnable.waiting = Wait::Update;
+}
+
+Location* CoRunnable::UpdateAwaiter::await_resume() const {
+  if (runnable.cancelled) {
+    return nullptr;
+  }
+  return std::exchange(runnable.update, nullptr);
+}
+
+}  // namespace automat
@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "base.hh"
+#include "task_pool.hh"
+#include "time.hh"
+#include "timer_thread.hh"
+
+namespace automat {
+
+// Owning handle of a coroutine started by `CoRunnable`.
+//
+// Coroutine frames are allocated from a per-thread pool so starting a coroutine usually doesn't
+// touch the general-purpose allocator. Suspending & resuming never allocates.
+struct Coroutine {
+  struct promise_type {
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+
+    Coroutine get_return_object() { return Coroutine(Handle::from_promise(*this)); }
+    // The body is started by `CoRunnable::OnRun`.
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    // The frame is released by the owning `Coroutine`.
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception();
+  };
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Handle handle;
+
+  Coroutine() = default;
+  explicit Coroutine(Handle handle) : handle(handle) {}
+  Coroutine(Coroutine&& other) : handle(std::exchange(other.handle, nullptr)) {}
+  Coroutine& operator=(Coroutine&& other) {
+    Reset();
+    handle = std::exchange(other.handle, nullptr);
+    return *this;
+  }
+  ~Coroutine() { Reset(); }
+
+  void Reset();
+};
+
+// Frames that went through the general-purpose allocator, frames served from the pool, etc.
+using CoroutineFrameStats = task_pool::Stats;
+
+// Statistics of the current thread.
+CoroutineFrameStats& GetCoroutineFrameStats();
+
+// Coroutine flavour of `Runnable`.
+//
+// Instead of building a state machine out of `OnRun`, `Cancel` & `OnTimerNotification`, objects
+// implement `Routine` as a coroutine that waits for timers & updates with `co_await`:
+//
+//   Coroutine Routine(Location& here) override {
+//     while (co_await SleepFor(1s)) {
+//       here.ScheduleUpdate();
+//     }
+//   }
+//
+// The coroutine is always resumed on the Automat thread - by the timer notifications and by the
+// updates that the object receives. Once it returns, the object is done and its "next" Location is
+// scheduled. Cancellation resumes the coroutine one last time so that it may clean up. From then
+// on, all of the awaitables complete immediately and report the cancellation.
+struct CoRunnable : Runnable, LongRunning, TimerNotificationReceiver {
+  CoRunnable() = default;
+  // Copies start idle.
+  CoRunnable(const CoRunnable&) : CoRunnable() {}
+
+  virtual Coroutine Routine(Location& here) = 0;
+
+  LongRunning* OnRun(Location& here) override;
+  // Must not be called from within `Routine`.
+  void Cancel() override;
+  void OnTimerNotification(Location&, time::SteadyPoint) override;
+
+  // Objects that `co_await NextUpdate()` should call this from `Object::Updated`. Returns true if
+  // the update was delivered to the coroutine.
+  bool ResumeOnUpdate(Location& updated);
+
+  struct SleepAwaiter {
+    CoRunnable& runnable;
+    time::SteadyPoint deadline;
+    bool await_ready() const { return runnable.cancelled; }
+    void await_suspend(std::coroutine_handle<>);
+    // False if the coroutine was cancelled.
+    bool await_resume() const { return !runnable.cancelled; }
+  };
+
+  struct UpdateAwaiter {
+    CoRunnable& runnable;
+    bool await_ready() const { return runnable.cancelled; }
+    void await_suspend(std::coroutine_handle<>);
+    // The Location that was updated or nullptr if the coroutine was cancelled.
+    Location* await_resume() const;
+  };
+
+  SleepAwaiter SleepUntil(time::SteadyPoint deadline) { return {*this, deadline}; }
+  SleepAwaiter SleepFor(time::Duration duration) { return {*this, time::SteadyNow() + duration}; }
+  UpdateAwaiter NextUpdate() { return {*this}; }
+
+  // Moves the deadline of the pending `SleepUntil`. Does nothing if the coroutine isn't sleeping.
+  void RescheduleSleep(time::SteadyPoint deadline);
+
+  bool Cancelled() const { return cancelled; }
+
+ private:
+  enum class Wait : uint8_t { Nothing, Timer, Update };
+
+  Coroutine coroutine;
+  Location* routine_here = nullptr;
+  Location* update = nullptr;
+  time::SteadyPoint wake_time;
+  Wait waiting = Wait::Nothing;
+  bool cancelled = false;
+
+  void Resume();
+};
+
+}  // namespace automat
@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "coroutine.hh"
+
+#include <gtest/gtest.h>
+
+#include "base.hh"
+#include "test_base.hh"
+#include "timer_thread.hh"
+
+using namespace automat;
+using namespace std::chrono_literals;
+
+// Ticks three times, then waits for an update & finishes.
+struct Ticker : LiveObject, CoRunnable {
+  static const Ticker proto;
+  int ticks = 0;
+  bool cleaned_up = false;
+  Location* last_update = nullptr;
+  string_view Name() const override { return "Ticker"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<Ticker>(); }
+  Coroutine Routine(Location& here) override {
+    for (int i = 0; i < 3; ++i) {
+      if (!co_await SleepFor(1h)) {
+        cleaned_up = true;
+        co_return;
+      }
+      ++ticks;
+    }
+    last_update = co_await NextUpdate();
+  }
+  void Updated(Location& here, Location& updated) override { ResumeOnUpdate(updated); }
+};
+
+const Ticker Ticker::proto;
+
+struct CoroutineTest : TestBase {
+  Location& location = machine.Create<Ticker>("ticker");
+  Ticker& ticker = *location.ThisAs<Ticker>();
+  Location& source = machine.Create<Ticker>("source");
+
+  CoroutineTest() {
+    time::EnableVirtualTime();
+    location.ObserveUpdates(source);
+  }
+  ~CoroutineTest() {
+    time::ResetClock();
+    ResetTimers();
+  }
+
+  void RunTimers() {
+    RunLoop();
+    while (JumpToNextTimer()) {
+      RunLoop();
+    }
+  }
+};
+
+TEST_F(CoroutineTest, SleepsAndWaitsForUpdates) {
+  location.ScheduleRun();
+  RunTimers();
+  EXPECT_EQ(3, ticker.ticks);
+  EXPECT_NE(nullptr, location.long_running);  // waiting for an update
+  source.ScheduleUpdate();
+  RunLoop();
+  EXPECT_EQ(&source, ticker.last_update);
+  EXPECT_EQ(nullptr, location.long_running);
+  EXPECT_FALSE(ticker.cleaned_up);
+}
+
+TEST_F(CoroutineTest, CancelResumesForCleanup) {
+  location.ScheduleRun();
+  RunLoop();
+  ASSERT_NE(nullptr, location.long_running);
+  EXPECT_EQ(1, ScheduledTimerCount());
+  location.long_running->Cancel();
+  location.long_running = nullptr;
+  EXPECT_TRUE(ticker.cleaned_up);
+  EXPECT_EQ(0, ticker.ticks);
+  EXPECT_EQ(0, ScheduledTimerCount());
+}
+
+TEST_F(CoroutineTest, FramesArePooled) {
+  location.ScheduleRun();
+  RunLoop();
+  location.long_running->Cancel();
+  location.long_running = nullptr;
+  auto before = GetCoroutineFrameStats();
+  location.ScheduleRun();
+  RunLoop();
+  auto after = GetCoroutineFrameStats();
+  EXPECT_EQ(before.allocated, after.allocated);
+  EXPECT_EQ(before.reused + 1, after.reused);
+}
+
+// Notification of the old deadline may still arrive after `RescheduleSleep`. It mustn't wake the
+// coroutine early.
+TEST_F(CoroutineTest, StaleTimerNotificationsAreIgnored) {
+  auto start = time::SteadyNow();
+  location.ScheduleRun();
+  RunLoop();
+  ticker.RescheduleSleep(start + 2h);
+  ticker.OnTimerNotification(location, start + 1h);
+  EXPECT_EQ(0, ticker.ticks);
+  ticker.OnTimerNotification(location, start + 2h);
+  EXPECT_EQ(1, ticker.ticks);
+  location.long_running->Cancel();
+  location.long_running = nullptr;
+}
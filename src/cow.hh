@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <memory>
+
+namespace automat {
+
+// Copies the payload of a Cow. Specialize (or pass a different functor to Cow) for payloads that
+// can't be copy-constructed.
+template <typename T>
+struct CowCopy {
+  T operator()(const T& value) const { return value; }
+};
+
+// Copy-on-write value.
+//
+// Copies of a Cow share their payload until one of them calls `Write`, which makes a private copy
+// of the payload first (if it's still shared). Reads never copy. This is meant for large state of
+// objects that is rarely modified (recorded timestamps, list contents, ...) so that cloning the
+// objects doesn't have to copy it.
+//
+// Not thread-safe. Copies that share a payload may only be modified from a single thread.
+template <typename T, typename Copy = CowCopy<T>>
+struct Cow {
+  Cow() = default;
+  Cow(T value) : payload(std::make_shared<T>(std::move(value))) {}
+
+  const T& operator*() const { return payload ? *payload : Empty(); }
+  const T* operator->() const { return &**this; }
+
+  // Returns a payload that can be modified without affecting the other copies.
+  T& Write() {
+    if (payload == nullptr) {
+      payload = std::make_shared<T>();
+    } else if (payload.use_count() > 1) {
+      payload = std::make_shared<T>(Copy()(*payload));
+    }
+    return *payload;
+  }
+
+  // True if the payload is shared with other copies.
+  bool Shared() const { return payload.use_count() > 1; }
+
+ private:
+  std::shared_ptr<T> payload;  // null until the first `Write` (or when empty)
+
+  static const T& Empty() {
+    static const T empty;
+    return empty;
+  }
+};
+
+}  // namespace automat
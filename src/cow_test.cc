@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "cow.hh"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace automat;
+
+TEST(CowTest, CopiesShareUntilWritten) {
+  Cow<std::vector<int>> a;
+  EXPECT_TRUE(a->empty());
+  a.Write() = {1, 2, 3};
+  Cow<std::vector<int>> b = a;
+  EXPECT_TRUE(a.Shared());
+  EXPECT_EQ(&*a, &*b);
+
+  b.Write().push_back(4);
+  EXPECT_FALSE(a.Shared());
+  EXPECT_EQ(*a, (std::vector<int>{1, 2, 3}));
+  EXPECT_EQ(*b, (std::vector<int>{1, 2, 3, 4}));
+
+  // Unshared payloads are modified in place.
+  const int* data = b->data();
+  b.Write()[0] = 0;
+  EXPECT_EQ(b->data(), data);
+}
@@ -0,0 +1,206 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "dataflow.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base.hh"
+#include "tasks.hh"
+
+namespace automat::dataflow {
+
+bool enabled = true;
+
+DisabledGuard::DisabledGuard() : was_enabled(std::exchange(enabled, false)) {}
+DisabledGuard::~DisabledGuard() { enabled = was_enabled; }
+
+namespace {
+
+struct Node {
+  Location* location;  // nullptr once the Location is destroyed
+  // Inputs that changed, in the order of their first update. Destroyed inputs are set to nullptr.
+  std::vector<Location*> inputs;
+  // Marked nodes that observe this node.
+  std::vector<int> observers;
+  // Number of marked inputs that weren't visited yet.
+  int pending = 0;
+  bool visited = false;
+};
+
+struct Wave {
+  UpdateTask* leader = nullptr;
+  // Lane of the task queue that the leader waits in.
+  Priority lane = Priority::Dataflow;
+  std::vector<Node> nodes;
+  std::unordered_map<Location*, int> index;
+
+  int Add(Location& location) {
+    auto [it, inserted] = index.try_emplace(&location, (int)nodes.size());
+    if (inserted) {
+      nodes.push_back(Node{.location = &location});
+    }
+    return it->second;
+  }
+};
+
+Wave next_wave;
+Wave* running = nullptr;
+Stats stats;
+
+void AddInput(Node& node, Location& updated) {
+  if (std::find(node.inputs.begin(), node.inputs.end(), &updated) != node.inputs.end()) {
+    ++stats.merged;
+    return;
+  }
+  node.inputs.push_back(&updated);
+}
+
+bool Participates(Location& location) {
+  return location.ThisAs<ThreadSafe>() == nullptr && !NoScheduling(&location);
+}
+
+// Point the leader of the next wave at one of its live nodes. Drops the wave if there are none.
+void Retarget() {
+  for (auto& node : next_wave.nodes) {
+    if (node.location == nullptr) {
+      continue;
+    }
+    for (Location* input : node.inputs) {
+      if (input) {
+        next_wave.leader->target = node.location;
+        next_wave.leader->updated = input;
+        return;
+      }
+    }
+  }
+  // The leader is removed from the queue together with its target (see `~Location`).
+  next_wave = {};
+}
+
+}  // namespace
+
+bool Schedule(Location& target, Location& updated) {
+  if (!enabled || !Participates(target)) {
+    return false;
+  }
+  if (running) {
+    if (auto it = running->index.find(&target); it != running->index.end()) {
+      Node& node = running->nodes[it->second];
+      if (!node.visited) {
+        AddInput(node, updated);
+        return true;
+      }
+    }
+  }
+  AddInput(next_wave.nodes[next_wave.Add(target)], updated);
+  if (next_wave.leader == nullptr) {
+    next_wave.leader = new UpdateTask(&target, &updated);
+    next_wave.leader->leads_wave = true;
+    next_wave.lane = queue.LaneFor(*next_wave.leader);
+    next_wave.leader->Schedule();
+  } else if (Priority lane = queue.LaneFor(*next_wave.leader); lane < next_wave.lane) {
+    queue.Promote(next_wave.leader, next_wave.lane, lane);
+    next_wave.lane = lane;
+  }
+  return true;
+}
+
+void ExecuteWave(UpdateTask& leader) {
+  assert(running == nullptr);
+  if (next_wave.leader != &leader) {
+    return;  // the wave was dropped by `Forget`
+  }
+  Wave wave = std::move(next_wave);
+  next_wave = {};
+  ++stats.waves;
+
+  // Mark everything that can be reached from the updated Locations. `nodes` grows while it's
+  // traversed so it must be indexed.
+  for (int i = 0; i < (int)wave.nodes.size(); ++i) {
+    Location* location = wave.nodes[i].location;
+    if (location == nullptr) {
+      continue;
+    }
+    for (Location* observer : location->update_observers) {
+      if (!Participates(*observer)) {
+        continue;
+      }
+      int j = wave.Add(*observer);
+      wave.nodes[i].observers.push_back(j);
+      ++wave.nodes[j].pending;
+    }
+  }
+
+  // Kahn's algorithm. Updates scheduled by `Updated` are added to the `inputs` of the unvisited
+  // nodes so `running` must be set before any update is delivered.
+  running = &wave;
+  std::deque<int> ready;
+  for (int i = 0; i < (int)wave.nodes.size(); ++i) {
+    if (wave.nodes[i].pending == 0) {
+      ready.push_back(i);
+    }
+  }
+  int first_unvisited = 0;
+  for (int visited = 0; visited < (int)wave.nodes.size(); ++visited) {
+    int i;
+    if (!ready.empty()) {
+      i = ready.front();
+      ready.pop_front();
+    } else {  // cycle
+      while (wave.nodes[first_unvisited].visited) {
+        ++first_unvisited;
+      }
+      i = first_unvisited;
+    }
+    wave.nodes[i].visited = true;
+    if (wave.nodes[i].inputs.empty()) {
+      ++stats.skipped;
+    }
+    // `Updated` may destroy Locations so the node is re-read after every call.
+    for (int k = 0; k < (int)wave.nodes[i].inputs.size(); ++k) {
+      Location* location = wave.nodes[i].location;
+      Location* input = wave.nodes[i].inputs[k];
+      if (location && input) {
+        ++stats.updates;
+        location->Updated(*input);
+      }
+    }
+    for (int j : wave.nodes[i].observers) {
+      Node& observer = wave.nodes[j];
+      if (!observer.visited && --observer.pending == 0) {
+        ready.push_back(j);
+      }
+    }
+  }
+  running = nullptr;
+}
+
+void Forget(Location& location) {
+  auto forget = [&](Wave& wave) {
+    if (auto it = wave.index.find(&location); it != wave.index.end()) {
+      wave.nodes[it->second].location = nullptr;
+      wave.index.erase(it);
+    }
+    for (auto& node : wave.nodes) {
+      std::replace(node.inputs.begin(), node.inputs.end(), &location, (Location*)nullptr);
+    }
+  };
+  if (running) {
+    forget(*running);
+  }
+  if (next_wave.leader) {
+    forget(next_wave);
+    if (next_wave.leader->target == &location || next_wave.leader->updated == &location) {
+      Retarget();
+    }
+  }
+}
+
+Stats GetStats() { return stats; }
+
+}  // namespace automat::dataflow
@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+
+namespace automat {
+
+struct Location;
+struct UpdateTask;
+
+// Glitch-free propagation of updates between Locations.
+//
+// Updates that are scheduled on the Automat thread (see `Location::ScheduleLocalUpdate`) are
+// collected into a "wave" instead of getting a task each. The wave is executed by a single
+// UpdateTask (its "leader"), which is queued when the first update of the wave is scheduled. The
+// leader is moved to the lane of the most urgent update that joins the wave (see `TaskQueue`), so
+// updates caused by input aren't delayed by the background work.
+//
+// The wave marks every Location that can be reached from the updated Locations through
+// `update_observers` & then delivers the updates in topological order. Each Location receives the
+// updates of its changed inputs only after all of its (marked) inputs have been recomputed, so it
+// never observes a half-updated graph.
+//
+// A Location is visited once per wave but it still gets one `Updated` call for every input that
+// changed. `Updated` identifies a single input & several objects act only on the one that changed
+// (Switch, NumberField, ComboBox, MathEngine), so merging the calls would drop updates. The calls
+// are delivered back-to-back, so all of them see the same, final values of the inputs.
+//
+// Updates scheduled during the wave join it, as long as their target wasn't visited yet. Locations
+// whose inputs didn't change (because their inputs decided that their values stayed the same &
+// didn't call `ScheduleUpdate`) are skipped.
+//
+// Cycles are broken by visiting the earliest marked Location first. Its later updates go to the
+// next wave.
+//
+// Thread-safe objects & updates with successors (see `NextGuard`) don't take part in waves.
+namespace dataflow {
+
+// Can be turned off to deliver each update through its own UpdateTask.
+extern bool enabled;
+
+// Turns the waves off within its scope.
+struct DisabledGuard {
+  bool was_enabled;
+  DisabledGuard();
+  ~DisabledGuard();
+};
+
+// Adds the update to the next wave. Returns false if the update should be delivered through a
+// regular UpdateTask instead.
+bool Schedule(Location& target, Location& updated);
+
+// Called by the leader of the wave.
+void ExecuteWave(UpdateTask& leader);
+
+// Removes the Location from the pending waves. Called when the Location is destroyed.
+void Forget(Location&);
+
+struct Stats {
+  uint64_t waves = 0;
+  uint64_t updates = 0;  // calls to `Location::Updated`
+  uint64_t skipped = 0;  // marked Locations whose inputs didn't change
+  uint64_t merged = 0;   // updates dropped because the same input already changed in the wave
+};
+
+Stats GetStats();
+
+}  // namespace dataflow
+
+}  // namespace automat
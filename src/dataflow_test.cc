@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "dataflow.hh"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "base.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+// Sum of the Cells that it observes. Notifies its observers only when the sum changes.
+struct Cell : LiveObject {
+  static const Cell proto;
+  int value = 0;
+  std::vector<int> computed;          // sums computed by every update
+  std::vector<Location*> updated_by;  // inputs passed to every update
+  string_view Name() const override { return "Cell"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<Cell>(); }
+  void Updated(Location& here, Location& updated) override {
+    int sum = 0;
+    for (auto input : here.observing_updates) {
+      sum += input->ThisAs<Cell>()->value;
+    }
+    computed.push_back(sum);
+    updated_by.push_back(&updated);
+    if (sum != value) {
+      value = sum;
+      here.ScheduleUpdate();
+    }
+  }
+};
+
+const Cell Cell::proto;
+
+// a ─> b ─> b2 ─> b3 ─> d ─> e
+// └──> c ──────────────┘
+struct DataflowTest : TestBase {
+  Location& a = machine.Create<Cell>("a");
+  Location& b = machine.Create<Cell>("b");
+  Location& b2 = machine.Create<Cell>("b2");
+  Location& b3 = machine.Create<Cell>("b3");
+  Location& c = machine.Create<Cell>("c");
+  Location& d = machine.Create<Cell>("d");
+  Location& e = machine.Create<Cell>("e");
+
+  DataflowTest() {
+    b.ObserveUpdates(a);
+    b2.ObserveUpdates(b);
+    c.ObserveUpdates(a);
+    b3.ObserveUpdates(b2);
+    d.ObserveUpdates(b3);
+    d.ObserveUpdates(c);
+    e.ObserveUpdates(d);
+  }
+
+  Cell& operator[](Location& l) { return *l.ThisAs<Cell>(); }
+};
+
+TEST_F(DataflowTest, DiamondIsGlitchFree) {
+  auto stats = dataflow::GetStats();
+  (*this)[a].value = 1;
+  a.ScheduleUpdate();
+  RunLoop();
+  // `d` is visited once, after both of its inputs were recomputed. It gets one update for each of
+  // them & every one of them already sees the final sum - never the intermediate 1.
+  EXPECT_EQ((*this)[d].updated_by, (std::vector<Location*>{&c, &b3}));
+  EXPECT_EQ((*this)[d].computed, (std::vector<int>{2, 2}));
+  // The second update of `d` didn't change its value so `e` is recomputed once.
+  EXPECT_EQ((*this)[e].computed, (std::vector<int>{2}));
+  EXPECT_EQ(dataflow::GetStats().waves, stats.waves + 1);
+}
+
+TEST_F(DataflowTest, UnchangedValuesCutOffPropagation) {
+  auto stats = dataflow::GetStats();
+  a.ScheduleUpdate();  // `a` is still 0 so `b` & `c` don't change
+  RunLoop();
+  EXPECT_EQ(dataflow::GetStats().skipped, stats.skipped + 4);
+  EXPECT_EQ((*this)[b].computed, (std::vector<int>{0}));
+  EXPECT_EQ((*this)[c].computed, (std::vector<int>{0}));
+  EXPECT_TRUE((*this)[b2].computed.empty());
+  EXPECT_TRUE((*this)[b3].computed.empty());
+  EXPECT_TRUE((*this)[d].computed.empty());
+  EXPECT_TRUE((*this)[e].computed.empty());
+}
+
+TEST_F(DataflowTest, DisabledDeliversEachUpdate) {
+  dataflow::DisabledGuard disabled;
+  (*this)[a].value = 1;
+  a.ScheduleUpdate();
+  RunLoop();
+  // `d` sees the new value of `c` before the new value of `b3` reaches it.
+  EXPECT_EQ((*this)[d].computed, (std::vector<int>{1, 2}));
+  EXPECT_EQ((*this)[e].computed, (std::vector<int>{1, 2}));
+}
+
+TEST_F(DataflowTest, LeaderTakesTheMostUrgentLane) {
+  RunLoop();
+  a.ScheduleUpdate();
+  EXPECT_EQ(1, queue.lanes[(int)Priority::Dataflow].size());
+  // Update caused by the input joins the wave that was started by the background work.
+  queue.current = Priority::Input;
+  c.ScheduleUpdate();
+  queue.current = Priority::Dataflow;
+  EXPECT_TRUE(queue.lanes[(int)Priority::Dataflow].empty());
+  EXPECT_EQ(1, queue.lanes[(int)Priority::Input].size());
+  auto stats = dataflow::GetStats();
+  RunLoop();
+  EXPECT_EQ(dataflow::GetStats().waves, stats.waves + 1);
+}
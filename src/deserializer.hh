@@ -5,11 +5,29 @@
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/reader.h>
 
+#include <span>
+
 #include "status.hh"
 
 namespace automat {
 
-using Serializer = rapidjson::PrettyWriter<rapidjson::StringBuffer>;
+// Binary snapshots (see snapshot.hh) keep large arrays of numbers, such as the timestamps of
+// Timeline tracks, outside of the JSON. Plain JSON keeps them inline.
+struct SampleSink {
+  // Returns the index under which the samples can be loaded from the matching `SampleSource`.
+  virtual int Store(std::span<const double>) = 0;
+};
+
+struct SampleSource {
+  // The samples point into the snapshot so they must be copied.
+  virtual std::span<const double> Load(int index, maf::Status&) = 0;
+};
+
+struct Serializer : rapidjson::PrettyWriter<rapidjson::StringBuffer> {
+  using PrettyWriter::PrettyWriter;
+  // Set when the state is saved into a binary snapshot.
+  SampleSink* samples = nullptr;
+};
 
 struct JsonToken {
   enum TokenType {
@@ -51,6 +69,9 @@ maf::Str ToStr(const JsonToken&);
 
 struct Deserializer {
   Deserializer(rapidjson::InsituStringStream&);
+  // Set when the state is loaded from a binary snapshot.
+  SampleSource* samples = nullptr;
+
   void Get(maf::Str&, maf::Status&);
   void Get(double&, maf::Status&);
   void Get(float&, maf::Status&);
@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "executor.hh"
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base.hh"
+#include "format.hh"
+#include "tasks.hh"
+#include "thread_name.hh"
+#include "trace.hh"
+
+namespace automat::executor {
+
+struct Worker {
+  int index;
+  std::jthread thread;
+
+  // Owner pushes & pops from the back. Thieves take from the front.
+  //
+  // The critical sections are a couple of instructions long so a plain mutex is enough here. It's
+  // only contended when somebody is stealing.
+  std::mutex mutex;
+  std::deque<Task*> tasks;
+
+  void Push(Task& task) {
+    std::lock_guard lock(mutex);
+    tasks.push_back(&task);
+  }
+
+  Task* PopBack() {
+    std::lock_guard lock(mutex);
+    if (tasks.empty()) {
+      return nullptr;
+    }
+    Task* task = tasks.back();
+    tasks.pop_back();
+    return task;
+  }
+
+  Task* PopFront() {
+    std::lock_guard lock(mutex);
+    if (tasks.empty()) {
+      return nullptr;
+    }
+    Task* task = tasks.front();
+    tasks.pop_front();
+    return task;
+  }
+};
+
+static std::vector<std::unique_ptr<Worker>> workers;
+static thread_local Worker* current_worker = nullptr;
+static int next_worker = 0;  // round-robin index, only accessed from the Automat thread
+
+// Number of tasks that are waiting in the worker deques. Used to put idle workers to sleep.
+static std::atomic<int> queued = 0;
+// Number of tasks that were handed over to the workers and haven't finished yet.
+static std::atomic<int> in_flight = 0;
+
+static std::mutex idle_mutex;
+static std::condition_variable idle_cv;
+static bool stop = false;  // protected by idle_mutex
+
+// Tasks sent back from the workers to the Automat thread.
+static std::mutex pinned_mutex;
+static std::condition_variable pinned_cv;
+static std::vector<Task*> pinned;
+
+static std::atomic<uint64_t> stat_submitted = 0;
+static std::atomic<uint64_t> stat_spawned = 0;
+static std::atomic<uint64_t> stat_executed = 0;
+static std::atomic<uint64_t> stat_stolen = 0;
+static std::atomic<uint64_t> stat_pinned = 0;
+
+static void Enqueue(Worker& worker, Task& task) {
+  in_flight.fetch_add(1, std::memory_order_relaxed);
+  worker.Push(task);
+  queued.fetch_add(1, std::memory_order_release);
+  {
+    // Taking the lock ensures that a worker which is about to go to sleep sees the new task.
+    std::lock_guard lock(idle_mutex);
+  }
+  idle_cv.notify_one();
+}
+
+static Task* Steal(Worker& thief) {
+  int n = workers.size();
+  for (int i = 1; i < n; ++i) {
+    Worker& victim = *workers[(thief.index + i) % n];
+    if (Task* task = victim.PopFront()) {
+      stat_stolen.fetch_add(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+static void Finished() {
+  stat_executed.fetch_add(1, std::memory_order_relaxed);
+  if (in_flight.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // Automat thread may be waiting for the workers to become idle.
+    std::lock_guard lock(pinned_mutex);
+    pinned_cv.notify_all();
+  }
+}
+
+static void WorkerThread(Worker& worker) {
+  SetThreadName(maf::f("Automat Worker %d", worker.index));
+  current_worker = &worker;
+  while (true) {
+    Task* task = worker.PopBack();
+    if (task == nullptr) {
+      task = Steal(worker);
+    }
+    if (task == nullptr) {
+      std::unique_lock lock(idle_mutex);
+      idle_cv.wait(lock, [] { return stop || queued.load(std::memory_order_acquire) > 0; });
+      if (stop) {
+        break;
+      }
+      continue;
+    }
+    size_t queue_depth = queued.fetch_sub(1, std::memory_order_relaxed) - 1;
+    task->scheduled = false;
+    {
+      trace::TaskScope trace_scope(*task, queue_depth);
+      task->Execute();
+    }
+    Finished();
+  }
+  current_worker = nullptr;
+}
+
+void Start(int n_workers) {
+  assert(!IsRunning());
+  assert(n_workers > 0);
+  stop = false;
+  for (int i = 0; i < n_workers; ++i) {
+    auto& worker = workers.emplace_back(new Worker());
+    worker->index = i;
+  }
+  // Threads are started only after the `workers` vector is complete because they iterate over it
+  // when stealing.
+  for (auto& worker : workers) {
+    worker->thread = std::jthread(WorkerThread, std::ref(*worker));
+  }
+}
+
+void Stop() {
+  if (!IsRunning()) {
+    return;
+  }
+  Quiesce();
+  {
+    std::lock_guard lock(idle_mutex);
+    stop = true;
+  }
+  idle_cv.notify_all();
+  for (auto& worker : workers) {
+    worker->thread.join();
+  }
+  workers.clear();
+  next_worker = 0;
+}
+
+bool IsRunning() { return !workers.empty(); }
+
+bool OnWorkerThread() { return current_worker != nullptr; }
+
+bool TrySubmit(Task& task) {
+  if (workers.empty() || !task.IsThreadSafe()) {
+    return false;
+  }
+  stat_submitted.fetch_add(1, std::memory_order_relaxed);
+  Worker& worker = *workers[next_worker];
+  next_worker = (next_worker + 1) % workers.size();
+  Enqueue(worker, task);
+  return true;
+}
+
+void ScheduleFromWorker(Task& task) {
+  assert(current_worker);
+  // Several workers may schedule the same persistent task (like `Location::run_task`). Only the
+  // first one queues it - the task is going to run anyway.
+  if (task.scheduled.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  if (task.IsThreadSafe()) {
+    stat_spawned.fetch_add(1, std::memory_order_relaxed);
+    Enqueue(*current_worker, task);
+    return;
+  }
+  stat_pinned.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard lock(pinned_mutex);
+  pinned.push_back(&task);
+  pinned_cv.notify_all();
+}
+
+bool WaitForPinnedTasks() {
+  if (workers.empty()) {
+    return false;
+  }
+  std::vector<Task*> ready;
+  {
+    std::unique_lock lock(pinned_mutex);
+    pinned_cv.wait(lock, [] {
+      return !pinned.empty() || in_flight.load(std::memory_order_acquire) == 0;
+    });
+    ready.swap(pinned);
+  }
+  if (ready.empty()) {
+    return false;
+  }
+  for (Task* task : ready) {
+    // Tasks were already marked as `scheduled` (and checked against `NoScheduling`) by the workers.
+    queue.Push(task);
+  }
+  return true;
+}
+
+void Quiesce() {
+  while (WaitForPinnedTasks()) {
+  }
+}
+
+Stats GetStats() {
+  return Stats{
+      .submitted = stat_submitted.load(std::memory_order_relaxed),
+      .spawned = stat_spawned.load(std::memory_order_relaxed),
+      .executed = stat_executed.load(std::memory_order_relaxed),
+      .stolen = stat_stolen.load(std::memory_order_relaxed),
+      .pinned = stat_pinned.load(std::memory_order_relaxed),
+  };
+}
+
+}  // namespace automat::executor
@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+
+namespace automat {
+
+struct Task;
+
+// Marker interface for objects that can be executed outside of the Automat thread.
+//
+// Objects that inherit from this interface promise that their `Run`, `Updated` & `Errored` may be
+// called from any thread, concurrently with other objects. They're responsible for synchronizing
+// access to their own state. See threading_prototype.cc for why a per-object mutex is usually the
+// best choice.
+//
+// Objects that don't inherit from ThreadSafe are always executed on the Automat thread.
+struct ThreadSafe {
+  virtual ~ThreadSafe() = default;
+};
+
+// Opt-in multi-threaded scheduler.
+//
+// By default every Task is executed by `RunLoop` on the Automat thread. Once the executor is
+// started, tasks targeting ThreadSafe objects are handed over to a pool of worker threads. Each
+// worker owns a deque of tasks - it pops new work from the back (LIFO, cache-friendly) while idle
+// workers steal from the front of other deques (FIFO, oldest first).
+//
+// Tasks that are scheduled from worker threads but target regular objects are sent back to the
+// Automat thread, which picks them up in `RunLoop`. `RunLoop` returns only once both the Automat
+// queue & all of the worker deques are empty.
+namespace executor {
+
+// Start `n_workers` worker threads. Must be called from the Automat thread.
+void Start(int n_workers);
+
+// Wait for the workers to finish all of their tasks and stop them. Must be called from the Automat
+// thread.
+void Stop();
+
+bool IsRunning();
+
+// True when called from one of the worker threads.
+bool OnWorkerThread();
+
+// Called by `RunLoop` for every task taken from the Automat queue. Returns true if the task was
+// handed over to one of the workers.
+bool TrySubmit(Task&);
+
+// Called by `Task::Schedule` when it's executed on a worker thread. Tasks that are already scheduled
+// are ignored.
+void ScheduleFromWorker(Task&);
+
+// Blocks the Automat thread until some of the tasks sent back by the workers become available (or
+// all of the workers become idle). Returns false if there is nothing more to do.
+bool WaitForPinnedTasks();
+
+// Blocks the Automat thread until all of the workers become idle. `RunLoop` calls it before every
+// task that isn't ThreadSafe, because such tasks may modify the graph of objects.
+void Quiesce();
+
+struct Stats {
+  uint64_t submitted = 0;  // tasks handed over to the workers by the Automat thread
+  uint64_t spawned = 0;    // tasks pushed directly to worker deques by the workers
+  uint64_t executed = 0;   // tasks executed by the workers
+  uint64_t stolen = 0;     // tasks executed by a worker other than the one they were pushed to
+  uint64_t pinned = 0;     // tasks sent back from the workers to the Automat thread
+};
+
+Stats GetStats();
+
+}  // namespace executor
+
+}  // namespace automat
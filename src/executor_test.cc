@@ -0,0 +1,143 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "executor.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "base.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+// Counts the updates it receives. Can be updated from any thread.
+struct ParallelCounter : LiveObject, ThreadSafe {
+  static const ParallelCounter proto;
+  std::atomic<int> updates = 0;
+  std::atomic<int> off_thread_updates = 0;
+  std::thread::id automat_thread_id = std::this_thread::get_id();
+  // When set, every update also schedules this Location to run.
+  Location* run_on_update = nullptr;
+  string_view Name() const override { return "Parallel Counter"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<ParallelCounter>(); }
+  void Updated(Location& here, Location& updated) override {
+    ++updates;
+    if (std::this_thread::get_id() != automat_thread_id) {
+      ++off_thread_updates;
+    }
+    // Updates of regular objects must be sent back to the Automat thread.
+    here.ScheduleUpdate();
+    if (run_on_update) {
+      run_on_update->ScheduleRun();
+    }
+  }
+};
+
+// Regular object - must always be updated on the Automat thread.
+struct PinnedCounter : LiveObject {
+  static const PinnedCounter proto;
+  int updates = 0;
+  int off_thread_updates = 0;
+  std::thread::id automat_thread_id = std::this_thread::get_id();
+  string_view Name() const override { return "Pinned Counter"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<PinnedCounter>(); }
+  void Updated(Location& here, Location& updated) override {
+    ++updates;
+    if (std::this_thread::get_id() != automat_thread_id) {
+      ++off_thread_updates;
+    }
+  }
+};
+
+// Remembers how many updates the pinned counter received before it was run.
+struct JoinProbe : Object, Runnable {
+  static const JoinProbe proto;
+  int runs = 0;
+  int pinned_updates_when_run = -1;
+  Location* pinned = nullptr;
+  string_view Name() const override { return "Join Probe"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<JoinProbe>(); }
+  LongRunning* OnRun(Location& here) override {
+    ++runs;
+    pinned_updates_when_run = pinned->ThisAs<PinnedCounter>()->updates;
+    return nullptr;
+  }
+};
+
+const ParallelCounter ParallelCounter::proto;
+const PinnedCounter PinnedCounter::proto;
+const JoinProbe JoinProbe::proto;
+
+struct ExecutorTest : TestBase {
+  static constexpr int kCounters = 64;
+  Location& source = machine.Create<ParallelCounter>("source");
+  Location* parallel[kCounters];
+  Location& pinned = machine.Create<PinnedCounter>("pinned");
+
+  ExecutorTest() {
+    for (int i = 0; i < kCounters; ++i) {
+      parallel[i] = &machine.Create<ParallelCounter>();
+      parallel[i]->ObserveUpdates(source);
+      pinned.ObserveUpdates(*parallel[i]);
+    }
+    executor::Start(4);
+  }
+  ~ExecutorTest() { executor::Stop(); }
+};
+
+TEST_F(ExecutorTest, FanOut) {
+  source.ScheduleUpdate();
+  RunLoop();
+  for (int i = 0; i < kCounters; ++i) {
+    EXPECT_EQ(1, parallel[i]->ThisAs<ParallelCounter>()->updates);
+  }
+  auto& pinned_counter = *pinned.ThisAs<PinnedCounter>();
+  EXPECT_EQ(kCounters, pinned_counter.updates);
+  EXPECT_EQ(0, pinned_counter.off_thread_updates);
+  auto stats = executor::GetStats();
+  EXPECT_GE(stats.executed, kCounters);
+  EXPECT_GE(stats.pinned, kCounters);
+}
+
+// Updates of the parallel counters run on the workers and spawn updates of the pinned counter. All
+// of them are predecessors of the probe so it must run exactly once, after all of them.
+TEST_F(ExecutorTest, NextGuardJoinsWorkerTasks) {
+  Location& probe = machine.Create<JoinProbe>("probe");
+  auto& join_probe = *probe.ThisAs<JoinProbe>();
+  join_probe.pinned = &pinned;
+  {
+    NextGuard next_guard({&probe.run_task});
+    source.ScheduleUpdate();
+  }
+  RunLoop();
+  EXPECT_EQ(1, join_probe.runs);
+  EXPECT_EQ(kCounters, join_probe.pinned_updates_when_run);
+  EXPECT_EQ(0, probe.run_task.pending_predecessors.load());
+}
+
+TEST_F(ExecutorTest, StopReturnsToSingleThread) {
+  executor::Stop();
+  source.ScheduleUpdate();
+  RunLoop();
+  for (int i = 0; i < kCounters; ++i) {
+    EXPECT_EQ(0, parallel[i]->ThisAs<ParallelCounter>()->off_thread_updates);
+  }
+}
+
+// All of the workers schedule the same persistent `run_task`. It may be queued only once at a time.
+// The probe isn't ThreadSafe so it runs only once the workers are idle - after all of them
+// scheduled it.
+TEST_F(ExecutorTest, SharedRunTaskIsQueuedOnce) {
+  Location& probe = machine.Create<JoinProbe>("probe");
+  auto& join_probe = *probe.ThisAs<JoinProbe>();
+  join_probe.pinned = &pinned;
+  for (int i = 0; i < kCounters; ++i) {
+    parallel[i]->ThisAs<ParallelCounter>()->run_on_update = &probe;
+  }
+  source.ScheduleUpdate();
+  RunLoop();
+  EXPECT_EQ(1, join_probe.runs);
+  EXPECT_FALSE(probe.run_task.scheduled.load());
+}
@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "headless.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "base.hh"
+#include "executor.hh"
+#include "format.hh"
+#include "keyboard.hh"
+#include "library.hh"  // IWYU pragma: keep
+#include "log.hh"
+#include "persistence.hh"
+#include "root.hh"
+#include "stats.hh"
+#include "timer_thread.hh"
+#include "window.hh"
+
+using namespace maf;
+
+namespace automat {
+
+struct HeadlessOptions {
+  Path state_path = StatePath();
+  double deadline_seconds = 60;
+  int workers = 0;
+};
+
+static bool ParseOptions(int argc, char* argv[], HeadlessOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--state") == 0 && has_value) {
+      options.state_path = Path(argv[++i]);
+    } else if (strcmp(argv[i], "--deadline") == 0 && has_value) {
+      options.deadline_seconds = strtod(argv[++i], nullptr);
+    } else if (strcmp(argv[i], "--workers") == 0 && has_value) {
+      options.workers = atoi(argv[++i]);
+    } else {
+      ERROR << "Unknown argument: " << argv[i];
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Progress {
+  uint64_t executed_tasks = 0;
+  // End of the last `RunLoop` before the check.
+  time::SteadyClock::time_point run_loop_finished;
+  // True when there is nothing more to do - no tasks, no events, no timers & no LongRunning
+  // objects.
+  bool idle = false;
+};
+
+// Progress reported by `on_idle` each time the Automat thread runs out of work.
+struct IdleReports {
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint64_t count = 0;
+  Progress last;
+};
+
+static bool AnyLongRunning(Machine& machine) {
+  for (auto& location : machine.locations) {
+    if (location->long_running) {
+      return true;
+    }
+    if (auto* nested = location->ThisAs<Machine>(); nested && AnyLongRunning(*nested)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Must be called on the Automat thread.
+static Progress CheckProgress() {
+  Progress progress;
+  progress.executed_tasks = executed_tasks + executor::GetStats().executed;
+  progress.run_loop_finished = run_loop_finished;
+  progress.idle = queue.empty() && events.size() == 0 && ScheduledTimerCount() == 0 &&
+                  !AnyLongRunning(*root_machine);
+  return progress;
+}
+
+int HeadlessMain(int argc, char* argv[]) {
+  using Clock = std::chrono::steady_clock;
+  HeadlessOptions options;
+  if (!ParseOptions(argc, argv, options)) {
+    return 1;
+  }
+
+  IdleReports reports;
+  on_idle = [&reports] {
+    Progress progress = CheckProgress();
+    {
+      std::lock_guard lock(reports.mutex);
+      reports.last = progress;
+      ++reports.count;
+    }
+    reports.cv.notify_all();
+  };
+  InitRoot();
+  // Objects expect the window & keyboard to exist. They're never shown or connected to any input.
+  gui::window.reset(new gui::Window());
+  gui::keyboard = std::make_unique<gui::Keyboard>(*gui::window);
+  Status status;
+  LoadState(*gui::window, options.state_path, status);
+  if (!OK(status)) {
+    ERROR << "Failed to load " << options.state_path.str << ": " << status;
+    StopRoot();
+    on_idle = nullptr;
+    return 1;
+  }
+
+  uint64_t executed_before = 0;
+  uint64_t seen_reports = 0;
+  RunOnAutomatThreadSynchronous([&] {
+    LOG << "Memory: " << root_machine->MemoryReport();
+    if (options.workers > 0) {
+      executor::Start(options.workers);
+    }
+    executed_before = CheckProgress().executed_tasks;
+    // Only the reports that follow this task are relevant.
+    std::lock_guard lock(reports.mutex);
+    seen_reports = reports.count;
+  });
+  auto start = Clock::now();
+  auto deadline = start + std::chrono::duration<double>(options.deadline_seconds);
+  auto finish = start;
+  uint64_t tasks = 0;
+  bool deadline_passed = false;
+  auto NewReport = [&] { return reports.count != seen_reports; };
+  std::unique_lock lock(reports.mutex);
+  while (true) {
+    if (!reports.cv.wait_until(lock, deadline, NewReport)) {
+      deadline_passed = true;
+      break;
+    }
+    seen_reports = reports.count;
+    uint64_t tasks_now = reports.last.executed_tasks - executed_before;
+    if (tasks_now > tasks) {
+      tasks = tasks_now;
+      finish = std::max(start, reports.last.run_loop_finished);
+    }
+    // Expired timers may briefly be in transit to the Automat thread. If they are, another report
+    // follows shortly.
+    if (reports.last.idle &&
+        !reports.cv.wait_for(lock, std::chrono::milliseconds(10), NewReport)) {
+      break;
+    }
+  }
+  lock.unlock();
+  if (deadline_passed) {
+    // The Automat thread may have been busy all along so take one final look at its progress.
+    Progress progress;
+    RunOnAutomatThreadSynchronous([&] { progress = CheckProgress(); });
+    tasks = progress.executed_tasks - executed_before - 1;  // excluding the check itself
+    finish = Clock::now();
+  }
+  auto wall_seconds = std::chrono::duration<double>(finish - start).count();
+
+  StopRoot();
+  on_idle = nullptr;
+  LOG << f("Executed %llu tasks in %.3f s (%.0f tasks/s)%s", (unsigned long long)tasks,
+           wall_seconds, wall_seconds > 0 ? tasks / wall_seconds : 0.,
+           deadline_passed ? " - deadline passed" : "");
+  DumpStats();
+
+  root_machine->ClearLocations();
+  gui::keyboard.reset();
+  gui::window.reset();
+  return 0;
+}
+
+}  // namespace automat
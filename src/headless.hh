@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+namespace automat {
+
+// Runs Automat without a window, GPU or input devices. Used for batch execution & benchmarking.
+//
+// Loads the state from a JSON file, runs it until all of the work is done (no tasks, events or
+// timers are pending) or until a deadline passes and reports the number of executed tasks.
+//
+// This is the entry point of the `automat_headless` binary (see automat_headless.cc), which doesn't
+// link the platform code (X11, Vulkan, Win32).
+//
+// Usage: automat_headless [--state <path>] [--deadline <seconds>] [--workers <n>]
+int HeadlessMain(int argc, char* argv[]);
+
+}  // namespace automat
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "interfaces.hh"
+
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <unordered_map>
+
+namespace automat {
+
+InterfaceTable::InterfaceTable(const std::type_info& type) : type(&type) {
+  for (auto& offset : offsets) {
+    offset.store(kUnknown, std::memory_order_relaxed);
+  }
+}
+
+const InterfaceTable& InterfaceTable::For(const std::type_info& type) {
+  static std::mutex mutex;
+  static std::unordered_map<std::type_index, std::unique_ptr<InterfaceTable>> tables;
+  std::lock_guard lock(mutex);
+  auto& table = tables[type];
+  if (table == nullptr) {
+    table = std::make_unique<InterfaceTable>(type);
+  }
+  return *table;
+}
+
+int NextInterfaceId() {
+  static std::atomic<int> next_id = 0;
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace automat
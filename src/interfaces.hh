@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <typeinfo>
+
+namespace automat {
+
+// Offsets of the interfaces (& subclasses) of a single dynamic type of Object.
+//
+// Objects are usually queried for their interfaces (Runnable, LongRunning, Pointer, ...) through
+// `dynamic_cast`, which has to walk the class hierarchy on every call. InterfaceTable remembers the
+// results of these casts as offsets relative to the Object, so that `InterfaceCast` (see object.hh)
+// can answer the following queries with a single table lookup.
+//
+// Interfaces are numbered in the order of their first use. The slot of each interface is filled
+// by the first cast with a real `dynamic_cast`. Interfaces beyond kMaxInterfaces always use
+// `dynamic_cast`.
+//
+// Tables are never destroyed. They can be read & filled from any thread.
+struct InterfaceTable {
+  static constexpr int kMaxInterfaces = 64;
+  static constexpr int32_t kUnknown = INT32_MIN;     // not cast yet
+  static constexpr int32_t kAbsent = INT32_MIN + 1;  // `dynamic_cast` returned nullptr
+
+  const std::type_info* type;
+  mutable std::array<std::atomic<int32_t>, kMaxInterfaces> offsets;
+
+  InterfaceTable(const std::type_info& type);
+
+  // Returns the table of the given type. Builds it on the first call.
+  static const InterfaceTable& For(const std::type_info& type);
+};
+
+// Table pointer that can be stored in Objects.
+//
+// Copies of Objects (made by `Clone`) inherit the table of their prototype. Since a copy may also
+// be made by a different type, tables are always checked against the dynamic type of the object
+// before they're used.
+struct InterfaceTableRef {
+  std::atomic<const InterfaceTable*> table = nullptr;
+
+  InterfaceTableRef() = default;
+  InterfaceTableRef(const InterfaceTableRef& other)
+      : table(other.table.load(std::memory_order_relaxed)) {}
+  InterfaceTableRef& operator=(const InterfaceTableRef& other) {
+    table.store(other.table.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+  }
+};
+
+int NextInterfaceId();
+
+// Number of the interface `T` in the InterfaceTables.
+template <typename T>
+int InterfaceId() {
+  static const int id = NextInterfaceId();
+  return id;
+}
+
+}  // namespace automat
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "interfaces.hh"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "base.hh"
+#include "executor.hh"
+#include "library.hh"
+#include "timer_thread.hh"
+
+using namespace automat;
+using namespace automat::library;
+
+static std::vector<std::unique_ptr<Object>> LibraryObjects() {
+  std::vector<std::unique_ptr<Object>> objects;
+  objects.push_back(Create<Text>());
+  objects.push_back(Create<Number>());
+  objects.push_back(Create<Filter>());
+  objects.push_back(Create<FlipFlop>());
+  objects.push_back(Create<KeyPresser>());
+  objects.push_back(Create<Timeline>());
+  objects.push_back(Create<Machine>());
+  objects.push_back(Create<ComplexField>());
+  return objects;
+}
+
+TEST(InterfaceCastTest, MatchesDynamicCast) {
+  auto objects = LibraryObjects();
+  for (int round = 0; round < 2; ++round) {  // the first round fills the tables
+    for (auto& object : objects) {
+      Object* o = object.get();
+      EXPECT_EQ(InterfaceCast<Runnable>(o), dynamic_cast<Runnable*>(o));
+      EXPECT_EQ(InterfaceCast<LongRunning>(o), dynamic_cast<LongRunning*>(o));
+      EXPECT_EQ(InterfaceCast<TimerNotificationReceiver>(o),
+                dynamic_cast<TimerNotificationReceiver*>(o));
+      EXPECT_EQ(InterfaceCast<LiveObject>(o), dynamic_cast<LiveObject*>(o));
+      EXPECT_EQ(InterfaceCast<Pointer>(o), dynamic_cast<Pointer*>(o));
+      EXPECT_EQ(InterfaceCast<ThreadSafe>(o), dynamic_cast<ThreadSafe*>(o));
+      EXPECT_EQ(InterfaceCast<Text>(o), dynamic_cast<Text*>(o));
+    }
+  }
+}
+
+// Runnable object with a default copy constructor.
+struct Probe : LiveObject, Runnable {
+  static const Probe proto;
+  string_view Name() const override { return "Probe"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<Probe>(*this); }
+  LongRunning* OnRun(Location& here) override { return nullptr; }
+};
+
+const Probe Probe::proto;
+
+TEST(InterfaceCastTest, ClonesShareTheTableOfTheirPrototype) {
+  PrepareInterfaces<Runnable>(Probe::proto);
+  auto clone = Probe::proto.Clone();
+  EXPECT_EQ(clone->interfaces.table.load(), Probe::proto.interfaces.table.load());
+  EXPECT_EQ(InterfaceCast<Runnable>(clone.get()), dynamic_cast<Runnable*>(clone.get()));
+
+  // Objects of other types (which copied the Object part of a Probe) must not use its table.
+  auto text = Create<Text>();
+  text->interfaces.table = Probe::proto.interfaces.table.load();
+  EXPECT_EQ(InterfaceCast<Runnable>(text.get()), nullptr);
+  EXPECT_NE(text->interfaces.table.load(), Probe::proto.interfaces.table.load());
+}
+
+// Compare the interface tables against `dynamic_cast` on the library objects. Disabled by default -
+// run with `--gtest_also_run_disabled_tests --gtest_filter=*Benchmark*`.
+TEST(InterfaceCastTest, DISABLED_Benchmark) {
+  using Clock = std::chrono::steady_clock;
+  constexpr int kRounds = 100'000;
+  auto objects = LibraryObjects();
+  auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  // Count the hits so that the casts can't be optimized away.
+  auto run = [&](auto cast) {
+    int hits = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < kRounds; ++i) {
+      for (auto& object : objects) {
+        hits += cast.template operator()<Runnable>(object.get()) != nullptr;
+        hits += cast.template operator()<LongRunning>(object.get()) != nullptr;
+        hits += cast.template operator()<TimerNotificationReceiver>(object.get()) != nullptr;
+        hits += cast.template operator()<LiveObject>(object.get()) != nullptr;
+      }
+    }
+    return std::make_pair(Clock::now() - start, hits);
+  };
+  auto [dynamic_time, dynamic_hits] =
+      run([]<typename T>(Object* o) -> T* { return dynamic_cast<T*>(o); });
+  auto [table_time, table_hits] =
+      run([]<typename T>(Object* o) -> T* { return InterfaceCast<T>(o); });
+  EXPECT_EQ(dynamic_hits, table_hits);
+  int casts = kRounds * objects.size() * 4;
+  printf("%d casts      [ms]\n", casts);
+  printf("dynamic_cast     %8.2f\n", ms(dynamic_time));
+  printf("InterfaceCast    %8.2f\n", ms(table_time));
+}
@@ -0,0 +1,641 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "journal.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "base.hh"
+#include "bulk_edit.hh"
+#include "channel.hh"
+#include "executor.hh"
+#include "format.hh"
+#include "log.hh"
+#include "prototypes.hh"
+#include "snapshot.hh"
+#include "thread_name.hh"
+#include "time.hh"
+#include "timer_thread.hh"
+#include "virtual_fs.hh"
+
+using namespace maf;
+
+namespace automat::journal {
+
+namespace {
+
+constexpr char kMagic[8] = {'A', 'U', 'T', 'O', 'J', 'R', 'N', 'L'};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t snapshot_size;  // the snapshot follows the header & is padded to 8 bytes
+};
+
+// Records are framed with their size & checksum (each a uint32_t).
+constexpr size_t kFrameSize = 8;
+
+// Object values are re-serialized in full so they're encoded at most this often.
+constexpr time::Duration kValueInterval = 1s;
+
+enum RecordKind : uint8_t {
+  kCreated = 1,  // id, x, y, type, name, value
+  kMoved,        // id, x, y
+  kDeleted,      // id
+  kConnected,    // from, to, label
+  kDisconnected,  // from, to, label
+  kChanged,      // id, value
+};
+
+// FNV-1a
+uint32_t Checksum(StrView data) {
+  uint32_t hash = 2166136261u;
+  for (char c : data) {
+    hash = (hash ^ (uint8_t)c) * 16777619u;
+  }
+  return hash;
+}
+
+uint64_t Padded(uint64_t size) { return (size + 7) & ~7ull; }
+
+struct Encoder {
+  Str& out;
+  size_t start;
+
+  Encoder(Str& out, RecordKind kind) : out(out), start(out.size()) {
+    out.resize(start + kFrameSize);
+    U8(kind);
+  }
+
+  ~Encoder() {
+    StrView payload = StrView(out).substr(start + kFrameSize);
+    uint32_t frame[2] = {(uint32_t)payload.size(), Checksum(payload)};
+    memcpy(out.data() + start, frame, sizeof(frame));
+  }
+
+  void Raw(const void* data, size_t size) { out.append((const char*)data, size); }
+  void U8(uint8_t value) { Raw(&value, sizeof(value)); }
+  void U32(uint32_t value) { Raw(&value, sizeof(value)); }
+  void F32(float value) { Raw(&value, sizeof(value)); }
+  void String(StrView value) {
+    U32(value.size());
+    Raw(value.data(), value.size());
+  }
+};
+
+struct Decoder {
+  StrView data;
+  bool ok = true;
+
+  void Raw(void* out, size_t size) {
+    if (data.size() < size) {
+      ok = false;
+      memset(out, 0, size);
+      return;
+    }
+    memcpy(out, data.data(), size);
+    data.remove_prefix(size);
+  }
+  uint8_t U8() {
+    uint8_t value;
+    Raw(&value, sizeof(value));
+    return value;
+  }
+  uint32_t U32() {
+    uint32_t value;
+    Raw(&value, sizeof(value));
+    return value;
+  }
+  float F32() {
+    float value;
+    Raw(&value, sizeof(value));
+    return value;
+  }
+  StrView String() {
+    uint32_t size = U32();
+    if (data.size() < size) {
+      ok = false;
+      return {};
+    }
+    StrView value = data.substr(0, size);
+    data.remove_prefix(size);
+    return value;
+  }
+};
+
+struct Message {
+  enum Kind { kRecords, kCompact, kStop } kind;
+  Str bytes;  // records or the new contents of the journal
+};
+
+enum DirtyFlags : uint8_t {
+  kDirtyPosition = 1,
+  kDirtyValue = 2,
+};
+
+// Automat thread
+Location* journaled = nullptr;  // Location of the journaled Machine
+Path path;
+struct Entry {
+  uint32_t id;
+  Vec2 position;  // last journaled position
+};
+std::unordered_map<Location*, Entry> entries;
+uint32_t next_id = 0;
+std::unordered_map<Location*, uint8_t> dirty;
+time::SteadyClock::time_point values_encoded;  // last time when the dirty values were encoded
+std::unique_ptr<Location> value_timer;  // holds a `ValueTimer` while the journal is active
+bool value_timer_scheduled = false;
+uint64_t bytes_since_compaction = 0;
+Stats stats;
+
+// Any thread
+std::atomic<bool> active = false;  // true between `Start` & `Stop`
+
+// Background thread
+channel messages;
+std::thread thread;
+
+// Measures the time spent encoding records. Uses the real clock - `SteadyNow` may be virtual.
+struct RecordTimer {
+  time::SteadyClock::time_point start = time::SteadyClock::now();
+  ~RecordTimer() {
+    stats.record_time.Add(
+        std::chrono::duration<double, std::micro>(time::SteadyClock::now() - start).count());
+  }
+};
+
+void Send(Message::Kind kind, Str bytes) {
+  if (kind == Message::kRecords) {
+    bytes_since_compaction += bytes.size();
+    stats.bytes += bytes.size();
+  }
+  messages.send(std::make_unique<Message>(Message{kind, std::move(bytes)}));
+}
+
+bool Tracked(Location& location) { return journaled && location.parent == journaled; }
+
+// Encodes the dirty positions & (if `values` is true) the dirty values. Values that aren't encoded
+// stay dirty.
+void EncodeDirty(bool values) {
+  if (dirty.empty()) {
+    return;
+  }
+  RecordTimer timer;
+  Str records;
+  for (auto it = dirty.begin(); it != dirty.end();) {
+    auto [location, flags] = *it;
+    Entry& entry = entries[location];
+    if ((flags & kDirtyPosition) && entry.position != location->position) {
+      ++stats.records;
+      Encoder e(records, kMoved);
+      e.U32(entry.id);
+      e.F32(location->position.x);
+      e.F32(location->position.y);
+      entry.position = location->position;
+    }
+    if (!values && (flags & kDirtyValue)) {
+      it->second = kDirtyValue;
+      ++it;
+      continue;
+    }
+    if ((flags & kDirtyValue) && location->object) {
+      ++stats.records;
+      Encoder e(records, kChanged);
+      e.U32(entry.id);
+      e.String(snapshot::SerializeValue(*location->object));
+    }
+    it = dirty.erase(it);
+  }
+  if (values) {
+    values_encoded = time::SteadyClock::now();
+  }
+  if (!records.empty()) {
+    Send(Message::kRecords, std::move(records));
+  }
+}
+
+// Encodes the values that `Flush` left dirty, in case nothing else runs in the meantime.
+struct ValueTimer : Object, TimerNotificationReceiver {
+  std::string_view Name() const override { return "Journal Value Timer"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<ValueTimer>(); }
+  void OnTimerNotification(Location&, time::SteadyPoint) override {
+    value_timer_scheduled = false;
+    EncodeDirty(true);
+  }
+};
+
+void EncodeConnection(Str& out, RecordKind kind, Connection& connection) {
+  auto from = entries.find(&connection.from);
+  auto to = entries.find(&connection.to);
+  if (from == entries.end() || to == entries.end()) {
+    return;
+  }
+  ++stats.records;
+  Encoder e(out, kind);
+  e.U32(from->second.id);
+  e.U32(to->second.id);
+  e.String(connection.argument.name);
+}
+
+void Compact() {
+  Machine* machine = journaled->ThisAs<Machine>();
+  entries.clear();
+  dirty.clear();
+  next_id = 0;
+  for (auto& location : machine->locations) {
+    entries[location.get()] = {next_id++, location->position};
+  }
+  Str base = snapshot::Save(*machine, nullptr);
+  Header header = {.version = kVersion, .reserved = 0, .snapshot_size = base.size()};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  Str contents;
+  contents.reserve(sizeof(header) + Padded(base.size()));
+  contents.append((const char*)&header, sizeof(header));
+  contents.append(base);
+  contents.resize(sizeof(header) + Padded(base.size()), '\0');
+  Send(Message::kCompact, std::move(contents));
+  bytes_since_compaction = 0;
+  ++stats.compactions;
+}
+
+void ThreadMain() {
+  SetThreadName("Automat Journal");
+  FILE* file = nullptr;
+  bool stop = false;
+  while (!stop) {
+    void* received[64];
+    size_t n = messages.recv_bulk(received, std::size(received));
+    for (size_t i = 0; i < n; ++i) {
+      std::unique_ptr<Message> message(static_cast<Message*>(received[i]));
+      switch (message->kind) {
+        case Message::kRecords:
+          if (file && fwrite(message->bytes.data(), 1, message->bytes.size(), file) !=
+                          message->bytes.size()) {
+            ERROR << "Failed to append to " << path.str;
+          }
+          break;
+        case Message::kCompact: {
+          if (file) {
+            fclose(file);
+            file = nullptr;
+          }
+          // Replaced atomically so that a crash leaves either the old or the new journal.
+          Status status;
+          Path tmp = Path(path.str + ".tmp");
+          fs::real.Write(tmp, message->bytes, status);
+          if (OK(status)) {
+            tmp.Rename(path, status);
+          }
+          if (!OK(status)) {
+            ERROR << "Failed to compact the journal: " << status;
+            break;
+          }
+          file = fopen(path.c_str(), "ab");
+          if (file == nullptr) {
+            ERROR << "Failed to open " << path.str;
+          }
+          break;
+        }
+        case Message::kStop:
+          stop = true;
+          break;
+      }
+    }
+    if (file) {
+      fflush(file);
+#if defined(__linux__)
+      fdatasync(fileno(file));
+#endif
+    }
+  }
+  if (file) {
+    fclose(file);
+  }
+}
+
+}  // namespace
+
+void Start(const Path& journal_path, Location& here) {
+  Stop();
+  path = journal_path;
+  journaled = &here;
+  active = true;
+  values_encoded = {};
+  value_timer = std::make_unique<Location>(nullptr);
+  value_timer->InsertHere(std::make_unique<ValueTimer>());
+  thread = std::thread(ThreadMain);
+  Compact();
+}
+
+void Stop() {
+  if (!thread.joinable()) {
+    return;
+  }
+  EncodeDirty(true);
+  Flush();
+  Send(Message::kStop, {});
+  thread.join();
+  CancelScheduledAt(*value_timer);
+  value_timer.reset();
+  value_timer_scheduled = false;
+  active = false;
+  journaled = nullptr;
+  entries.clear();
+  dirty.clear();
+}
+
+void Flush() {
+  if (journaled == nullptr) {
+    return;
+  }
+  auto since_values = time::SteadyClock::now() - values_encoded;
+  bool values = since_values >= kValueInterval;
+  EncodeDirty(values);
+  if (!dirty.empty() && !value_timer_scheduled) {  // only values are left
+    value_timer_scheduled = true;
+    ScheduleAt(*value_timer, time::SteadyNow() + time::Duration(kValueInterval - since_values));
+  }
+  if (bytes_since_compaction > kCompactionBytes) {
+    Compact();
+  }
+}
+
+void LocationCreated(Location& location) {
+  if (!Tracked(location)) {
+    return;
+  }
+  RecordTimer timer;
+  uint32_t id = next_id++;
+  entries[&location] = {id, location.position};
+  Str records;
+  {
+    ++stats.records;
+    Encoder e(records, kCreated);
+    e.U32(id);
+    e.F32(location.position.x);
+    e.F32(location.position.y);
+    e.String(location.object ? location.object->Name() : "");
+    e.String(location.name);
+    e.String(location.object ? snapshot::SerializeValue(*location.object) : "");
+  }
+  // Locations that are dragged back into the Machine keep their connections.
+  for (auto* connection : location.outgoing) {
+    EncodeConnection(records, kConnected, *connection);
+  }
+  for (auto* connection : location.incoming) {
+    EncodeConnection(records, kConnected, *connection);
+  }
+  dirty.erase(&location);
+  Send(Message::kRecords, std::move(records));
+}
+
+void LocationMoved(Location& location) {
+  if (journaled == nullptr) {
+    return;
+  }
+  // Re-indexing (for example after a change of shape) doesn't move the Location.
+  auto it = entries.find(&location);
+  if (it != entries.end() && it->second.position != location.position) {
+    dirty[&location] |= kDirtyPosition;
+  }
+}
+
+void ObjectChanged(Location& location) {
+  if (executor::OnWorkerThread()) {
+    // Objects updated by the executor are marked on the Automat thread, which owns `entries` &
+    // `dirty`.
+    // The task is dropped if the Location is destroyed in the meantime.
+    if (active.load(std::memory_order_relaxed)) {
+      auto* old_global_successors = std::exchange(global_successors, nullptr);
+      auto task = std::make_unique<FunctionTask>(&location, [](Location& l) { ObjectChanged(l); });
+      global_successors = old_global_successors;
+      events.send(std::move(task));
+    }
+    return;
+  }
+  if (journaled && entries.contains(&location)) {
+    dirty[&location] |= kDirtyValue;
+  }
+}
+
+void LocationDeleted(Location& location) {
+  if (journaled == nullptr) {
+    return;
+  }
+  auto it = entries.find(&location);
+  if (it == entries.end()) {
+    return;
+  }
+  RecordTimer timer;
+  Str records;
+  {
+    ++stats.records;
+    Encoder e(records, kDeleted);
+    e.U32(it->second.id);
+  }
+  entries.erase(it);
+  dirty.erase(&location);
+  Send(Message::kRecords, std::move(records));
+}
+
+void ConnectionAdded(Connection& connection) {
+  if (!Tracked(connection.from)) {
+    return;
+  }
+  RecordTimer timer;
+  Str records;
+  EncodeConnection(records, kConnected, connection);
+  if (!records.empty()) {
+    Send(Message::kRecords, std::move(records));
+  }
+}
+
+void ConnectionRemoved(Connection& connection) {
+  if (!Tracked(connection.from)) {
+    return;
+  }
+  RecordTimer timer;
+  Str records;
+  EncodeConnection(records, kDisconnected, connection);
+  if (!records.empty()) {
+    Send(Message::kRecords, std::move(records));
+  }
+}
+
+bool IsJournal(StrView data) {
+  return data.size() >= sizeof(Header) && memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+void Load(StrView data, Location& here, Status& status) {
+  if (!IsJournal(data)) {
+    AppendErrorMessage(status) += "Not a journal";
+    return;
+  }
+  Header header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.version != kVersion) {
+    AppendErrorMessage(status) += f("Unsupported journal version: %u", header.version);
+    return;
+  }
+  if (header.snapshot_size > data.size() - sizeof(Header)) {
+    AppendErrorMessage(status) += "Truncated journal snapshot";
+    return;
+  }
+  // Connections are announced & the Locations are updated once all of the records are replayed.
+  BulkEdit bulk;
+  Vec<Location*> locations;  // by ID
+  snapshot::Load(data.substr(sizeof(Header), header.snapshot_size), here, nullptr, status,
+                 &locations);
+  Machine* machine = here.ThisAs<Machine>();
+  if (!OK(status) || machine == nullptr) {
+    return;
+  }
+  auto Find = [&](uint32_t id) { return id < locations.size() ? locations[id] : nullptr; };
+  StrView records = data.substr(std::min<uint64_t>(
+      data.size(), sizeof(Header) + Padded(header.snapshot_size)));
+  while (!records.empty()) {
+    uint32_t frame[2] = {};
+    if (records.size() >= kFrameSize) {
+      memcpy(frame, records.data(), sizeof(frame));
+    }
+    if (records.size() < kFrameSize || frame[0] > records.size() - kFrameSize ||
+        Checksum(records.substr(kFrameSize, frame[0])) != frame[1]) {
+      ++stats.skipped;  // torn by a crash
+      break;
+    }
+    Decoder d{records.substr(kFrameSize, frame[0])};
+    records.remove_prefix(kFrameSize + frame[0]);
+    switch (d.U8()) {
+      case kCreated: {
+        uint32_t id = d.U32();
+        float x = d.F32();
+        float y = d.F32();
+        StrView type = d.String();
+        StrView name = d.String();
+        StrView value = d.String();
+        if (!d.ok) {
+          break;
+        }
+        auto& l = machine->CreateEmpty(Str(name));
+        l.position = Vec2(x, y);
+        if (!type.empty()) {
+          if (const Object* proto = FindPrototype(type)) {
+            l.Create(*proto);
+            snapshot::DeserializeValue(l, value);
+          } else {
+            l.ReportError(f("Unknown object type: %.*s", (int)type.size(), type.data()));
+          }
+        }
+        machine->UpdateIndex(l);
+        if (id >= locations.size()) {
+          locations.resize(id + 1, nullptr);
+        }
+        locations[id] = &l;
+        break;
+      }
+      case kMoved: {
+        Location* l = Find(d.U32());
+        float x = d.F32();
+        float y = d.F32();
+        if (d.ok && l) {
+          l->position = Vec2(x, y);
+          machine->UpdateIndex(*l);
+        }
+        break;
+      }
+      case kDeleted: {
+        uint32_t id = d.U32();
+        if (Location* l = Find(id)) {
+          machine->Extract(*l);  // destroys the Location
+          locations[id] = nullptr;
+        }
+        break;
+      }
+      case kConnected: {
+        Location* from = Find(d.U32());
+        Location* to = Find(d.U32());
+        StrView label = d.String();
+        if (!d.ok || from == nullptr || to == nullptr || from->object == nullptr) {
+          break;
+        }
+        from->object->Args([&](Argument& arg) {
+          if (arg.name == label) {
+            from->ConnectTo(*to, arg);
+          }
+        });
+        break;
+      }
+      case kDisconnected: {
+        Location* from = Find(d.U32());
+        Location* to = Find(d.U32());
+        StrView label = d.String();
+        if (!d.ok || from == nullptr || to == nullptr) {
+          break;
+        }
+        for (auto* connection : from->outgoing) {
+          if (&connection->to == to && connection->argument.name == label) {
+            delete connection;
+            break;
+          }
+        }
+        break;
+      }
+      case kChanged: {
+        Location* l = Find(d.U32());
+        StrView value = d.String();
+        if (!d.ok || l == nullptr || l->object == nullptr) {
+          break;
+        }
+        // Objects deserialize into a fresh instance, as they do when they're loaded. Arguments may
+        // belong to the old instance (for example the tracks of a Timeline) so the outgoing
+        // Connections are removed first & then reconnected to the Arguments of the new instance.
+        if (const Object* proto = FindPrototype(l->object->Name())) {
+          struct Outgoing {
+            Location* to;
+            Str label;
+            Connection::PointerBehavior pointer_behavior;
+          };
+          Vec<Outgoing> outgoing;
+          while (!l->outgoing.empty()) {
+            Connection* connection = l->outgoing.back();
+            outgoing.push_back(
+                {&connection->to, connection->argument.name, connection->pointer_behavior});
+            delete connection;
+          }
+          l->Create(*proto);
+          snapshot::DeserializeValue(*l, value);
+          for (auto& connection : outgoing) {
+            l->object->Args([&](Argument& arg) {
+              if (arg.name == connection.label) {
+                l->ConnectTo(*connection.to, arg, connection.pointer_behavior);
+              }
+            });
+          }
+        }
+        break;
+      }
+      default:
+        d.ok = false;
+        break;
+    }
+    if (!d.ok) {
+      ++stats.skipped;  // intact but undecodable - written by a different version?
+      break;
+    }
+  }
+}
+
+Stats GetStats() { return stats; }
+
+}  // namespace automat::journal
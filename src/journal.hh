@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+
+#include "latency_histogram.hh"
+#include "path.hh"
+#include "status.hh"
+#include "str.hh"
+
+namespace automat {
+
+struct Connection;
+struct Location;
+
+// Append-only journal of the edits of the root Machine, used for crash-safe autosave.
+//
+// The journal file starts with a snapshot of the Machine (see snapshot.hh) & continues with a
+// sequence of records: Location created, moved or deleted, Connection added or removed & object
+// state changed. Each record is framed with its size & a checksum so a record torn by a crash is
+// detected when the journal is replayed. Replay stops at the first damaged record.
+//
+// The hooks below are called on the Automat thread (`ObjectChanged` may also be called by the
+// executor - it forwards the change to the Automat thread). They only encode a small record & hand
+// it over to a background thread through a lock-free channel. `ObjectChanged` is called by the
+// objects wherever their serialized state changes (typing, editing, recording), rather than for
+// every `ScheduleUpdate`. The state of the objects & the positions of Locations change often
+// (animations, dragging, typing) so they're only marked as dirty. Positions are encoded once per
+// `RunLoop` (see `Flush`) & only if they differ from the journaled ones. Object state is
+// re-serialized in full (a long Timeline can take megabytes) so it's encoded at most once per
+// second (of real time) - a crash may lose the state changes of the last second.
+//
+// Once the records grow beyond `kCompactionBytes`, the journal is compacted: a new snapshot is
+// taken on the Automat thread & the background thread replaces the journal file with it (through
+// an atomic rename).
+//
+// Locations are identified by journal-specific IDs. Locations of the snapshot get the IDs of their
+// records (their position in `Machine::locations`). Later Locations get increasing IDs.
+namespace journal {
+
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kCompactionBytes = 4 << 20;
+
+// Starts journaling the Machine held by `here`. Compacts the journal immediately so that it starts
+// with the current state. Automat thread only.
+void Start(const maf::Path&, Location& here);
+
+// Writes the pending records & stops the background thread. Can be called from any thread once the
+// Automat thread is stopped. The journal file is left in place.
+void Stop();
+
+// Encodes the positions of the dirty Locations (and their state, if it wasn't encoded during the
+// last second). Called at the end of `RunLoop`.
+void Flush();
+
+void LocationCreated(Location&);
+void LocationMoved(Location&);
+void LocationDeleted(Location&);
+void ConnectionAdded(Connection&);
+void ConnectionRemoved(Connection&);
+void ObjectChanged(Location&);
+
+// True if the data starts with the header of a journal.
+bool IsJournal(maf::StrView data);
+
+// Restores the Machine held by `here` from a journal. Records after the first damaged one (torn,
+// or intact but impossible to decode) are skipped.
+void Load(maf::StrView data, Location& here, maf::Status&);
+
+struct Stats {
+  uint64_t records = 0;
+  uint64_t bytes = 0;  // bytes of records sent to the background thread
+  uint64_t compactions = 0;
+  uint64_t skipped = 0;  // journals whose replay stopped at a damaged record
+  LatencyHistogram record_time;  // time spent on the Automat thread per record (in `Flush` too)
+};
+
+Stats GetStats();
+
+}  // namespace journal
+
+}  // namespace automat
@@ -0,0 +1,168 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "journal.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+#include "virtual_fs.hh"
+
+using namespace automat;
+using namespace maf;
+
+struct JournalTest : TestBase {
+  Path path = Path::TempDirPath() / "automat_journal_test.journal";
+  Location loaded_root = Location(nullptr);
+  Machine& loaded = *loaded_root.Create<Machine>();
+
+  ~JournalTest() {
+    journal::Stop();
+    Status status;
+    path.Unlink(status, true);
+  }
+
+  Str Journal() {
+    journal::Stop();
+    Status status;
+    Str data = fs::real.Read(path, status);
+    EXPECT_TRUE(OK(status)) << status.ToStr();
+    return data;
+  }
+
+  Location* Loaded(StrView name) {
+    for (auto& location : loaded.locations) {
+      if (location->name == name) {
+        return location.get();
+      }
+    }
+    return nullptr;
+  }
+};
+
+TEST_F(JournalTest, ReplaysEdits) {
+  Location& text = machine.Create<Text>("text");  // saved in the initial snapshot
+  journal::Start(path, root);
+  Location& test = machine.Create<EqualityTest>("test");
+  test.ConnectTo(text, EqualityTest::target_arg);
+  text.SetText("hello");
+  text.position = Vec2(1, 2);
+  machine.UpdateIndex(text);
+  machine.Extract(machine.Create<Text>("deleted"));
+  journal::Flush();
+
+  Status status;
+  journal::Load(Journal(), loaded_root, status);
+  ASSERT_TRUE(OK(status)) << status.ToStr();
+  ASSERT_EQ(loaded.locations.size(), 2);
+  Location* loaded_text = Loaded("text");
+  Location* loaded_test = Loaded("test");
+  ASSERT_NE(loaded_text, nullptr);
+  ASSERT_NE(loaded_test, nullptr);
+  EXPECT_EQ(loaded_text->GetText(), "hello");
+  EXPECT_EQ(loaded_text->position.x, 1.f);
+  EXPECT_EQ(loaded_text->position.y, 2.f);
+  ASSERT_EQ(loaded_test->outgoing.size(), 1);
+  EXPECT_EQ(&(*loaded_test->outgoing.begin())->to, loaded_text);
+}
+
+TEST_F(JournalTest, TornRecordsAreSkipped) {
+  journal::Start(path, root);
+  machine.Create<Text>("first");
+  machine.Create<Text>("second");
+  Str data = Journal();
+  data.resize(data.size() - 3);  // crash in the middle of the last record
+  auto stats = journal::GetStats();
+  Status status;
+  journal::Load(data, loaded_root, status);
+  EXPECT_TRUE(OK(status)) << status.ToStr();
+  EXPECT_EQ(journal::GetStats().skipped, stats.skipped + 1);
+  EXPECT_NE(Loaded("first"), nullptr);
+  EXPECT_EQ(Loaded("second"), nullptr);
+}
+
+// Records that pass the checksum but can't be decoded also stop the replay.
+TEST_F(JournalTest, ReplayStopsAtUndecodableRecords) {
+  journal::Start(path, root);
+  machine.Create<Text>("first");
+  machine.Create<Text>("second");
+  Str data = Journal();
+  // Records follow the 24-byte header & the snapshot (padded to 8 bytes). Give the first one an
+  // unknown kind & a matching checksum (FNV-1a of the payload).
+  uint64_t snapshot_size;
+  memcpy(&snapshot_size, data.data() + 16, sizeof(snapshot_size));
+  char* frame = data.data() + 24 + ((snapshot_size + 7) & ~7ull);
+  uint32_t size;
+  memcpy(&size, frame, sizeof(size));
+  frame[8] = (char)0xff;
+  uint32_t checksum = 2166136261u;
+  for (uint32_t i = 0; i < size; ++i) {
+    checksum = (checksum ^ (uint8_t)frame[8 + i]) * 16777619u;
+  }
+  memcpy(frame + 4, &checksum, sizeof(checksum));
+
+  auto stats = journal::GetStats();
+  Status status;
+  journal::Load(data, loaded_root, status);
+  EXPECT_TRUE(OK(status)) << status.ToStr();
+  EXPECT_EQ(journal::GetStats().skipped, stats.skipped + 1);
+  EXPECT_TRUE(loaded.locations.empty());
+}
+
+// Locations are re-indexed whenever their shape changes. Only actual moves are journaled.
+TEST_F(JournalTest, ReindexingDoesNotRecordMoves) {
+  Location& text = machine.Create<Text>("text");
+  journal::Start(path, root);
+  auto stats = journal::GetStats();
+  text.InvalidateShape();
+  journal::Flush();
+  EXPECT_EQ(journal::GetStats().records, stats.records);
+
+  text.position = Vec2(1, 2);
+  machine.UpdateIndex(text);
+  journal::Flush();
+  EXPECT_EQ(journal::GetStats().records, stats.records + 1);
+}
+
+// Replayed state changes replace the object. Connections of the Arguments that belong to the old
+// instance (such as the duration of a TimerDelay) are moved to the new one.
+TEST_F(JournalTest, ChangedObjectsKeepTheirConnections) {
+  Location& timer = machine.Create<library::TimerDelay>("timer");
+  Location& duration = machine.Create<Text>("duration");
+  duration.SetText("5");
+  timer.ConnectTo(duration, timer.ThisAs<library::TimerDelay>()->duration_arg);
+  journal::Start(path, root);
+  journal::ObjectChanged(timer);  // marks the state of the timer as changed
+  journal::Flush();
+
+  Status status;
+  journal::Load(Journal(), loaded_root, status);
+  ASSERT_TRUE(OK(status)) << status.ToStr();
+  Location* loaded_timer = Loaded("timer");
+  ASSERT_NE(loaded_timer, nullptr);
+  ASSERT_EQ(loaded_timer->outgoing.size(), 1);
+  Connection* connection = *loaded_timer->outgoing.begin();
+  EXPECT_EQ(&connection->argument, &loaded_timer->ThisAs<library::TimerDelay>()->duration_arg);
+  EXPECT_EQ(&connection->to, Loaded("duration"));
+}
+
+// State is re-serialized in full, so it's encoded at most once per second. `Stop` encodes the rest.
+TEST_F(JournalTest, StateIsEncodedOncePerSecond) {
+  Location& text = machine.Create<Text>("text");
+  journal::Start(path, root);
+  text.SetText("first");
+  journal::Flush();
+  auto stats = journal::GetStats();
+  text.SetText("second");
+  journal::Flush();
+  EXPECT_EQ(journal::GetStats().records, stats.records);
+
+  Status status;
+  journal::Load(Journal(), loaded_root, status);
+  ASSERT_TRUE(OK(status)) << status.ToStr();
+  ASSERT_NE(Loaded("text"), nullptr);
+  EXPECT_EQ(Loaded("text")->GetText(), "second");
+}
@@ -5,9 +5,9 @@
 #include <map>
 #include <set>
 
-#include "automat.hh"
 #include "font.hh"
 #include "root.hh"
+#include "system_input.hh"
 #include "window.hh"
 
 #if defined(_WIN32)
@@ -21,10 +21,7 @@
 #if defined(__linux__)
 #include <xcb/xinput.h>
 #include <xcb/xproto.h>
-#include <xcb/xtest.h>
 
-#include "format.hh"
-#include "linux_main.hh"
 #include "x11.hh"
 
 #endif
@@ -135,39 +132,7 @@ KeyGrab& Keyboard::RequestKeyGrab(KeyGrabber& key_grabber, AnsiKey key, bool ctr
     });
   });
 #else
-  U16 modifiers = 0;
-  if (ctrl) {
-    modifiers |= XCB_MOD_MASK_CONTROL;
-  }
-  if (alt) {
-    modifiers |= XCB_MOD_MASK_1;
-  }
-  if (shift) {
-    modifiers |= XCB_MOD_MASK_SHIFT;
-  }
-  if (windows) {
-    modifiers |= XCB_MOD_MASK_4;
-  }
-  xcb_keycode_t keycode = (U8)x11::KeyToX11KeyCode(key);
-
-  for (bool caps_lock : {true, false}) {
-    for (bool num_lock : {true, false}) {
-      for (bool scroll_lock : {true, false}) {
-        for (bool level3shift : {true, false}) {
-          modifiers =
-              caps_lock ? (modifiers | XCB_MOD_MASK_LOCK) : (modifiers & ~XCB_MOD_MASK_LOCK);
-          modifiers = num_lock ? (modifiers | XCB_MOD_MASK_2) : (modifiers & ~XCB_MOD_MASK_2);
-          modifiers = scroll_lock ? (modifiers | XCB_MOD_MASK_5) : (modifiers & ~XCB_MOD_MASK_5);
-          modifiers = level3shift ? (modifiers | XCB_MOD_MASK_3) : (modifiers & ~XCB_MOD_MASK_3);
-          auto cookie = xcb_grab_key(connection, 0, screen->root, modifiers, keycode,
-                                     XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
-          if (auto err = xcb_request_check(connection, cookie)) {
-            FATAL << "Failed to grab key: " << err->error_code;
-          }
-        }
-      }
-    }
-  }
+  system_input->GrabKey(key, ctrl, alt, shift, windows);
 #endif
   key_grabs.emplace_back(std::move(key_grab));
   return *key_grabs.back().get();
@@ -176,21 +141,7 @@ KeyGrab& Keyboard::RequestKeyGrab(KeyGrabber& key_grabber, AnsiKey key, bool ctr
 Keylogging& Keyboard::BeginKeylogging(Keylogger& keylogger) {
   if (keyloggings.empty()) {
 #ifdef __linux__
-    struct input_event_mask {
-      xcb_input_event_mask_t header = {
-          .deviceid = XCB_INPUT_DEVICE_ALL_MASTER,
-          .mask_len = 1,
-      };
-      uint32_t mask =
-          XCB_INPUT_XI_EVENT_MASK_RAW_KEY_PRESS | XCB_INPUT_XI_EVENT_MASK_RAW_KEY_RELEASE;
-    } event_mask;
-
-    xcb_void_cookie_t cookie =
-        xcb_input_xi_select_events_checked(connection, screen->root, 1, &event_mask.header);
-
-    if (std::unique_ptr<xcb_generic_error_t> error{xcb_request_check(connection, cookie)}) {
-      ERROR << f("Couldn't select X11 events for keylogging: %d", error->error_code);
-    }
+    system_input->WatchRawKeys(true);
 #endif  // __linux__
 #ifdef _WIN32
     RegisterRawInput(true);
@@ -679,10 +630,7 @@ void SendKeyEvent(AnsiKey physical, bool down) {
   SendInput(1, &input, sizeof(INPUT));
 #endif
 #if defined(__linux__)
-  xcb_test_fake_input(connection, down ? XCB_KEY_PRESS : XCB_KEY_RELEASE,
-                      (uint8_t)x11::KeyToX11KeyCode(physical), XCB_CURRENT_TIME, screen->root, 0, 0,
-                      0);
-  xcb_flush(connection);
+  system_input->SendKey(physical, down);
 #endif
 }
 
@@ -763,12 +711,7 @@ void KeyGrab::Release() {
     }
   });
 #else
-  xcb_keycode_t keycode = (U8)x11::KeyToX11KeyCode(key);
-
-  auto cookie = xcb_ungrab_key_checked(connection, keycode, screen->root, XCB_MOD_MASK_ANY);
-  if (auto err = xcb_request_check(connection, cookie)) {
-    FATAL << "Failed to ungrab key: " << err->error_code;
-  }
+  system_input->UngrabKey(key);
 #endif
   grabber.ReleaseKeyGrab(*this);
   for (auto it = keyboard.key_grabs.begin(); it != keyboard.key_grabs.end(); ++it) {
@@ -791,20 +734,7 @@ void Keylogging::Release() {
   }
   if (keyboard.keyloggings.size() == 1) {
 #ifdef __linux__
-    struct input_event_mask {
-      xcb_input_event_mask_t header = {
-          .deviceid = XCB_INPUT_DEVICE_ALL_MASTER,
-          .mask_len = 1,
-      };
-      uint32_t mask = 0;
-    } event_mask;
-
-    xcb_void_cookie_t cookie =
-        xcb_input_xi_select_events_checked(connection, screen->root, 1, &event_mask.header);
-
-    if (std::unique_ptr<xcb_generic_error_t> error{xcb_request_check(connection, cookie)}) {
-      ERROR << f("Couldn't release X11 event selection: %d", error->error_code);
-    }
+    system_input->WatchRawKeys(false);
 #endif  // __linux__
 #ifdef _WIN32
     RegisterRawInput(false);
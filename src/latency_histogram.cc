@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "latency_histogram.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#include "format.hh"
+
+namespace automat {
+
+void LatencyHistogram::Add(double latency_us) {
+  int bucket = latency_us < 1 ? 0 : std::min<int>(std::ilogb(latency_us) + 1, kBuckets - 1);
+  ++buckets[bucket];
+  ++count;
+  sum_us += latency_us;
+  max_us = std::max(max_us, latency_us);
+}
+
+void LatencyHistogram::Add(const LatencyHistogram& other) {
+  for (int i = 0; i < kBuckets; ++i) {
+    buckets[i] += other.buckets[i];
+  }
+  count += other.count;
+  sum_us += other.sum_us;
+  max_us = std::max(max_us, other.max_us);
+}
+
+double LatencyHistogram::MeanUs() const { return count ? sum_us / count : 0; }
+
+double LatencyHistogram::PercentileUs(double percentile) const {
+  uint64_t target = std::ceil(count * percentile / 100);
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets - 1; ++i) {
+    seen += buckets[i];
+    if (seen >= target) {
+      return std::ldexp(1, i);
+    }
+  }
+  return max_us;
+}
+
+std::string LatencyHistogram::Format(const char* what) const {
+  return maf::f("%llu %s, mean %.1fus, p50 < %.0fus, p99 < %.0fus, max %.1fus",
+                (unsigned long long)count, what, MeanUs(), PercentileUs(50), PercentileUs(99),
+                max_us);
+}
+
+}  // namespace automat
@@ -0,0 +1,30 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace automat {
+
+// Histogram of latencies (in microseconds) with logarithmic buckets. Cheap enough to be updated
+// for every task.
+struct LatencyHistogram {
+  // Bucket 0 counts latencies below 1us. Bucket `i` counts latencies in [2^(i-1), 2^i) us. The last
+  // bucket also counts all of the larger latencies.
+  static constexpr int kBuckets = 24;
+  uint64_t buckets[kBuckets] = {};
+  uint64_t count = 0;
+  double sum_us = 0;
+  double max_us = 0;
+
+  void Add(double latency_us);
+  void Add(const LatencyHistogram&);
+  double MeanUs() const;
+  // Upper bound of the bucket that contains the given percentile (0-100).
+  double PercentileUs(double percentile) const;
+  // `what` names the samples, for example "timers" or "tasks".
+  std::string Format(const char* what = "samples") const;
+};
+
+}  // namespace automat
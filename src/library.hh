@@ -17,6 +17,7 @@
 
 #include "algebra.hh"
 #include "base.hh"
+#include "cow.hh"
 #include "format.hh"
 #include "library_alert.hh"           // IWYU pragma: keep
 #include "library_flip_flop.hh"       // IWYU pragma: keep
@@ -181,7 +182,7 @@ struct Timer : Object, Runnable {
     if (fake_time) {
       return fake_time->now;
     } else {
-      return time::SteadyClock::now();
+      return time::SteadyNow();
     }
   }
 };
@@ -464,7 +465,10 @@ struct ErrorCleaner : Object {
 };
 
 struct AbstractList {
-  virtual Error* GetAtIndex(int index, Object*& obj) = 0;
+  // Read-only access to the element.
+  virtual Error* GetAtIndex(int index, const Object*& obj) = 0;
+  // Access to the element that may be modified in place, for example through a Pointer.
+  virtual Error* EditAtIndex(int index, Object*& obj) = 0;
   virtual Error* PutAtIndex(int index, bool overwrite, std::unique_ptr<Object> obj) = 0;
   virtual Error* TakeAtIndex(int index, bool leave_null, std::unique_ptr<Object>& obj) = 0;
   virtual Error* GetSize(int& size) = 0;
@@ -501,52 +505,76 @@ struct Append : Object, Runnable {
   }
 };
 
+// Deep copy of the elements of a List.
+struct CloneObjects {
+  vector<unique_ptr<Object>> operator()(const vector<unique_ptr<Object>>& objects) const {
+    vector<unique_ptr<Object>> copy;
+    copy.reserve(objects.size());
+    for (auto& object : objects) {
+      copy.emplace_back(object ? object->Clone() : nullptr);
+    }
+    return copy;
+  }
+};
+
 struct List : Object, AbstractList {
   static const List proto;
   Location* here = nullptr;
-  vector<unique_ptr<Object>> objects;
+  // Shared between the clones of a list. The elements are copied when one of the clones is
+  // modified - also when it hands out an element through `EditAtIndex`, because the element can be
+  // modified through the returned pointer.
+  Cow<vector<unique_ptr<Object>>, CloneObjects> objects;
   string_view Name() const override { return "List"; }
   std::unique_ptr<Object> Clone() const override {
     auto list = std::make_unique<List>();
-    for (auto& object : objects) {
-      list->objects.emplace_back(object->Clone());
-    }
+    list->objects = objects;
     return list;
   }
   void Relocate(Location* here) override { this->here = here; }
-  Error* GetAtIndex(int index, Object*& obj) override {
-    if (index < 0 || index >= objects.size()) {
+  Error* GetAtIndex(int index, const Object*& obj) override {
+    if (index < 0 || index >= objects->size()) {
       return here->ReportError("Index out of bounds.");
     }
-    obj = objects[index].get();
+    obj = (*objects)[index].get();
+    return nullptr;
+  }
+  Error* EditAtIndex(int index, Object*& obj) override {
+    if (index < 0 || index >= objects->size()) {
+      return here->ReportError("Index out of bounds.");
+    }
+    obj = objects.Write()[index].get();
     return nullptr;
   }
   Error* PutAtIndex(int index, bool overwrite, std::unique_ptr<Object> obj) override {
-    if (index < 0 || (overwrite ? index >= objects.size() : index > objects.size())) {
+    if (index < 0 || (overwrite ? index >= objects->size() : index > objects->size())) {
       // TODO: save the object in the error - it shouldn't be destroyed!
       return here->ReportError("Index out of bounds.");
     }
+    auto& elements = objects.Write();
     if (overwrite) {
-      objects[index] = std::move(obj);
+      elements[index] = std::move(obj);
     } else {
-      objects.insert(objects.begin() + index, std::move(obj));
+      elements.insert(elements.begin() + index, std::move(obj));
     }
+    journal::ObjectChanged(*here);
     here->ScheduleUpdate();
     return nullptr;
   }
   Error* TakeAtIndex(int index, bool keep_null, std::unique_ptr<Object>& obj) override {
-    if (index < 0 || index >= objects.size()) {
+    if (index < 0 || index >= objects->size()) {
       return here->ReportError("Index out of bounds.");
     }
-    obj = std::move(objects[index]);
+    auto& elements = objects.Write();
+    obj = std::move(elements[index]);
     if (!keep_null) {
-      objects.erase(objects.begin() + index);
+      elements.erase(elements.begin() + index);
     }
+    journal::ObjectChanged(*here);
     here->ScheduleUpdate();
     return nullptr;
   }
   Error* GetSize(int& size) override {
-    size = objects.size();
+    size = objects->size();
     return nullptr;
   }
 };
@@ -637,14 +665,21 @@ struct Filter : LiveObject, Iterator, AbstractList, Runnable {
       return nullptr;
     }
     Object* obj = nullptr;
-    if (list.typed->GetAtIndex(index, obj)) {
+    if (list.typed->EditAtIndex(index, obj)) {
       return nullptr;
     }
     return obj;
   }
   void Updated(Location& here, Location& updated) override;
   // AbstractList interface
-  Error* GetAtIndex(int index, Object*& obj) override {
+  Error* GetAtIndex(int index, const Object*& obj) override {
+    if (index < 0 || index >= objects.size()) {
+      return here->ReportError("Index out of bounds.");
+    }
+    obj = objects[index];
+    return nullptr;
+  }
+  Error* EditAtIndex(int index, Object*& obj) override {
     if (index < 0 || index >= objects.size()) {
       return here->ReportError("Index out of bounds.");
     }
@@ -1025,7 +1060,7 @@ struct ListView : Pointer {
     }
     if (index >= size) return nullptr;
     Object* obj = nullptr;
-    if (auto err = list.typed->GetAtIndex(index, obj)) {
+    if (auto err = list.typed->EditAtIndex(index, obj)) {
       return nullptr;
     }
     return obj;
@@ -1083,13 +1118,12 @@ struct AlgebraContext : algebra::Context {
 
 struct Blackboard : Object {
   static const Blackboard proto;
-  unique_ptr<algebra::Statement> statement = nullptr;
+  // Never modified once parsed (`SetText` replaces it) so it's shared between the clones.
+  std::shared_ptr<algebra::Statement> statement = nullptr;
   string_view Name() const override { return "Formula"; }
   std::unique_ptr<Object> Clone() const override {
     auto other = std::make_unique<Blackboard>();
-    if (statement) {
-      other->statement = statement->Clone();
-    }
+    other->statement = statement;
     return other;
   }
   string GetText() const override {
@@ -18,6 +18,7 @@
 #include "argument.hh"
 #include "color.hh"
 #include "gui_button.hh"
+#include "journal.hh"
 #include "library_macros.hh"
 #include "sincos.hh"
 #include "textures.hh"
@@ -172,6 +173,7 @@ SkMatrix FlipFlop::TransformToChild(const Widget& child, animation::Display*) co
 
 LongRunning* FlipFlop::OnRun(Location& here) {
   current_state = !current_state;
+  journal::ObjectChanged(here);
   button.InvalidateDrawCache();
   flip_arg.InvalidateConnectionWidgets(here);
 
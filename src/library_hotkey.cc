@@ -15,6 +15,7 @@
 #include "arcline.hh"
 #include "color.hh"
 #include "gui_constants.hh"
+#include "journal.hh"
 #include "key_button.hh"
 #include "keyboard.hh"
 #include "library_macros.hh"
@@ -192,6 +193,9 @@ HotKey::HotKey()
       On();
     }
     ctrl_button.fg = KeyColor(ctrl);
+    if (here) {
+      journal::ObjectChanged(*here);
+    }
   };
   alt_button.activate = [this](gui::Pointer&) {
     bool on = IsOn();
@@ -203,6 +207,9 @@ HotKey::HotKey()
       On();
     }
     alt_button.fg = KeyColor(alt);
+    if (here) {
+      journal::ObjectChanged(*here);
+    }
   };
   shift_button.activate = [this](gui::Pointer&) {
     bool on = IsOn();
@@ -214,6 +221,9 @@ HotKey::HotKey()
       On();
     }
     shift_button.fg = KeyColor(shift);
+    if (here) {
+      journal::ObjectChanged(*here);
+    }
   };
   windows_button.activate = [this](gui::Pointer&) {
     bool on = IsOn();
@@ -225,6 +235,9 @@ HotKey::HotKey()
       On();
     }
     windows_button.fg = KeyColor(windows);
+    if (here) {
+      journal::ObjectChanged(*here);
+    }
   };
   shortcut_button.SetLabel(ToStr(key));
   shortcut_button.activate = [this](gui::Pointer& pointer) {
@@ -428,6 +441,9 @@ void HotKey::KeyboardGrabberKeyDown(gui::KeyboardGrab&, gui::Key key) {
   if (on) {
     On();
   }
+  if (here) {
+    journal::ObjectChanged(*here);
+  }
 }
 
 void HotKey::KeyGrabberKeyDown(gui::KeyGrab&) {
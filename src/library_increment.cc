@@ -9,6 +9,7 @@
 #include "color.hh"
 #include "font.hh"
 #include "gui_constants.hh"
+#include "journal.hh"
 #include "library_macros.hh"
 #include "library_number.hh"
 
@@ -33,6 +34,7 @@ LongRunning* Increment::OnRun(Location& h) {
     return nullptr;
   }
   integer.typed->value += 1;
+  journal::ObjectChanged(*integer.location);
   integer.location->ScheduleUpdate();
   return nullptr;
 }
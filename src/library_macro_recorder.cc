@@ -15,6 +15,7 @@
 #include "color.hh"
 #include "embedded.hh"
 #include "gui_connection_widget.hh"
+#include "journal.hh"
 #include "keyboard.hh"
 #include "library_key_presser.hh"
 #include "library_macros.hh"
@@ -275,6 +276,7 @@ LongRunning* MacroRecorder::OnRun(Location& here) {
     timeline->BeginRecording();
     audio::Play(embedded::assets_SFX_macro_start_wav);
     keylogging = &gui::keyboard->BeginKeylogging(*this);
+    journal::ObjectChanged(here);
   }
   return this;
 }
@@ -286,6 +288,9 @@ void MacroRecorder::Cancel() {
     audio::Play(embedded::assets_SFX_macro_stop_wav);
     keylogging->Release();
     keylogging = nullptr;
+    if (here) {
+      journal::ObjectChanged(*here);
+    }
   }
 }
 
@@ -317,13 +322,14 @@ static void RecordKeyEvent(MacroRecorder& macro_recorder, AnsiKey key, bool down
     if (!down) {
       // If the key is released then we should assume that it was pressed before the recording and
       // the pressed section should start at 0.
-      new_track.timestamps.push_back(0);
+      new_track.timestamps.Write().push_back(0);
     }
     track_index = timeline->tracks.size() - 1;
     Location& key_presser_loc = machine->Create<KeyPresser>();
     KeyPresser* key_presser = key_presser_loc.As<KeyPresser>();
     key_presser->SetKey(key);
-    Rect key_presser_shape = key_presser_loc.object->Shape(nullptr).getBounds();
+    journal::ObjectChanged(key_presser_loc);
+    Rect key_presser_shape = key_presser_loc.ObjectShape().getBounds();
     Argument& track_arg = *timeline->track_args.back();
     Vec2AndDir arg_start = timeline->here->ArgStart(nullptr, track_arg);
 
@@ -340,6 +346,7 @@ static void RecordKeyEvent(MacroRecorder& macro_recorder, AnsiKey key, bool down
     }
 
     key_presser_loc.position = arg_start.pos + Vec2(3_cm, 0) - best_connector_pos;
+    machine->UpdateIndex(key_presser_loc);
     AnimateGrowFrom(*macro_recorder.here, key_presser_loc);
     timeline->here->ConnectTo(key_presser_loc, track_arg);
   }
@@ -351,7 +358,8 @@ static void RecordKeyEvent(MacroRecorder& macro_recorder, AnsiKey key, bool down
     return;
   }
 
-  auto& ts = track->timestamps;
+  journal::ObjectChanged(*timeline->here);
+  auto& ts = track->timestamps.Write();
   time::T t = (time::SteadyNow() - timeline->recording.started_at).count();
 
   size_t next_i = std::lower_bound(ts.begin(), ts.end(), t) - ts.begin();
@@ -562,7 +570,7 @@ void MacroRecorder::DeserializeState(Location& l, Deserializer& d) {
         if (value) {
           l.ScheduleRun();
         } else {
-          queue.push_back(new CancelTask(&l));
+          queue.Push(new CancelTask(&l));
         }
       }
     }
@@ -10,12 +10,6 @@
 #include <windows.h>
 #endif
 
-#if defined(__linux__)
-#include <xcb/xtest.h>
-
-#pragma comment(lib, "xcb-xtest")
-#endif
-
 #include <include/core/SkAlphaType.h>
 #include <include/core/SkBitmap.h>
 #include <include/core/SkBlendMode.h>
@@ -34,12 +28,9 @@
 #include "pointer.hh"
 #include "prototypes.hh"
 #include "svg.hh"
+#include "system_input.hh"
 #include "textures.hh"
 
-#if defined(__linux__)
-#include "linux_main.hh"
-#endif
-
 using namespace maf;
 
 namespace automat::library {
@@ -190,10 +181,7 @@ LongRunning* MouseClick::OnRun(Location& location) {
   SendInput(1, &input, sizeof(INPUT));
 #endif
 #if defined(__linux__)
-  U8 type = down ? XCB_BUTTON_PRESS : XCB_BUTTON_RELEASE;
-  U8 detail = button == gui::PointerButton::Left ? 1 : 3;
-  xcb_test_fake_input(connection, type, detail, XCB_CURRENT_TIME, XCB_NONE, 0, 0, 0);
-  xcb_flush(connection);
+  gui::system_input->SendButton(button, down);
 #endif
   return nullptr;
 }
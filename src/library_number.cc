@@ -16,6 +16,7 @@
 #include "gui_constants.hh"
 #include "gui_shape_widget.hh"
 #include "gui_text.hh"
+#include "journal.hh"
 #include "library_macros.hh"
 #include "widget.hh"
 
@@ -92,6 +93,7 @@ Number::Number(double x)
       }
       value = std::stod(text_field.text);
       text_field.InvalidateDrawCache();
+      journal::ObjectChanged(l);
       l.ScheduleUpdate();
     };
   }
@@ -107,6 +109,7 @@ Number::Number(double x)
     }
     value = std::stod(text_field.text);
     text_field.InvalidateDrawCache();
+    journal::ObjectChanged(l);
     l.ScheduleUpdate();
   };
   backspace.activate = [this](Location& l) {
@@ -118,6 +121,7 @@ Number::Number(double x)
     }
     value = std::stod(text_field.text);
     text_field.InvalidateDrawCache();
+    journal::ObjectChanged(l);
     l.ScheduleUpdate();
   };
 }
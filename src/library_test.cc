@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include "base.hh"
+#include "dataflow.hh"
 #include "test_base.hh"
 
 using namespace automat;
@@ -34,3 +35,31 @@ TEST_F(StartsWithTestTest, StartsWithFalse) {
   RunLoop();
   EXPECT_EQ("false", test.GetText());
 }
+
+TEST_F(StartsWithTestTest, CoalescedUpdates) {
+  // Waves merge the updates on their own (see dataflow_test.cc).
+  dataflow::DisabledGuard no_waves;
+  uint64_t coalesced_before = coalesced_updates;
+  starts.SetText("Hello, world!");
+  starts.SetText("Hello");
+  starts.SetText("Hello, world!");
+  with.SetText("Hello");
+  RunLoop();
+  EXPECT_EQ("true", test.GetText());
+  // Second & third change of "starts" should reuse the first pending UpdateTask.
+  EXPECT_EQ(coalesced_before + 2, coalesced_updates);
+}
+
+TEST_F(StartsWithTestTest, CoalescedUpdateTakesTheMoreUrgentLane) {
+  dataflow::DisabledGuard no_waves;
+  starts.SetText("Hello, world!");
+  EXPECT_EQ(1, queue.lanes[(int)Priority::Dataflow].size());
+  queue.current = Priority::Input;  // as if the text was typed in
+  starts.SetText("Hello");
+  queue.current = Priority::Dataflow;
+  EXPECT_TRUE(queue.lanes[(int)Priority::Dataflow].empty());
+  EXPECT_EQ(1, queue.lanes[(int)Priority::Input].size());
+  with.SetText("Hello");
+  RunLoop();
+  EXPECT_EQ("true", test.GetText());
+}
@@ -25,6 +25,7 @@
 #include "gui_button.hh"
 #include "gui_constants.hh"
 #include "gui_shape_widget.hh"
+#include "journal.hh"
 #include "key_button.hh"
 #include "library_macros.hh"
 #include "math.hh"
@@ -378,7 +379,9 @@ OnOffTrack& Timeline::AddOnOffTrack(StrView name) {
   track->timeline = this;
   tracks.emplace_back(std::move(track));
   AddTrackArg(*this, tracks.size() - 1, name);
+  here->InvalidateShape();  // the case grows with each track
   here->InvalidateConnectionWidgets();
+  journal::ObjectChanged(*here);
   return *dynamic_cast<OnOffTrack*>(tracks.back().get());
 }
 
@@ -409,10 +412,10 @@ time::T Timeline::MaxTrackLength() const {
     max_track_length = max(max_track_length, (time::SteadyNow() - recording.started_at).count());
   }
   for (const auto& track : tracks) {
-    if (track->timestamps.empty()) {
+    if (track->timestamps->empty()) {
       continue;
     }
-    max_track_length = max(max_track_length, track->timestamps.back());
+    max_track_length = max(max_track_length, track->timestamps->back());
   }
   return max_track_length;
 }
@@ -438,7 +441,7 @@ void TimelineCancelScheduledAt(Timeline& t) { CancelScheduledAt(*t.here); }
 void TimelineScheduleAt(Timeline& t, time::SteadyPoint now) {
   time::SteadyPoint next_update = t.playing.started_at + time::Duration(t.MaxTrackLength());
   for (const auto& track : t.tracks) {
-    for (time::T timestamp : track->timestamps) {
+    for (time::T timestamp : *track->timestamps) {
       auto timestamp_abs = t.playing.started_at + time::Duration(timestamp);
       if (timestamp_abs <= now) {
         continue;
@@ -461,6 +464,13 @@ static void TimelineUpdateOutputs(Location& here, Timeline& t, time::SteadyPoint
   }
 }
 
+// Marks the state of the Timeline (tracks, playback position) as changed.
+static void StateChanged(Timeline& timeline) {
+  if (timeline.here) {
+    journal::ObjectChanged(*timeline.here);
+  }
+}
+
 static time::T CurrentOffset(Timeline& timeline, time::SteadyPoint now) {
   switch (timeline.state) {
     case Timeline::kPlaying:
@@ -483,6 +493,7 @@ void OffsetPosRatio(Timeline& timeline, time::T offset, time::SteadyPoint now) {
     timeline.paused.playback_offset =
         clamp<time::T>(timeline.paused.playback_offset + offset, 0, timeline.MaxTrackLength());
   }
+  StateChanged(timeline);
   timeline.InvalidateDrawCache();
 }
 
@@ -497,6 +508,7 @@ void SetPosRatio(Timeline& timeline, float pos_ratio, time::SteadyPoint now) {
   } else if (timeline.state == Timeline::kPaused) {
     timeline.paused.playback_offset = pos_ratio * max_track_length;
   }
+  StateChanged(timeline);
   timeline.InvalidateDrawCache();
 }
 
@@ -1238,7 +1250,7 @@ SkPath TrackBase::Shape(animation::Display*) const {
   } else {
     distance_to_seconds = 100;  // 1 cm = 1 second
   }
-  time::T end_time = timeline ? timeline->MaxTrackLength() : timestamps.back();
+  time::T end_time = timeline ? timeline->MaxTrackLength() : timestamps->back();
   Rect rect = Rect(0, -kTrackHeight / 2, end_time / distance_to_seconds, kTrackHeight / 2);
   if (timeline) {
     // Clip to the width of the timeline window
@@ -1269,8 +1281,9 @@ animation::Phase OnOffTrack::Draw(gui::DrawContext& dctx) const {
     end = min(end, rect.right);
     dctx.canvas.drawLine({start, 0}, {end, 0}, kOnOffPaint);
   };
-  for (int i = 0; i + 1 < timestamps.size(); i += 2) {
-    DrawSegment(timestamps[i], timestamps[i + 1]);
+  auto& ts = *timestamps;
+  for (int i = 0; i + 1 < ts.size(); i += 2) {
+    DrawSegment(ts[i], ts[i + 1]);
   }
   if (!isnan(on_at)) {
     switch (timeline->state) {
@@ -1295,6 +1308,7 @@ void Timeline::Cancel() {
     paused = {.playback_offset = (time::SteadyNow() - playing.started_at).count()};
     TimelineUpdateOutputs(*here, *this, time::SteadyPoint{},
                           time::SteadyPoint{} + time::Duration(paused.playback_offset));
+    StateChanged(*this);
     run_button.InvalidateDrawCache();
   }
 }
@@ -1312,6 +1326,7 @@ LongRunning* Timeline::OnRun(Location& here) {
   playing = {.started_at = now - time::Duration(paused.playback_offset)};
   TimelineUpdateOutputs(here, *this, playing.started_at, now);
   TimelineScheduleAt(*this, now);
+  StateChanged(*this);
   run_button.InvalidateDrawCache();
   return this;
 }
@@ -1330,6 +1345,7 @@ void Timeline::BeginRecording() {
       recording.started_at = playing.started_at;
       break;
   }
+  StateChanged(*this);
   run_button.InvalidateDrawCache();
 }
 
@@ -1341,14 +1357,16 @@ void Timeline::StopRecording() {
   paused = {.playback_offset =
                 min((time::SteadyNow() - recording.started_at).count(), timeline_length)};
   state = Timeline::kPaused;
+  StateChanged(*this);
   run_button.InvalidateDrawCache();
 }
 
 void OnOffTrack::UpdateOutput(Location& target, time::SteadyPoint started_at,
                               time::SteadyPoint now) {
+  auto& ts = *timestamps;
   int i = 0;
-  for (; i < timestamps.size(); ++i) {
-    if (started_at + time::Duration(timestamps[i]) > now) {
+  for (; i < ts.size(); ++i) {
+    if (started_at + time::Duration(ts[i]) > now) {
       break;
     }
   }
@@ -1357,7 +1375,7 @@ void OnOffTrack::UpdateOutput(Location& target, time::SteadyPoint started_at,
   if (timeline->state != Timeline::kPlaying) {
     on = false;
   }
-  if (auto runnable = dynamic_cast<Runnable*>(target.object.get())) {
+  if (auto runnable = InterfaceCast<Runnable>(target.object.get())) {
     if (on) {
       target.ScheduleRun();
     } else {
@@ -1376,6 +1394,7 @@ void Timeline::OnTimerNotification(Location& here, time::SteadyPoint now) {
   if (now >= end_at) {
     state = kPaused;
     paused = {.playback_offset = MaxTrackLength()};
+    journal::ObjectChanged(here);
     Done(here);
     run_button.InvalidateDrawCache();
   }
@@ -1400,9 +1419,10 @@ bool OnOffTrack::IsOn() const {
   auto now = time::SteadyNow();
   auto current_offset = CurrentOffset(*timeline, now);
 
+  auto& ts = *timestamps;
   int i = 0;
-  for (; i < timestamps.size(); ++i) {
-    if (timestamps[i] > current_offset) {
+  for (; i < ts.size(); ++i) {
+    if (ts[i] > current_offset) {
       break;
     }
   }
@@ -1417,12 +1437,18 @@ void TrackBase::SerializeState(Serializer& writer, const char* key) const {
     writer.Key(key);
     writer.StartObject();
   }
-  writer.Key("timestamps");
-  writer.StartArray();
-  for (auto t : timestamps) {
-    writer.Double(t);
+  // Snapshots keep the timestamps in binary.
+  if (writer.samples) {
+    writer.Key("timestamps_samples");
+    writer.Int(writer.samples->Store(*timestamps));
+  } else {
+    writer.Key("timestamps");
+    writer.StartArray();
+    for (auto t : *timestamps) {
+      writer.Double(t);
+    }
+    writer.EndArray();
   }
-  writer.EndArray();
   if (key != nullptr) {
     writer.EndObject();
   }
@@ -1485,19 +1511,34 @@ void Timeline::SerializeState(Serializer& writer, const char* key) const {
 
 bool TrackBase::TryDeserializeField(Location& l, Deserializer& d, maf::Str& field_name) {
   if (field_name == "timestamps") {
-    timestamps.clear();
+    auto& ts = timestamps.Write();
+    ts.clear();
     Status status;
     for (int i : ArrayView(d, status)) {
       double t;
       d.Get(t, status);
       if (OK(status)) {
-        timestamps.push_back(t);
+        ts.push_back(t);
       }
     }
     if (!OK(status)) {
       l.ReportError(status.ToStr());
     }
     return true;
+  } else if (field_name == "timestamps_samples") {
+    Status status;
+    int index = -1;
+    d.Get(index, status);
+    if (d.samples) {
+      auto samples = d.samples->Load(index, status);
+      timestamps.Write().assign(samples.begin(), samples.end());
+    } else {
+      AppendErrorMessage(status) += "Samples can only be loaded from snapshots";
+    }
+    if (!OK(status)) {
+      l.ReportError(status.ToStr());
+    }
+    return true;
   }
   return false;
 }
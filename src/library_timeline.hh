@@ -7,6 +7,7 @@
 
 #include "animation.hh"
 #include "base.hh"
+#include "cow.hh"
 #include "gui_button.hh"
 #include "on_off.hh"
 #include "run_button.hh"
@@ -48,7 +49,8 @@ struct TimelineRunButton : gui::ToggleButton {
 
 struct TrackBase : Object {
   Timeline* timeline = nullptr;
-  maf::Vec<time::T> timestamps;
+  // Shared between the clones of a track until one of them is recorded over.
+  Cow<maf::Vec<time::T>> timestamps;
   SkPath Shape(animation::Display*) const override;
   animation::Phase Draw(gui::DrawContext&) const override;
   std::unique_ptr<Action> FindAction(gui::Pointer&, gui::ActionTrigger) override;
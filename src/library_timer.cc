@@ -20,6 +20,7 @@
 #include "base.hh"
 #include "drag_action.hh"
 #include "font.hh"
+#include "journal.hh"
 #include "library_macros.hh"
 #include "math.hh"
 #include "number_text_field.hh"
@@ -61,8 +62,6 @@ constexpr static float kTickMinorLength = r4 * 0.025;
 
 static constexpr time::Duration kHandPeriod = 0.1s;
 
-void TimerDelay::OnTimerNotification(Location& here2, time::SteadyPoint) { Done(here2); }
-
 // How long it takes for the timer dial to rotate once.
 static Duration RangeDuration(TimerDelay::Range range) {
   switch (range) {
@@ -140,12 +139,14 @@ static void UpdateTextField(TimerDelay& timer) {
 
 static void SetDuration(TimerDelay& timer, Duration new_duration) {
   if (IsRunning(timer)) {
-    RescheduleAt(*timer.here, timer.start_time + timer.duration.value,
-                 timer.start_time + new_duration);
+    timer.RescheduleSleep(timer.start_time + new_duration);
   }
 
   timer.duration.value = new_duration;
   UpdateTextField(timer);
+  if (timer.here) {
+    journal::ObjectChanged(*timer.here);
+  }
 }
 
 static void PropagateDurationOutwards(TimerDelay& timer) {
@@ -232,7 +233,7 @@ constexpr static float kHandLength = r4 * 0.8;
 
 static float HandBaseDegrees(const TimerDelay& timer) {
   if (IsRunning(timer)) {
-    Duration elapsed = SteadyClock::now() - timer.start_time;
+    Duration elapsed = time::SteadyNow() - timer.start_time;
     return 90 - 360 * elapsed.count() / RangeDuration(timer.range).count();
   } else {
     return 90;
@@ -676,6 +677,7 @@ std::unique_ptr<Action> TimerDelay::FindAction(gui::Pointer& pointer, gui::Actio
         if (IsRunning(*this)) {
           Cancel();
           here->long_running = nullptr;
+          journal::ObjectChanged(*here);
         } else {
           here->ScheduleRun();
         }
@@ -689,6 +691,9 @@ std::unique_ptr<Action> TimerDelay::FindAction(gui::Pointer& pointer, gui::Actio
       left_pusher_depression.value = 1;
       UpdateTextField(*this);
       PropagateDurationOutwards(*this);
+      if (here) {
+        journal::ObjectChanged(*here);
+      }
       InvalidateDrawCache();
       return nullptr;
     }
@@ -697,6 +702,9 @@ std::unique_ptr<Action> TimerDelay::FindAction(gui::Pointer& pointer, gui::Actio
       right_pusher_depression.value = 1;
       UpdateTextField(*this);
       PropagateDurationOutwards(*this);
+      if (here) {
+        journal::ObjectChanged(*here);
+      }
       InvalidateDrawCache();
       return nullptr;
     }
@@ -719,14 +727,15 @@ void TimerDelay::Args(std::function<void(Argument&)> cb) {
 }
 
 LongRunning* TimerDelay::OnRun(Location& here) {
-  start_time = time::SteadyClock::now();
-  ScheduleAt(here, start_time + duration.value);
-  InvalidateDrawCache();
-  return this;
+  start_time = time::SteadyNow();
+  journal::ObjectChanged(here);
+  return CoRunnable::OnRun(here);
 }
 
-void TimerDelay::Cancel() {
-  CancelScheduledAt(*here, start_time + duration.value);
+Coroutine TimerDelay::Routine(Location& here) {
+  InvalidateDrawCache();
+  // Changes of the duration move the deadline through `RescheduleSleep`.
+  co_await SleepUntil(start_time + duration.value);
   InvalidateDrawCache();
 }
 
@@ -789,12 +798,12 @@ void TimerDelay::SerializeState(Serializer& writer, const char* key) const {
 }
 void TimerDelay::DeserializeState(Location& l, Deserializer& d) {
   Status status;
-  // TODO: handle deserialization into a running timer
+  bool running = false;
   for (auto& key : ObjectView(d, status)) {
     if (key == "running") {
       double value = 0;
       d.Get(value, status);
-      l.long_running = this;
+      running = true;
       start_time = time::SteadyNow() - Duration(value);
     } else if (key == "duration_seconds") {
       double value;
@@ -811,8 +820,13 @@ void TimerDelay::DeserializeState(Location& l, Deserializer& d) {
     }
   }
   UpdateTextField(*this);
-  if (l.long_running) {
-    ScheduleAt(l, start_time + duration.value);
+  if (running) {
+    // Continues from the deserialized `start_time`.
+    if (l.long_running) {
+      RescheduleSleep(start_time + duration.value);
+    } else {
+      l.long_running = CoRunnable::OnRun(l);
+    }
   }
 
   if (!OK(status)) {
@@ -4,6 +4,7 @@
 
 #include "animation.hh"
 #include "base.hh"
+#include "coroutine.hh"
 #include "number_text_field.hh"
 #include "time.hh"
 #include "timer_thread.hh"
@@ -14,7 +15,7 @@ struct DurationArgument : LiveArgument {
   DurationArgument();
 };
 
-struct TimerDelay : LiveObject, Runnable, LongRunning, TimerNotificationReceiver {
+struct TimerDelay : LiveObject, CoRunnable {
   struct MyDuration : Object {
     time::Duration value = 10s;
     std::unique_ptr<Object> Clone() const override { return std::make_unique<MyDuration>(*this); }
@@ -50,11 +51,10 @@ struct TimerDelay : LiveObject, Runnable, LongRunning, TimerNotificationReceiver
   std::unique_ptr<Action> FindAction(gui::Pointer&, gui::ActionTrigger) override;
   void Args(std::function<void(Argument&)> cb) override;
   LongRunning* OnRun(Location& here) override;
-  void Cancel() override;
+  Coroutine Routine(Location& here) override;
   void Updated(Location& here, Location& updated) override;
   ControlFlow VisitChildren(gui::Visitor& visitor) override;
   SkMatrix TransformToChild(const Widget& child, animation::Display*) const override;
-  void OnTimerNotification(Location&, time::SteadyPoint) override;
 
   void SerializeState(Serializer& writer, const char* key) const override;
   void DeserializeState(Location& l, Deserializer& d) override;
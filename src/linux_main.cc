@@ -8,6 +8,7 @@
 #include <xcb/xcb.h>
 #include <xcb/xinput.h>
 #include <xcb/xproto.h>
+#include <xcb/xtest.h>
 
 #include <cmath>
 #include <cstdint>
@@ -15,14 +16,19 @@
 #include <cstring>
 
 #include "audio.hh"
-#include "automat.hh"
+#include "base.hh"
 #include "format.hh"
+#include "journal.hh"
 #include "keyboard.hh"
 #include "library.hh"  // IWYU pragma: keep
 #include "log.hh"
 #include "persistence.hh"
 #include "root.hh"
+#include "stats.hh"
 #include "status.hh"
+#include "system_input.hh"
+#include "timer_thread.hh"
+#include "trace.hh"
 #include "vk.hh"
 #include "window.hh"
 #include "x11.hh"
@@ -30,6 +36,7 @@
 #pragma comment(lib, "vk-bootstrap")
 #pragma comment(lib, "xcb")
 #pragma comment(lib, "xcb-xinput")
+#pragma comment(lib, "xcb-xtest")
 
 // See http://who-t.blogspot.com/search/label/xi2 for XInput2 documentation.
 
@@ -320,6 +327,90 @@ void ConnectXCB(Status& status) {
   screen = iter.data;
 }
 
+// Delivers the system input through the X server. Installed once the `connection` is established.
+struct X11SystemInput : gui::SystemInput {
+  void GrabKey(AnsiKey key, bool ctrl, bool alt, bool shift, bool windows) override {
+    U16 modifiers = 0;
+    if (ctrl) {
+      modifiers |= XCB_MOD_MASK_CONTROL;
+    }
+    if (alt) {
+      modifiers |= XCB_MOD_MASK_1;
+    }
+    if (shift) {
+      modifiers |= XCB_MOD_MASK_SHIFT;
+    }
+    if (windows) {
+      modifiers |= XCB_MOD_MASK_4;
+    }
+    xcb_keycode_t keycode = (U8)x11::KeyToX11KeyCode(key);
+    for (bool caps_lock : {true, false}) {
+      for (bool num_lock : {true, false}) {
+        for (bool scroll_lock : {true, false}) {
+          for (bool level3shift : {true, false}) {
+            modifiers =
+                caps_lock ? (modifiers | XCB_MOD_MASK_LOCK) : (modifiers & ~XCB_MOD_MASK_LOCK);
+            modifiers = num_lock ? (modifiers | XCB_MOD_MASK_2) : (modifiers & ~XCB_MOD_MASK_2);
+            modifiers =
+                scroll_lock ? (modifiers | XCB_MOD_MASK_5) : (modifiers & ~XCB_MOD_MASK_5);
+            modifiers =
+                level3shift ? (modifiers | XCB_MOD_MASK_3) : (modifiers & ~XCB_MOD_MASK_3);
+            auto cookie = xcb_grab_key(connection, 0, screen->root, modifiers, keycode,
+                                       XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+            if (auto err = xcb_request_check(connection, cookie)) {
+              FATAL << "Failed to grab key: " << err->error_code;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  void UngrabKey(AnsiKey key) override {
+    xcb_keycode_t keycode = (U8)x11::KeyToX11KeyCode(key);
+    auto cookie = xcb_ungrab_key_checked(connection, keycode, screen->root, XCB_MOD_MASK_ANY);
+    if (auto err = xcb_request_check(connection, cookie)) {
+      FATAL << "Failed to ungrab key: " << err->error_code;
+    }
+  }
+
+  void WatchRawKeys(bool enabled) override {
+    struct input_event_mask {
+      xcb_input_event_mask_t header = {
+          .deviceid = XCB_INPUT_DEVICE_ALL_MASTER,
+          .mask_len = 1,
+      };
+      uint32_t mask = 0;
+    } event_mask;
+    if (enabled) {
+      event_mask.mask =
+          XCB_INPUT_XI_EVENT_MASK_RAW_KEY_PRESS | XCB_INPUT_XI_EVENT_MASK_RAW_KEY_RELEASE;
+    }
+
+    xcb_void_cookie_t cookie =
+        xcb_input_xi_select_events_checked(connection, screen->root, 1, &event_mask.header);
+
+    if (std::unique_ptr<xcb_generic_error_t> error{xcb_request_check(connection, cookie)}) {
+      ERROR << f("Couldn't %s X11 events for keylogging: %d", enabled ? "select" : "release",
+                 error->error_code);
+    }
+  }
+
+  void SendKey(AnsiKey key, bool down) override {
+    xcb_test_fake_input(connection, down ? XCB_KEY_PRESS : XCB_KEY_RELEASE,
+                        (uint8_t)x11::KeyToX11KeyCode(key), XCB_CURRENT_TIME, screen->root, 0, 0,
+                        0);
+    xcb_flush(connection);
+  }
+
+  void SendButton(gui::PointerButton button, bool down) override {
+    U8 type = down ? XCB_BUTTON_PRESS : XCB_BUTTON_RELEASE;
+    U8 detail = button == gui::PointerButton::Left ? 1 : 3;
+    xcb_test_fake_input(connection, type, detail, XCB_CURRENT_TIME, XCB_NONE, 0, 0, 0);
+    xcb_flush(connection);
+  }
+};
+
 void CreateWindow(Status& status) {
   xcb_window = xcb_generate_id(connection);
   uint32_t value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
@@ -788,16 +879,25 @@ void RenderLoop() {
   }
 }
 
-void automat::StopAutomat(maf::Status&) { automat_thread.request_stop(); }
-
 int LinuxMain(int argc, char* argv[]) {
   audio::Init(&argc, &argv);
+  bool dump_stats = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--precise-timers") == 0) {
+      SetHighPrecisionTimers(true);
+    } else if (strcmp(argv[i], "--trace") == 0) {
+      trace::Start();
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      dump_stats = true;
+    }
+  }
   SkGraphics::Init();
   Status status;
   ConnectXCB(status);
   if (!OK(status)) {
     FATAL << status;
   }
+  gui::system_input = std::make_unique<X11SystemInput>();
 
   InitAutomat(status);
   if (!OK(status)) {
@@ -835,13 +935,30 @@ int LinuxMain(int argc, char* argv[]) {
   RenderLoop();
 
   StopRoot();
+  journal::Stop();
+
+  if (dump_stats) {
+    DumpStats();
+  }
+
+  if (trace::Enabled()) {
+    trace::Stop();
+    auto trace_path = Path::ExecutablePath().Parent() / "automat_trace.json";
+    trace::Dump(trace_path, status);
+    if (OK(status)) {
+      LOG << "Task trace saved to " << trace_path.str;
+    } else {
+      ERROR << "Failed to save the task trace: " << status;
+      status.Reset();
+    }
+  }
 
   SaveState(*window, status);
   if (!OK(status)) {
     ERROR << "Failed to save state: " << status;
   }
 
-  root_machine->locations.clear();
+  root_machine->ClearLocations();
 
   mouse.reset();
   keyboard.reset();
@@ -18,7 +18,7 @@ struct ListTest : TestBase {
     for (int i = 0; i < 10; ++i) {
       std::unique_ptr<Object> obj = Create<Integer>();
       dynamic_cast<Integer*>(obj.get())->i = i;
-      l->objects.emplace_back(std::move(obj));
+      l->objects.Write().emplace_back(std::move(obj));
     }
   }
 };
@@ -38,3 +38,30 @@ TEST_F(ListTest, Filter) {
   RunLoop();
   EXPECT_EQ(5, filter.As<Filter>()->objects.size());
 }
+
+TEST_F(ListTest, ClonesShareElementsUntilModified) {
+  auto clone = list.object->Clone();
+  auto& cloned_list = dynamic_cast<List&>(*clone);
+  EXPECT_TRUE(cloned_list.objects.Shared());
+  EXPECT_EQ(&*cloned_list.objects, &*list.As<List>()->objects);
+
+  cloned_list.objects.Write().pop_back();
+  EXPECT_FALSE(cloned_list.objects.Shared());
+  EXPECT_EQ(9, cloned_list.objects->size());
+  EXPECT_EQ(10, list.As<List>()->objects->size());
+}
+
+TEST_F(ListTest, OnlyEditsUnshareElements) {
+  auto clone = list.object->Clone();
+  auto& cloned_list = dynamic_cast<List&>(*clone);
+  const Object* read = nullptr;
+  EXPECT_EQ(nullptr, cloned_list.GetAtIndex(3, read));
+  EXPECT_TRUE(cloned_list.objects.Shared());
+
+  Object* edited = nullptr;
+  EXPECT_EQ(nullptr, cloned_list.EditAtIndex(3, edited));
+  EXPECT_FALSE(cloned_list.objects.Shared());
+  EXPECT_NE(read, edited);
+  dynamic_cast<Integer*>(edited)->i = 42;
+  EXPECT_EQ(3, dynamic_cast<const Integer*>(read)->i);
+}
@@ -15,18 +15,24 @@
 #include <include/pathops/SkPathOps.h>
 #include <include/utils/SkShadowUtils.h>
 
+#include <atomic>
 #include <cmath>
 
 #include "animation.hh"
 #include "base.hh"
+#include "bulk_edit.hh"
 #include "color.hh"
 #include "control_flow.hh"
+#include "dataflow.hh"
 #include "drag_action.hh"
+#include "executor.hh"
 #include "font.hh"
 #include "format.hh"
 #include "gui_connection_widget.hh"
 #include "gui_constants.hh"
+#include "journal.hh"
 #include "math.hh"
+#include "offload.hh"
 #include "root.hh"
 #include "span.hh"
 #include "timer_thread.hh"
@@ -39,9 +45,17 @@ using namespace std;
 
 namespace automat {
 
+ShapeCacheStats shape_cache_stats;
+
 constexpr float kFrameCornerRadius = 0.001;
 
-Location::Location(Location* parent) : parent(parent), run_button(this), run_task(this) {}
+static std::atomic<uint64_t> next_incarnation = 1;
+
+Location::Location(Location* parent)
+    : parent(parent),
+      incarnation(next_incarnation.fetch_add(1, std::memory_order_relaxed)),
+      run_button(this),
+      run_task(this) {}
 
 bool Location::HasError() {
   if (error != nullptr) return true;
@@ -54,8 +68,11 @@ bool Location::HasError() {
 Error* Location::GetError() {
   if (error != nullptr) return error.get();
   if (auto machine = ThisAs<Machine>()) {
-    if (!machine->children_with_errors.empty())
-      return (*machine->children_with_errors.begin())->GetError();
+    for (SlotHandle handle : machine->children_with_errors) {
+      if (Location* child = machine->Find(handle)) {
+        return child->GetError();
+      }
+    }
   }
   return nullptr;
 }
@@ -77,23 +94,35 @@ Object* Location::Follow() {
   return object.get();
 }
 
+void Location::InvalidateResolvedArguments() {
+  resolved_arguments.clear();
+  for (auto* connection : incoming) {
+    connection->from.resolved_arguments.clear();
+  }
+}
+
 void Location::Put(unique_ptr<Object> obj) {
+  InvalidateResolvedArguments();
   if (object == nullptr) {
     object = std::move(obj);
-    return;
-  }
-  if (Pointer* ptr = object->AsPointer()) {
+  } else if (Pointer* ptr = object->AsPointer()) {
     ptr->Put(*this, std::move(obj));
   } else {
     object = std::move(obj);
   }
+  InvalidateShape();
 }
 
 unique_ptr<Object> Location::Take() {
+  InvalidateResolvedArguments();
+  unique_ptr<Object> taken;
   if (Pointer* ptr = object->AsPointer()) {
-    return ptr->Take(*this);
+    taken = ptr->Take(*this);
+  } else {
+    taken = std::move(object);
   }
-  return std::move(object);
+  InvalidateShape();
+  return taken;
 }
 
 Connection* Location::ConnectTo(Location& other, Argument& arg,
@@ -105,17 +134,57 @@ Connection* Location::ConnectTo(Location& other, Argument& arg,
       pointer_behavior = Connection::kTerminateHere;
     }
   }
-  Connection* c = new Connection(arg, *this, other, pointer_behavior);
+  Connection* c;
+  {
+    Machine* machine = ParentAs<Machine>();
+    ArenaScope scope(machine ? machine->arena.get() : Arena::current);
+    c = new Connection(arg, *this, other, pointer_behavior);
+  }
+  resolved_arguments.clear();
   outgoing.emplace(c);
   other.incoming.emplace(c);
-  object->ConnectionAdded(*this, *c);
+  if (!bulk_edit::DeferConnectionAdded(*c)) {
+    object->ConnectionAdded(*this, *c);
+  }
+  journal::ConnectionAdded(*c);
   return c;
 }
 
 void Location::ScheduleRun() { run_task.Schedule(); }
 
 void Location::ScheduleLocalUpdate(Location& updated) {
-  (new UpdateTask(this, &updated))->Schedule();
+  // Coalescing only happens for objects that are updated on the Automat thread. Tasks created
+  // within `NextGuard` (or by tasks with successors) carry dependencies so they're always
+  // scheduled.
+  bool can_coalesce = !executor::OnWorkerThread() && global_successors == nullptr &&
+                      ThisAs<ThreadSafe>() == nullptr;
+  if (can_coalesce && bulk_edit::DeferUpdate(*this, updated)) {
+    return;
+  }
+  if (can_coalesce && dataflow::Schedule(*this, updated)) {
+    return;
+  }
+  if (can_coalesce && !pending_updates.empty()) {
+    auto it = std::find_if(pending_updates.begin(), pending_updates.end(),
+                           [&](UpdateTask* task) { return task->updated == &updated; });
+    if (it != pending_updates.end()) {
+      ++coalesced_updates;
+      // The pending task delivers this update as well, so it must be as urgent as this one.
+      UpdateTask& pending = **it;
+      if (Priority lane = queue.LaneFor(pending); lane < pending.lane) {
+        queue.Promote(&pending, pending.lane, lane);
+        pending.lane = lane;
+      }
+      return;
+    }
+  }
+  auto* task = new UpdateTask(this, &updated);
+  task->Schedule();
+  if (can_coalesce && task->scheduled) {
+    task->coalescing = true;
+    task->lane = queue.LaneFor(*task);
+    pending_updates.push_back(task);
+  }
 }
 
 void Location::ScheduleErrored(Location& errored) { (new ErroredTask(this, &errored))->Schedule(); }
@@ -147,12 +216,30 @@ SkPath Location::FieldShape(Object& field) const {
     if (!object_field_shape.isEmpty()) {
       return object_field_shape;
     } else {
-      return object->Shape(nullptr);
+      return ObjectShape();
     }
   }
   return SkPath();
 }
 
+const SkPath& Location::ObjectShape() const {
+  if (object_shape_valid) {
+    ++shape_cache_stats.hits;
+    return object_shape;
+  }
+  ++shape_cache_stats.rebuilds;
+  object_shape = object ? object->Shape(nullptr) : SkPath();
+  object_shape_valid = true;
+  return object_shape;
+}
+
+void Location::InvalidateShape() {
+  object_shape_valid = false;
+  if (auto machine = ParentAs<Machine>()) {
+    machine->UpdateIndex(*this);
+  }
+}
+
 ControlFlow Location::VisitChildren(gui::Visitor& visitor) {
   if (object) {
     Widget* arr[] = {object.get()};
@@ -193,7 +280,7 @@ animation::Phase Location::Draw(gui::DrawContext& ctx) const {
   auto phase = animation::Finished;
   SkPath my_shape;
   if (object) {
-    my_shape = object->Shape(nullptr);
+    my_shape = ObjectShape();
   } else {
     my_shape = Shape(nullptr);
   }
@@ -367,7 +454,7 @@ SkMatrix ObjectAnimationState::GetTransform(Vec2 scale_pivot) const {
 }
 
 SkMatrix Location::GetTransform(animation::Display* display) const {
-  Vec2 scale_pivot = object->Shape(nullptr).getBounds().center();
+  Vec2 scale_pivot = ObjectShape().getBounds().center();
   if (display) {
     if (auto* anim = animation_state.Find(*display)) {
       return anim->GetTransform(scale_pivot);
@@ -397,18 +484,33 @@ ObjectAnimationState& Location::GetAnimationState(animation::Display& display) c
     return new_anim;
   }
 }
+size_t Location::MemoryUsage() const {
+  size_t bytes = sizeof(Location);
+  bytes += outgoing.HeapBytes() + incoming.HeapBytes();
+  bytes += update_observers.HeapBytes() + observing_updates.HeapBytes();
+  bytes += error_observers.HeapBytes() + observing_errors.HeapBytes();
+  bytes += pending_updates.capacity() * sizeof(UpdateTask*);
+  bytes += resolved_arguments.capacity() * sizeof(ResolvedArgument);
+  if (name.capacity() > std::string().capacity()) {  // not stored inline
+    bytes += name.capacity() + 1;
+  }
+  return bytes;
+}
+
 Location::~Location() {
+  journal::LocationDeleted(*this);
   if (long_running) {
     long_running->Cancel();
     long_running = nullptr;
   }
   // Location can only be destroyed by its parent so we don't have to do anything there.
   parent = nullptr;
+  // Deleting from the back doesn't shift the remaining connections.
   while (not incoming.empty()) {
-    delete *incoming.begin();
+    delete incoming.back();
   }
   while (not outgoing.empty()) {
-    delete *outgoing.begin();
+    delete outgoing.back();
   }
   for (auto other : update_observers) {
     other->observing_updates.erase(this);
@@ -422,25 +524,18 @@ Location::~Location() {
   for (auto other : observing_errors) {
     other->error_observers.erase(this);
   }
-  if (no_scheduling.contains(this)) {
+  {
+    std::lock_guard lock(no_scheduling_mutex);
     no_scheduling.erase(this);
   }
   CancelScheduledAt(*this);
-  if (auto waiting_task = events.peek<Task>()) {
-    if (waiting_task->target == this) {
-      events.recv<Task>();  // drops the unique_ptr
-    }
-  }
-  for (int i = queue.size() - 1; i >= 0; --i) {
-    if (queue[i]->target == this) {
-      queue.erase(queue.begin() + i);
-    }
-  }
-  for (int i = global_successors.size() - 1; i >= 0; --i) {
-    if (global_successors[i]->target == this) {
-      global_successors.erase(global_successors.begin() + i);
-    }
-  }
+  offload::Forget(*this);
+  dataflow::Forget(*this);
+  bulk_edit::Forget(*this);
+  // Tasks that were sent to this location but not yet received are dropped when they arrive.
+  AddDeadTarget(incarnation);
+  // Tasks that wait for `run_task` unlink themselves when it's destroyed (see `Task::~Task`).
+  queue.Remove(*this);
 
   if (window) {
     for (int i = 0; i < window->connection_widgets.size(); ++i) {
@@ -498,6 +593,7 @@ void PositionBelow(Location& origin, Location& below) {
   }
   if (origin_index > below_index) {
     std::swap(m->locations[origin_index], m->locations[below_index]);
+    m->index.SwapOrder(origin, below);
   }
 }
 
@@ -505,7 +601,7 @@ void AnimateGrowFrom(Location& source, Location& grown) {
   for (auto* display : animation::displays) {
     auto& animation_state = grown.GetAnimationState(*display);
     animation_state.scale.value = 0.5;
-    Vec2 source_center = source.object->Shape(nullptr).getBounds().center() + source.position;
+    Vec2 source_center = source.ObjectShape().getBounds().center() + source.position;
     animation_state.position.value = source_center;
     animation_state.transparency.value = 1;
   }
@@ -4,13 +4,18 @@
 
 #include <memory>
 #include <string>
-#include <unordered_set>
+#include <typeinfo>
+#include <vector>
 
+#include "adjacency.hh"
 #include "animation.hh"
+#include "arena.hh"
 #include "connection.hh"
 #include "error.hh"
+#include "journal.hh"
 #include "object.hh"
 #include "run_button.hh"
+#include "slot_map.hh"
 #include "tasks.hh"
 #include "text_field.hh"
 #include "time.hh"
@@ -24,6 +29,14 @@ namespace automat {
 
 struct LongRunning;
 
+// Counts the calls to `Location::ObjectShape`.
+struct ShapeCacheStats {
+  uint64_t hits = 0;      // served from the cache
+  uint64_t rebuilds = 0;  // had to call `Object::Shape`
+};
+
+extern ShapeCacheStats shape_cache_stats;
+
 struct ObjectAnimationState {
   animation::SpringV2<float> scale;
   animation::SpringV2<Vec2> position;
@@ -61,6 +74,14 @@ struct Location : gui::Widget {
 
   Location* parent;
 
+  // Handle of this Location in its parent Machine (see `Machine::Find`). Its index is a stable
+  // integer ID of this Location within the Machine. Null if the Location isn't held by a Machine.
+  SlotHandle handle;
+
+  // Unique number of this Location. Unlike its address (which the arena reuses) it's never given to
+  // another Location so the tasks that outlive their target can be recognized. See `Task`.
+  uint64_t incarnation;
+
   std::unique_ptr<Object> object;
 
   // Name of this Location.
@@ -72,23 +93,60 @@ struct Location : gui::Widget {
 
   // Connections of this Location.
   // Connection is owned by both incoming & outgoing locations.
-  std::unordered_multiset<Connection*, ConnectionHasher, ConnectionEqual> outgoing;
-  std::unordered_multiset<Connection*, ConnectionHasher, ConnectionEqual> incoming;
+  AdjacencySet<Connection, ConnectionKey> outgoing;
+  AdjacencySet<Connection, ConnectionKey> incoming;
+
+  AdjacencySet<Location, SelfKey> update_observers;
+  AdjacencySet<Location, SelfKey> observing_updates;
 
-  std::unordered_set<Location*> update_observers;
-  std::unordered_set<Location*> observing_updates;
+  AdjacencySet<Location, SelfKey> error_observers;
+  AdjacencySet<Location, SelfKey> observing_errors;
 
-  std::unordered_set<Location*> error_observers;
-  std::unordered_set<Location*> observing_errors;
+  // UpdateTasks targeting this Location that are waiting in the queue. Used to coalesce redundant
+  // updates - see `ScheduleLocalUpdate`. Empty unless an update is pending.
+  std::vector<UpdateTask*> pending_updates;
+
+  // Targets of the arguments of this Location, cached by `Argument::GetLocation` & `GetObject`.
+  //
+  // Only explicit connections are cached. Objects reached through Pointers are never cached
+  // because pointers may change their targets at any time.
+  struct ResolvedArgument {
+    const Argument* argument;
+    Location* location;
+    bool follow_pointers;
+    Object* object = nullptr;  // null until resolved by `GetObject` (or if it can't be cached)
+    const std::type_info* typed_as = nullptr;  // type of the last `GetTyped` call
+    void* typed = nullptr;
+  };
+  std::vector<ResolvedArgument> resolved_arguments;
 
   time::SteadyPoint last_finished;
 
   RunTask run_task;
   LongRunning* long_running = nullptr;
 
+  // Cache of `ObjectShape`. Reset by `InvalidateShape`, which is also called whenever the object is
+  // replaced.
+  mutable SkPath object_shape;
+  mutable bool object_shape_valid = false;
+
   Location(Location* parent = nullptr);
   ~Location();
 
+  // Locations created by a Machine live in its arena (see `Arena::current`).
+  static void* operator new(size_t size) { return Arena::Alloc(Arena::current, size); }
+  static void* operator new(size_t size, std::align_val_t alignment) {
+    return Arena::Alloc(Arena::current, size, alignment);
+  }
+  static void operator delete(void* ptr) { Arena::Free(ptr); }
+  static void operator delete(void* ptr, std::align_val_t alignment) {
+    Arena::Free(ptr, alignment);
+  }
+
+  // Bytes used by this Location itself, including the heap memory of its edges. Excludes the object
+  // & the animation state.
+  size_t MemoryUsage() const;
+
   std::string_view Name() const override {
     if (name.empty()) {
       return "Location";
@@ -97,21 +155,38 @@ struct Location : gui::Widget {
     }
   }
 
+  ResolvedArgument* FindResolvedArgument(const Argument& argument) {
+    for (auto& resolved : resolved_arguments) {
+      if (resolved.argument == &argument) {
+        return &resolved;
+      }
+    }
+    return nullptr;
+  }
+
+  // Drops the cached arguments of this Location & of the Locations connected to it. Called whenever
+  // the object of this Location is replaced.
+  void InvalidateResolvedArguments();
+
   std::unique_ptr<Object> InsertHere(std::unique_ptr<Object>&& object) {
+    InvalidateResolvedArguments();
     this->object.swap(object);
     this->object->Relocate(this);
+    InvalidateShape();
     return object;
   }
 
   Object* Create(const Object& prototype) {
+    InvalidateResolvedArguments();
     object = prototype.Clone();
     object->Relocate(this);
+    InvalidateShape();
     return object.get();
   }
 
   template <typename T>
   T* Create() {
-    return dynamic_cast<T*>(Create(T::proto));
+    return InterfaceCast<T>(Create(T::proto));
   }
 
   // Remove the objects held by this location.
@@ -119,7 +194,9 @@ struct Location : gui::Widget {
   // Some containers may not allow empty locations so this function may also
   // delete the location. Check the return value.
   Location* Clear() {
+    InvalidateResolvedArguments();
     object.reset();
+    InvalidateShape();
     return this;
   }
 
@@ -150,6 +227,10 @@ struct Location : gui::Widget {
 
   // Schedule this object's Updated function to be executed with the `updated`
   // argument.
+  //
+  // Updates scheduled on the Automat thread are usually delivered in topological waves - see
+  // dataflow.hh. If an identical update is already waiting, no new task is scheduled. The pending
+  // task will observe the latest state of `updated` anyway.
   void ScheduleLocalUpdate(Location& updated);
 
   // Add this object to the task queue. Once it's turn comes, its `Run` method
@@ -227,15 +308,15 @@ struct Location : gui::Widget {
 
   template <typename T>
   T* ThisAs() {
-    return dynamic_cast<T*>(object.get());
+    return InterfaceCast<T>(object.get());
   }
   template <typename T>
   T* As() {
-    return dynamic_cast<T*>(Follow());
+    return InterfaceCast<T>(Follow());
   }
   template <typename T>
   T* ParentAs() const {
-    return parent ? dynamic_cast<T*>(parent->object.get()) : nullptr;
+    return parent ? InterfaceCast<T>(parent->object.get()) : nullptr;
   }
 
   void SetText(std::string_view text) {
@@ -244,6 +325,7 @@ struct Location : gui::Widget {
       return;
     }
     Follow()->SetText(*this, text);
+    journal::ObjectChanged(*this);
     ScheduleUpdate();
   }
   void SetNumber(double number);
@@ -258,6 +340,16 @@ struct Location : gui::Widget {
   SkPath Shape(animation::Display*) const override;
   SkPath FieldShape(Object&) const;
 
+  // Returns `object->Shape(nullptr)` (or an empty path if there is no object).
+  //
+  // The path is cached until the object is replaced or `InvalidateShape` is called. Objects whose
+  // shape depends on their state should call `InvalidateShape` when that state changes.
+  // LiveObjects do this automatically in `InvalidateDrawCache`.
+  const SkPath& ObjectShape() const;
+
+  // Drop the cached shape & refresh the bounds in the parent Machine's spatial index.
+  void InvalidateShape();
+
   // Call this when the position of this location changes to update the autoconnect arguments.
   void UpdateAutoconnectArgs();
 
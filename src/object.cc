@@ -93,7 +93,7 @@ std::unique_ptr<Action> Object::FindAction(gui::Pointer& p, gui::ActionTrigger b
 }
 
 void Object::Updated(Location& here, Location& updated) {
-  if (Runnable* runnable = dynamic_cast<Runnable*>(this)) {
+  if (Runnable* runnable = InterfaceCast<Runnable>(this)) {
     runnable->Run(here);
   }
 }
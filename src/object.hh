@@ -5,8 +5,10 @@
 #include <string>
 #include <string_view>
 
+#include "arena.hh"
 #include "audio.hh"
 #include "deserializer.hh"
+#include "interfaces.hh"
 #include "math.hh"
 #include "widget.hh"
 
@@ -21,6 +23,9 @@ struct Argument;
 //
 // Instances of this class provide custom logic & appearance.
 struct Object : gui::Widget {
+  // Table of the interfaces of this object's type - see `InterfaceCast`.
+  mutable InterfaceTableRef interfaces;
+
   // Create a copy of this object.
   //
   // Subclasses of Object should have a static `proto` field, holding their own
@@ -36,6 +41,16 @@ struct Object : gui::Widget {
   // Release the memory occupied by this object.
   virtual ~Object() = default;
 
+  // Objects created by a Machine live in its arena (see `Arena::current`).
+  static void* operator new(size_t size) { return Arena::Alloc(Arena::current, size); }
+  static void* operator new(size_t size, std::align_val_t alignment) {
+    return Arena::Alloc(Arena::current, size, alignment);
+  }
+  static void operator delete(void* ptr) { Arena::Free(ptr); }
+  static void operator delete(void* ptr, std::align_val_t alignment) {
+    Arena::Free(ptr, alignment);
+  }
+
   virtual void SerializeState(Serializer& writer, const char* key = "value") const;
 
   // Restores state when Automat is restarted.
@@ -77,4 +92,45 @@ std::unique_ptr<Object> Create() {
   return T::proto.Clone();
 }
 
+// Equivalent to `dynamic_cast<T*>(object)`, but only the first cast to `T` of every type of object
+// walks the class hierarchy. The following ones are constant-time lookups in its InterfaceTable.
+template <typename T>
+T* InterfaceCast(Object* object) {
+  if (object == nullptr) {
+    return nullptr;
+  }
+  int id = InterfaceId<T>();
+  if (id >= InterfaceTable::kMaxInterfaces) {
+    return dynamic_cast<T*>(object);
+  }
+  const std::type_info& type = typeid(*object);
+  const InterfaceTable* table = object->interfaces.table.load(std::memory_order_acquire);
+  if (table == nullptr || *table->type != type) {
+    table = &InterfaceTable::For(type);
+    object->interfaces.table.store(table, std::memory_order_release);
+  }
+  int32_t offset = table->offsets[id].load(std::memory_order_relaxed);
+  if (offset == InterfaceTable::kUnknown) {
+    T* result = dynamic_cast<T*>(object);
+    offset = result ? (int32_t)((char*)result - (char*)object) : InterfaceTable::kAbsent;
+    table->offsets[id].store(offset, std::memory_order_relaxed);
+    return result;
+  }
+  if (offset == InterfaceTable::kAbsent) {
+    return nullptr;
+  }
+  return static_cast<T*>(static_cast<void*>((char*)object + offset));
+}
+
+template <typename T>
+const T* InterfaceCast(const Object* object) {
+  return InterfaceCast<T>(const_cast<Object*>(object));
+}
+
+// Fill the slots of the given interfaces in the table of the object's type.
+template <typename... Interfaces>
+void PrepareInterfaces(const Object& object) {
+  (InterfaceCast<Interfaces>(&object), ...);
+}
+
 }  // namespace automat
\ No newline at end of file
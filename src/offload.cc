@@ -0,0 +1,149 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "offload.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base.hh"
+#include "format.hh"
+#include "tasks.hh"
+#include "thread_name.hh"
+#include "time.hh"
+
+namespace automat::offload {
+
+using Clock = time::SteadyClock;
+
+struct Job {
+  Location* target;  // cleared by `Forget` when the work is already running
+  std::function<void()> work;
+  std::function<void(Location&)> done;
+  Clock::time_point submitted;
+};
+
+static std::mutex mutex;
+static std::condition_variable cv;
+static std::deque<Job*> pending;   // protected by mutex
+static std::vector<Job*> running;  // protected by mutex
+static std::vector<std::thread> threads;  // protected by mutex
+static int idle_threads = 0;  // protected by mutex
+static bool stop = false;     // protected by mutex
+static Stats stats;           // protected by mutex
+
+// Number of submitted jobs that haven't finished yet. Allows `Forget` to skip locking in the common
+// case.
+static std::atomic<int> jobs = 0;
+
+static double Micros(Clock::duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+static void ThreadMain(int index) {
+  SetThreadName(maf::f("Automat Offload %d", index));
+  std::unique_lock lock(mutex);
+  while (true) {
+    ++idle_threads;
+    cv.wait(lock, [] { return stop || !pending.empty(); });
+    --idle_threads;
+    if (pending.empty()) {
+      return;  // stopping
+    }
+    Job* job = pending.front();
+    pending.pop_front();
+    running.push_back(job);
+    auto start = Clock::now();
+    stats.queue_wait.Add(Micros(start - job->submitted));
+    lock.unlock();
+    job->work();
+    auto end = Clock::now();
+    lock.lock();
+    stats.run_time.Add(Micros(end - start));
+    std::erase(running, job);
+    // Sending while holding the lock guarantees that nothing is sent after `Forget` returns.
+    if (job->target) {
+      events.send(std::make_unique<FunctionTask>(job->target, std::move(job->done)));
+      ++stats.completed;
+    } else {
+      ++stats.dropped;
+    }
+    delete job;
+    jobs.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+bool TrySubmit(Location& here, std::function<void()> work, std::function<void(Location&)> done) {
+  std::lock_guard lock(mutex);
+  if (pending.size() + running.size() >= kCapacity) {
+    ++stats.rejected;
+    return false;
+  }
+  pending.push_back(new Job{&here, std::move(work), std::move(done), Clock::now()});
+  jobs.fetch_add(1, std::memory_order_relaxed);
+  ++stats.submitted;
+  if (idle_threads < (int)pending.size() && threads.size() < kThreads) {
+    threads.emplace_back(ThreadMain, (int)threads.size());
+  }
+  cv.notify_one();
+  return true;
+}
+
+void Forget(Location& target) {
+  if (jobs.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  std::lock_guard lock(mutex);
+  std::erase_if(pending, [&](Job* job) {
+    if (job->target != &target) {
+      return false;
+    }
+    delete job;
+    jobs.fetch_sub(1, std::memory_order_relaxed);
+    ++stats.dropped;
+    return true;
+  });
+  for (Job* job : running) {
+    if (job->target == &target) {
+      job->target = nullptr;
+    }
+  }
+}
+
+void Stop() {
+  std::vector<std::thread> stopping;
+  {
+    std::lock_guard lock(mutex);
+    stop = true;
+    for (Job* job : pending) {
+      delete job;
+      jobs.fetch_sub(1, std::memory_order_relaxed);
+      ++stats.dropped;
+    }
+    pending.clear();
+    stopping.swap(threads);
+  }
+  cv.notify_all();
+  for (auto& thread : stopping) {
+    thread.join();
+  }
+  std::lock_guard lock(mutex);
+  stop = false;
+}
+
+// Pool threads must be joined before the state above is destroyed.
+static struct StopAtExit {
+  ~StopAtExit() { Stop(); }
+} stop_at_exit;
+
+Stats GetStats() {
+  std::lock_guard lock(mutex);
+  return stats;
+}
+
+}  // namespace automat::offload
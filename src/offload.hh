@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "latency_histogram.hh"
+
+namespace automat {
+
+struct Location;
+
+// Pool of threads for blocking work - file I/O, waiting for subprocesses, sleeping, etc.
+//
+// Objects hand over a `work` closure, which runs on one of the pool threads, and a `done` closure,
+// which is sent back to the Automat thread as a task (through `events`) once the work finishes.
+// Long-running objects usually call `LongRunning::Done` from there.
+//
+// The pool is bounded. At most kThreads closures run at the same time & at most kCapacity closures
+// may be submitted (queued or running). Beyond that `TrySubmit` refuses new work so that the
+// callers can back off instead of piling up an unbounded backlog.
+//
+// The `work` closure runs concurrently with the Automat thread so it shouldn't touch the objects
+// directly. It should capture copies of its inputs and store its results in state shared with the
+// `done` closure.
+namespace offload {
+
+constexpr int kThreads = 4;
+constexpr int kCapacity = 64;
+
+// Returns false without running anything if the pool is saturated. Threads are started on demand.
+bool TrySubmit(Location& here, std::function<void()> work, std::function<void(Location&)> done);
+
+// Drops the pending work of the given Location & makes sure that the completions of its running
+// work are never delivered. Called when the Location is destroyed.
+void Forget(Location&);
+
+// Drops the pending work & waits for the running work to finish. The pool may be used again
+// afterwards.
+void Stop();
+
+struct Stats {
+  uint64_t submitted = 0;
+  uint64_t rejected = 0;   // refused by `TrySubmit` because the pool was saturated
+  uint64_t completed = 0;  // completions sent back to the Automat thread
+  uint64_t dropped = 0;    // work (or its completion) dropped by `Forget` or `Stop`
+  LatencyHistogram queue_wait;  // time between `TrySubmit` & the start of the work
+  LatencyHistogram run_time;    // time spent in the `work` closure
+};
+
+Stats GetStats();
+
+}  // namespace offload
+
+}  // namespace automat
@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "offload.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+struct OffloadTest : TestBase {
+  Location& location = machine.Create<Text>("text");
+  std::atomic<bool> released = false;
+
+  ~OffloadTest() { offload::Stop(); }
+
+  void Blocker() {
+    while (!released.load()) {
+      std::this_thread::yield();
+    }
+  }
+};
+
+TEST_F(OffloadTest, CompletionArrivesThroughEvents) {
+  auto result = std::make_shared<int>(0);
+  std::thread::id work_thread;
+  int done_result = 0;
+  ASSERT_TRUE(offload::TrySubmit(
+      location,
+      [result, &work_thread] {
+        *result = 42;
+        work_thread = std::this_thread::get_id();
+      },
+      [result, &done_result](Location&) { done_result = *result; }));
+  auto completion = events.recv<Task>();
+  EXPECT_EQ(&location, completion->target);
+  completion->Execute();
+  EXPECT_EQ(42, done_result);
+  EXPECT_NE(std::this_thread::get_id(), work_thread);
+  auto stats = offload::GetStats();
+  EXPECT_GE(stats.completed, 1);
+  EXPECT_GE(stats.run_time.count, 1);
+}
+
+TEST_F(OffloadTest, RejectsWorkWhenSaturated) {
+  auto rejected_before = offload::GetStats().rejected;
+  for (int i = 0; i < offload::kCapacity; ++i) {
+    ASSERT_TRUE(offload::TrySubmit(location, [this] { Blocker(); }, [](Location&) {}));
+  }
+  EXPECT_FALSE(offload::TrySubmit(location, [] {}, [](Location&) {}));
+  EXPECT_EQ(rejected_before + 1, offload::GetStats().rejected);
+  released = true;
+  for (int i = 0; i < offload::kCapacity; ++i) {
+    events.recv<Task>();
+  }
+  EXPECT_TRUE(offload::TrySubmit(location, [] {}, [](Location&) {}));
+  events.recv<Task>();
+}
+
+TEST_F(OffloadTest, ForgetDropsCompletions) {
+  auto dropped_before = offload::GetStats().dropped;
+  for (int i = 0; i < offload::kThreads + 2; ++i) {
+    ASSERT_TRUE(offload::TrySubmit(location, [this] { Blocker(); }, [](Location&) {}));
+  }
+  offload::Forget(location);
+  released = true;
+  offload::Stop();
+  EXPECT_EQ(0, events.size());
+  EXPECT_EQ(dropped_before + offload::kThreads + 2, offload::GetStats().dropped);
+}
@@ -5,7 +5,12 @@
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/rapidjson.h>
 
+#include <filesystem>
+
+#include "journal.hh"
+#include "log.hh"
 #include "root.hh"
+#include "snapshot.hh"
 #include "status.hh"
 #include "virtual_fs.hh"
 #include "window.hh"
@@ -16,11 +21,16 @@ namespace automat {
 
 Path StatePath() { return Path::ExecutablePath().Parent() / "automat_state.json"; }
 
+Path SnapshotPath() { return Path::ExecutablePath().Parent() / "automat_state.snapshot"; }
+
+Path JournalPath() { return Path::ExecutablePath().Parent() / "automat_state.journal"; }
+
 void SaveState(gui::Window& window, Status& status) {
+  journal::Stop();
   // Write window_state to a temp file
   auto state_path = StatePath();
   rapidjson::StringBuffer sb;
-  rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(sb);
+  Serializer writer(sb);
   writer.SetMaxDecimalPlaces(6);
   writer.StartObject();
   writer.Key("version");
@@ -33,18 +43,15 @@ void SaveState(gui::Window& window, Status& status) {
   writer.Flush();
   std::string window_state = sb.GetString();
   fs::real.Write(state_path, window_state, status);
+  // Written after the JSON so that it's loaded next time.
+  fs::real.Write(SnapshotPath(), snapshot::Save(*root_machine, &window), status);
+  // The journal is only needed to recover from a crash.
+  if (OK(status)) {
+    JournalPath().Unlink(status, true);
+  }
 }
 
-void LoadState(gui::Window& window, Status& status) {
-  auto state_path = StatePath();
-  auto contents = fs::real.Read(state_path, status);
-  if (!OK(status)) {
-    status.Reset();
-    contents = fs::embedded.Read(Path("assets") / "automat_state.json", status);
-    if (!OK(status)) {
-      return;
-    }
-  }
+static void LoadStateFromString(gui::Window& window, Str& contents, Status& status) {
   rapidjson::InsituStringStream stream(const_cast<char*>(contents.c_str()));
   Deserializer d(stream);
 
@@ -67,4 +74,60 @@ void LoadState(gui::Window& window, Status& status) {
     AppendErrorMessage(status) += "Extra data at the end of the JSON string, " + d.ErrorContext();
   }
 }
+
+// True if the file exists & is at least as recent as the JSON state.
+static bool IsFresh(const Path& path) {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(path.str, ec);
+  if (ec) {
+    return false;
+  }
+  auto json_time = std::filesystem::last_write_time(StatePath().str, ec);
+  return ec || time >= json_time;
+}
+
+void LoadState(gui::Window& window, Status& status) {
+  // The journal only exists if Automat crashed. Otherwise it's removed by `SaveState`.
+  for (const Path& path : {JournalPath(), SnapshotPath()}) {
+    if (!IsFresh(path)) {
+      continue;
+    }
+    LoadState(window, path, status);
+    // Snapshots (including the one at the start of a journal) are validated before anything is
+    // loaded. When they're rejected the Machine is still empty, so it's safe to fall back to JSON
+    // (for example when they were written by a different version). Damaged journal records are
+    // skipped without failing the load.
+    if (OK(status) || !root_machine->locations.empty()) {
+      return;
+    }
+    ERROR << "Couldn't load " << path.str << ": " << status;
+    status.Reset();
+  }
+  auto state_path = StatePath();
+  auto contents = fs::real.Read(state_path, status);
+  if (!OK(status)) {
+    status.Reset();
+    contents = fs::embedded.Read(Path("assets") / "automat_state.json", status);
+    if (!OK(status)) {
+      return;
+    }
+  }
+  LoadStateFromString(window, contents, status);
+}
+
+void LoadState(gui::Window& window, const Path& path, Status& status) {
+  fs::real.Map(
+      path,
+      [&](StrView data) {
+        if (snapshot::IsSnapshot(data)) {
+          snapshot::Load(data, root_location, &window, status);
+        } else if (journal::IsJournal(data)) {
+          journal::Load(data, root_location, status);  // journals don't include the window
+        } else {
+          Str contents(data);  // JSON is parsed in-situ
+          LoadStateFromString(window, contents, status);
+        }
+      },
+      status);
+}
 }  // namespace automat
\ No newline at end of file
@@ -13,7 +13,19 @@ struct Window;
 
 maf::Path StatePath();
 
+// Binary snapshot of the state (see snapshot.hh), saved next to the JSON. It's loaded instead of
+// the JSON as long as it's at least as recent, so hand-edited JSON still takes precedence.
+maf::Path SnapshotPath();
+
+// Autosave journal (see journal.hh). It's removed by `SaveState` so it only remains after a crash,
+// in which case it's loaded instead of the snapshot & JSON.
+maf::Path JournalPath();
+
 void SaveState(gui::Window&, maf::Status&);
 void LoadState(gui::Window&, maf::Status&);
 
+// Loads the state from the given file (JSON, snapshot or journal). Unlike the overload above,
+// doesn't fall back to the default state when the file can't be read.
+void LoadState(gui::Window&, const maf::Path&, maf::Status&);
+
 }  // namespace automat
\ No newline at end of file
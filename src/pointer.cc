@@ -70,7 +70,14 @@ void Pointer::UpdatePath() {
         transformed = point;
       }
 
-      auto shape = w->Shape(&display);
+      SkPath shape;
+      auto* location = path.empty() ? nullptr : dynamic_cast<Location*>(path.back());
+      if (location && location->object.get() == w && location->ParentAs<Machine>()) {
+        // Objects on the canvas don't depend on the display so they can use the cached shape.
+        shape = location->ObjectShape();
+      } else {
+        shape = w->Shape(&display);
+      }
       path.push_back(w);
       std::swap(point, transformed);
       if (shape.contains(point.x, point.y)) {
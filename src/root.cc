@@ -5,7 +5,12 @@
 #include <atomic>
 #include <thread>
 
+#include "executor.hh"
+#include "journal.hh"
+#include "keyboard.hh"
+#include "persistence.hh"
 #include "prototypes.hh"
+#include "window.hh"
 
 namespace automat {
 
@@ -22,6 +27,10 @@ void InitRoot() {
   auto& prototypes = Prototypes();
   sort(prototypes.begin(), prototypes.end(),
        [](const auto* a, const auto* b) { return a->Name() < b->Name(); });
+  // Prototypes can't be inspected when they're registered because they may not be constructed yet.
+  for (auto* prototype : prototypes) {
+    PrepareInterfaces<LiveObject, Runnable, LongRunning, Pointer, ThreadSafe>(*prototype);
+  }
 }
 
 void StopRoot() {
@@ -31,6 +40,27 @@ void StopRoot() {
   }
 }
 
+void InitAutomat(maf::Status& status) {
+  InitRoot();
+  gui::window.reset(new gui::Window());
+  gui::window->RequestResize = [&](Vec2 new_size) { gui::window->Resize(new_size); };
+  gui::window->RequestMaximize = [&](bool horizontally, bool vertically) {
+    gui::window->maximized_horizontally = horizontally;
+    gui::window->maximized_vertically = vertically;
+  };
+  gui::keyboard = std::make_unique<gui::Keyboard>(*gui::window);
+  LoadState(*gui::window, status);
+  RunOnAutomatThread([&] {
+    // Besides starting the autosave, this makes sure that memory allocated in main thread is
+    // synchronized to automat thread.
+    journal::Start(JournalPath(), root_location);
+  });
+}
+
+#if !defined(_WIN32)  // Windows has to stop its rendering & close the window (see win_main.cc)
+void StopAutomat(maf::Status&) { automat_thread.request_stop(); }
+#endif
+
 void AssertAutomatThread() {
   if (automat_thread.get_stop_source().stop_requested()) {
     assert(automat_thread_finished);
@@ -51,7 +81,9 @@ void RunOnAutomatThread(std::function<void()> f) {
     f();
     return;
   }
-  events.send(std::make_unique<FunctionTask>(&root_location, [f](Location& l) { f(); }));
+  auto task = std::make_unique<FunctionTask>(&root_location, [f](Location& l) { f(); });
+  task->priority = Priority::Input;
+  events.send(std::move(task));
 }
 
 void RunOnAutomatThreadSynchronous(std::function<void()> f) {
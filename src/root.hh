@@ -5,6 +5,7 @@
 #include <thread>
 
 #include "base.hh"
+#include "status.hh"
 
 namespace automat {
 
@@ -19,6 +20,12 @@ void InitRoot();
 // Stops the Automat main loop
 void StopRoot();
 
+// Starts the Automat main loop, sets up gui::window, gui::keyboard, and loads the state from JSON.
+void InitAutomat(maf::Status&);
+
+// Requests the Automat main loop to stop. The platform main loop is expected to exit afterwards.
+void StopAutomat(maf::Status&);
+
 void RunOnAutomatThread(std::function<void()>);
 void RunOnAutomatThreadSynchronous(std::function<void()>);
 void AssertAutomatThread();
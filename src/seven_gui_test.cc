@@ -69,8 +69,8 @@ void ExpectAlerts(Alert& a, std::vector<std::string> alerts) {
 }
 
 void ClearErrors(Machine& m) {
-  for (auto c : m.children_with_errors) {
-    c->ClearError();
+  for (auto handle : m.children_with_errors) {
+    m.Find(handle)->ClearError();
   }
 }
 
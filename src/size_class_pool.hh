@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+
+namespace automat {
+
+// Free lists of memory blocks, one for each size class.
+//
+// Sizes are rounded up to a multiple of `kGranularity`. Released blocks are kept on intrusive free
+// lists & handed out again by the next allocation from the same size class. The pool doesn't own
+// any memory - its users decide where the new blocks come from & what happens to the blocks that
+// they don't want to keep. See task_pool.hh for the per-thread pools of tasks & coroutine frames and
+// arena.hh for the pools of Machines.
+//
+// Not thread-safe.
+template <size_t kGranularity, size_t kSizeClasses>
+struct SizeClassPool {
+  static constexpr size_t kMaxBlockSize = kGranularity * kSizeClasses;
+
+  // Sizes that are larger than `kMaxBlockSize` (or zero) map to `kSizeClasses` or more.
+  static constexpr size_t SizeClass(size_t size) {
+    return (size + kGranularity - 1) / kGranularity - 1;
+  }
+  static constexpr size_t BlockSize(size_t size_class) { return (size_class + 1) * kGranularity; }
+
+  // Returns nullptr if there are no free blocks in the given size class.
+  void* Pop(size_t size_class) {
+    FreeBlock* block = free_lists[size_class];
+    if (block) {
+      free_lists[size_class] = block->next;
+      --free_counts[size_class];
+    }
+    return block;
+  }
+
+  // The block must be at least `BlockSize(size_class)` bytes large. Its contents are overwritten.
+  void Push(void* ptr, size_t size_class) {
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = free_lists[size_class];
+    free_lists[size_class] = block;
+    ++free_counts[size_class];
+  }
+
+  int FreeCount(size_t size_class) const { return free_counts[size_class]; }
+
+  // Empties the free lists, passing every block to `release`.
+  template <typename F>
+  void Drain(F&& release) {
+    for (size_t i = 0; i < kSizeClasses; ++i) {
+      while (void* block = Pop(i)) {
+        release(block);
+      }
+    }
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+  FreeBlock* free_lists[kSizeClasses] = {};
+  int free_counts[kSizeClasses] = {};
+};
+
+}  // namespace automat
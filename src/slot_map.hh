@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace automat {
+
+// Reference to a value held in a SlotMap.
+//
+// Handles are small & trivially copyable. A handle becomes stale when its value is removed from
+// the map. Lookups of stale handles fail - even if the slot has been reused since then.
+struct SlotHandle {
+  uint32_t index = 0;
+  uint32_t generation = 0;  // odd for values that were alive when the handle was created
+
+  // False for default-constructed handles.
+  explicit operator bool() const { return generation != 0; }
+  bool operator==(const SlotHandle&) const = default;
+};
+
+// Array of values addressed by generation-checked handles.
+//
+// Insertion, removal & lookup are O(1). Slots of removed values are reused (most recently freed
+// first) so the indices stay dense & can be used as compact integer IDs.
+//
+// Each slot has a generation counter which is odd while the slot is occupied & is incremented on
+// every insertion & removal. A handle is valid as long as its generation matches its slot.
+template <typename T>
+struct SlotMap {
+  SlotHandle Insert(T value) {
+    uint32_t index;
+    if (free_head != kNone) {
+      index = free_head;
+      free_head = slots[index].next_free;
+    } else {
+      index = slots.size();
+      slots.emplace_back();
+    }
+    Slot& slot = slots[index];
+    slot.value = std::move(value);
+    ++slot.generation;
+    ++count;
+    return {index, slot.generation};
+  }
+
+  // Returns false if the handle was already stale.
+  bool Remove(SlotHandle handle) {
+    if (!Contains(handle)) {
+      return false;
+    }
+    Slot& slot = slots[handle.index];
+    slot.value = T();
+    ++slot.generation;
+    slot.next_free = free_head;
+    free_head = handle.index;
+    --count;
+    return true;
+  }
+
+  // Removes all values. Handles of the removed values become stale, just like with `Remove`.
+  void Clear() {
+    for (uint32_t i = 0; i < slots.size(); ++i) {
+      if (slots[i].generation & 1) {
+        Remove({i, slots[i].generation});
+      }
+    }
+  }
+
+  bool Contains(SlotHandle handle) const {
+    return (handle.generation & 1) && handle.index < slots.size() &&
+           slots[handle.index].generation == handle.generation;
+  }
+
+  // Returns nullptr if the handle is stale.
+  T* Get(SlotHandle handle) { return Contains(handle) ? &slots[handle.index].value : nullptr; }
+  const T* Get(SlotHandle handle) const {
+    return Contains(handle) ? &slots[handle.index].value : nullptr;
+  }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  // Upper bound of the slot indices. Can be used to size arrays indexed by `SlotHandle::index`.
+  size_t Capacity() const { return slots.size(); }
+
+ private:
+  static constexpr uint32_t kNone = UINT32_MAX;
+
+  struct Slot {
+    T value = T();
+    uint32_t generation = 0;
+    uint32_t next_free = kNone;
+  };
+
+  std::vector<Slot> slots;
+  uint32_t free_head = kNone;
+  size_t count = 0;
+};
+
+}  // namespace automat
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "slot_map.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+TEST(SlotMapTest, InsertGetRemove) {
+  SlotMap<std::string> map;
+  SlotHandle a = map.Insert("a");
+  SlotHandle b = map.Insert("b");
+  EXPECT_TRUE(a);
+  EXPECT_FALSE(SlotHandle());
+  EXPECT_EQ(*map.Get(a), "a");
+  EXPECT_EQ(*map.Get(b), "b");
+  EXPECT_EQ(map.size(), 2);
+
+  EXPECT_TRUE(map.Remove(a));
+  EXPECT_FALSE(map.Remove(a));
+  EXPECT_EQ(map.Get(a), nullptr);
+  EXPECT_EQ(map.Get(SlotHandle()), nullptr);
+  EXPECT_EQ(map.size(), 1);
+}
+
+TEST(SlotMapTest, ReusedSlotsDetectStaleHandles) {
+  SlotMap<int> map;
+  SlotHandle first = map.Insert(1);
+  map.Remove(first);
+  SlotHandle second = map.Insert(2);
+  EXPECT_EQ(second.index, first.index);  // the slot is reused...
+  EXPECT_FALSE(map.Contains(first));     // ...but the old handle stays stale
+  EXPECT_EQ(*map.Get(second), 2);
+  EXPECT_EQ(map.Capacity(), 1);
+
+  map.Clear();
+  SlotHandle third = map.Insert(3);
+  EXPECT_EQ(map.Get(second), nullptr);
+  EXPECT_EQ(*map.Get(third), 3);
+}
+
+struct MachineHandlesTest : TestBase {};
+
+TEST_F(MachineHandlesTest, ExtractedLocationsBecomeStale) {
+  Location& a = machine.Create<Text>();
+  Location& b = machine.Create<Text>();
+  SlotHandle handle = a.handle;
+  EXPECT_EQ(machine.Find(handle), &a);
+  EXPECT_EQ(machine.Find(b.handle), &b);
+
+  auto extracted = machine.Extract(a);
+  EXPECT_EQ(machine.Find(handle), nullptr);
+  EXPECT_FALSE(extracted->handle);
+
+  Location& c = machine.Create<Text>();
+  EXPECT_EQ(c.handle.index, handle.index);  // IDs stay dense
+  EXPECT_EQ(machine.Find(handle), nullptr);
+}
@@ -0,0 +1,411 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "snapshot.hh"
+
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+#include "base.hh"
+#include "bulk_edit.hh"
+#include "format.hh"
+#include "prototypes.hh"
+#include "window.hh"
+
+using namespace maf;
+
+namespace automat::snapshot {
+
+namespace {
+
+constexpr char kMagic[8] = {'A', 'U', 'T', 'O', 'S', 'N', 'A', 'P'};
+
+enum SectionKind : uint32_t {
+  kStrings = 1,
+  kMachine = 2,
+  kLocations = 3,
+  kConnections = 4,
+  kSampleRuns = 5,
+  kSamples = 6,
+  kWindow = 7,
+  kSectionKinds,
+};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t section_count;
+};
+
+struct Section {
+  uint32_t kind;
+  uint32_t count;  // number of records
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Range of the Strings section.
+struct StrRef {
+  uint32_t offset = 0;
+  uint32_t size = 0;
+};
+
+struct MachineRecord {
+  StrRef name;
+};
+
+struct LocationRecord {
+  StrRef name;
+  StrRef type;   // empty for Locations without objects
+  StrRef value;  // JSON object with a single "value" key, empty if the object has no state
+  float x, y;
+};
+
+struct ConnectionRecord {
+  uint32_t from;
+  uint32_t to;
+  StrRef label;
+};
+
+// Range of the Samples section.
+struct SampleRun {
+  uint64_t offset;
+  uint64_t count;
+};
+
+static_assert(sizeof(Header) == 16 && sizeof(Section) == 24 && sizeof(LocationRecord) == 32 &&
+              sizeof(ConnectionRecord) == 16 && sizeof(SampleRun) == 16);
+
+struct Writer : SampleSink {
+  Str strings;
+  std::unordered_map<Str, StrRef> interned;
+  Vec<MachineRecord> machine;
+  Vec<LocationRecord> locations;
+  Vec<ConnectionRecord> connections;
+  Vec<SampleRun> sample_runs;
+  Vec<double> samples;
+  Str window;
+
+  StrRef Add(StrView str) {
+    StrRef ref = {(uint32_t)strings.size(), (uint32_t)str.size()};
+    strings.append(str);
+    return ref;
+  }
+
+  // For short strings that repeat a lot (names, types & labels).
+  StrRef Intern(StrView str) {
+    auto [it, inserted] = interned.try_emplace(Str(str));
+    if (inserted) {
+      it->second = Add(str);
+    }
+    return it->second;
+  }
+
+  int Store(std::span<const double> run) override {
+    sample_runs.push_back({samples.size(), run.size()});
+    samples.insert(samples.end(), run.begin(), run.end());
+    return sample_runs.size() - 1;
+  }
+};
+
+struct Reader : SampleSource {
+  StrView data;
+  StrView sections[kSectionKinds] = {};
+  uint32_t counts[kSectionKinds] = {};
+
+  template <typename T>
+  std::span<const T> Records(SectionKind kind) const {
+    return {reinterpret_cast<const T*>(sections[kind].data()), counts[kind]};
+  }
+
+  bool Valid(StrRef ref) const {
+    return (uint64_t)ref.offset + ref.size <= sections[kStrings].size();
+  }
+
+  // The reference must be `Valid`.
+  StrView Get(StrRef ref) const { return sections[kStrings].substr(ref.offset, ref.size); }
+
+  std::span<const double> Load(int index, Status& status) override {
+    auto runs = Records<SampleRun>(kSampleRuns);
+    auto samples = Records<double>(kSamples);
+    if (index < 0 || index >= (int)runs.size()) {  // the runs themselves were validated by `Load`
+      AppendErrorMessage(status) += f("Invalid sample run: %d", index);
+      return {};
+    }
+    return samples.subspan(runs[index].offset, runs[index].count);
+  }
+
+  // Checks the references of all records (strings, Locations & samples), so that loading never
+  // stops half-way.
+  void Validate(Status& status) const {
+    auto Invalid = [&](const char* what, size_t i) {
+      AppendErrorMessage(status) += f("Invalid %s record %zu", what, i);
+    };
+    auto machine = Records<MachineRecord>(kMachine);
+    for (size_t i = 0; i < machine.size(); ++i) {
+      if (!Valid(machine[i].name)) {
+        return Invalid("Machine", i);
+      }
+    }
+    auto locations = Records<LocationRecord>(kLocations);
+    for (size_t i = 0; i < locations.size(); ++i) {
+      auto& record = locations[i];
+      if (!Valid(record.name) || !Valid(record.type) || !Valid(record.value)) {
+        return Invalid("Location", i);
+      }
+    }
+    auto connections = Records<ConnectionRecord>(kConnections);
+    for (size_t i = 0; i < connections.size(); ++i) {
+      auto& record = connections[i];
+      if (record.from >= locations.size() || record.to >= locations.size() ||
+          !Valid(record.label)) {
+        return Invalid("Connection", i);
+      }
+    }
+    auto runs = Records<SampleRun>(kSampleRuns);
+    uint64_t samples = counts[kSamples];
+    for (size_t i = 0; i < runs.size(); ++i) {
+      if (runs[i].offset > samples || runs[i].count > samples - runs[i].offset) {
+        return Invalid("SampleRun", i);
+      }
+    }
+  }
+};
+
+size_t RecordSize(uint32_t kind) {
+  switch (kind) {
+    case kMachine:
+      return sizeof(MachineRecord);
+    case kLocations:
+      return sizeof(LocationRecord);
+    case kConnections:
+      return sizeof(ConnectionRecord);
+    case kSampleRuns:
+      return sizeof(SampleRun);
+    case kSamples:
+      return sizeof(double);
+    default:  // kStrings & kWindow
+      return 1;
+  }
+}
+
+// Parses a JSON fragment. Fragments are copied because the Deserializer parses in-situ.
+template <typename Callback>
+void ParseJson(StrView json, SampleSource* samples, Callback&& callback) {
+  Str buffer(json);
+  rapidjson::InsituStringStream stream(buffer.data());
+  Deserializer d(stream);
+  d.samples = samples;
+  callback(d);
+}
+
+}  // namespace
+
+Str Save(const Machine& machine, const gui::Window* window) {
+  Writer w;
+
+  w.machine.push_back({w.Intern(machine.name)});
+  Vec<uint32_t> location_ids(machine.location_slots.Capacity());
+  for (auto& location : machine.locations) {
+    location_ids[location->handle.index] = w.locations.size();
+    auto& record = w.locations.emplace_back();
+    record.name = w.Intern(location->name);
+    record.x = location->position.x;
+    record.y = location->position.y;
+    if (location->object) {
+      record.type = w.Intern(location->object->Name());
+      if (Str value = SerializeValue(*location->object, &w); !value.empty()) {
+        record.value = w.Add(value);
+      }
+    }
+  }
+  for (auto& location : machine.locations) {
+    for (auto* conn : location->outgoing) {
+      if (machine.Find(conn->to.handle) != &conn->to) {
+        ERROR << "Skipping connection from " << *location << " to " << conn->to
+              << ", which is outside of " << machine;
+        continue;
+      }
+      w.connections.push_back({location_ids[location->handle.index],
+                               location_ids[conn->to.handle.index],
+                               w.Intern(conn->argument.name)});
+    }
+  }
+  if (window) {
+    rapidjson::StringBuffer sb;
+    Serializer window_writer(sb);
+    window->SerializeState(window_writer);
+    window_writer.Flush();
+    w.window = Str(sb.GetString(), sb.GetSize());
+  }
+
+  struct Payload {
+    SectionKind kind;
+    uint32_t count;
+    StrView bytes;
+  };
+  auto Bytes = [](auto& vec) {
+    return StrView(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(vec[0]));
+  };
+  Payload payloads[] = {
+      {kStrings, (uint32_t)w.strings.size(), w.strings},
+      {kMachine, (uint32_t)w.machine.size(), Bytes(w.machine)},
+      {kLocations, (uint32_t)w.locations.size(), Bytes(w.locations)},
+      {kConnections, (uint32_t)w.connections.size(), Bytes(w.connections)},
+      {kSampleRuns, (uint32_t)w.sample_runs.size(), Bytes(w.sample_runs)},
+      {kSamples, (uint32_t)w.samples.size(), Bytes(w.samples)},
+      {kWindow, (uint32_t)w.window.size(), w.window},
+  };
+  constexpr uint32_t n = std::size(payloads);
+
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.section_count = n;
+  Section sections[n];
+  uint64_t offset = sizeof(Header) + sizeof(sections);
+  for (uint32_t i = 0; i < n; ++i) {
+    sections[i] = {payloads[i].kind, payloads[i].count, offset, payloads[i].bytes.size()};
+    offset += (payloads[i].bytes.size() + 7) & ~7ull;
+  }
+  Str out;
+  out.reserve(offset);
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.append(reinterpret_cast<const char*>(sections), sizeof(sections));
+  for (auto& payload : payloads) {
+    out.append(payload.bytes);
+    out.resize((out.size() + 7) & ~7ull, '\0');
+  }
+  return out;
+}
+
+bool IsSnapshot(StrView data) {
+  return data.size() >= sizeof(Header) && memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+void Load(StrView data, Location& here, gui::Window* window, Status& status,
+          Vec<Location*>* loaded) {
+  if (!IsSnapshot(data)) {
+    AppendErrorMessage(status) += "Not a snapshot";
+    return;
+  }
+  Header header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.version != kVersion) {
+    AppendErrorMessage(status) += f("Unsupported snapshot version: %u", header.version);
+    return;
+  }
+  if (data.size() < sizeof(Header) + (uint64_t)header.section_count * sizeof(Section)) {
+    AppendErrorMessage(status) += "Truncated section table";
+    return;
+  }
+  Reader r;
+  r.data = data;
+  auto* sections = reinterpret_cast<const Section*>(data.data() + sizeof(Header));
+  for (uint32_t i = 0; i < header.section_count; ++i) {
+    const Section& section = sections[i];
+    if (section.kind == 0 || section.kind >= kSectionKinds) {
+      continue;  // unknown sections are skipped
+    }
+    if (section.offset % 8 != 0 || section.offset > data.size() ||
+        section.size > data.size() - section.offset ||
+        (uint64_t)section.count * RecordSize(section.kind) != section.size) {
+      AppendErrorMessage(status) += f("Invalid section %u", section.kind);
+      return;
+    }
+    r.sections[section.kind] = data.substr(section.offset, section.size);
+    r.counts[section.kind] = section.count;
+  }
+  Machine* machine = here.ThisAs<Machine>();
+  if (machine == nullptr) {
+    AppendErrorMessage(status) += "Snapshots can only be loaded into Machines";
+    return;
+  }
+  r.Validate(status);
+  if (!OK(status)) {
+    return;
+  }
+
+  if (window && !r.sections[kWindow].empty()) {
+    ParseJson(r.sections[kWindow], nullptr,
+              [&](Deserializer& d) { window->DeserializeState(d, status); });
+  }
+  {
+    // Connections are announced & the Locations are updated once the whole graph is loaded.
+    BulkEdit bulk;
+    for (auto& record : r.Records<MachineRecord>(kMachine)) {
+      machine->name = r.Get(record.name);
+    }
+    auto location_records = r.Records<LocationRecord>(kLocations);
+    Vec<Location*> locations;
+    locations.reserve(location_records.size());
+    for (auto& record : location_records) {
+      auto& l = machine->CreateEmpty(Str(r.Get(record.name)));
+      locations.push_back(&l);
+      l.position = Vec2(record.x, record.y);
+      if (record.type.size) {
+        StrView type = r.Get(record.type);
+        if (const Object* proto = FindPrototype(type)) {
+          l.Create(*proto);
+        } else {
+          l.ReportError(f("Unknown object type: %.*s", (int)type.size(), type.data()));
+        }
+      }
+      if (record.value.size) {
+        DeserializeValue(l, r.Get(record.value), &r);
+      }
+    }
+    for (auto& record : r.Records<ConnectionRecord>(kConnections)) {
+      Location* from = locations[record.from];
+      if (from->object == nullptr) {
+        continue;
+      }
+      StrView label = r.Get(record.label);
+      from->object->Args([&](Argument& arg) {
+        if (arg.name == label) {
+          from->ConnectTo(*locations[record.to], arg);
+        }
+      });
+    }
+    for (auto* location : locations) {
+      machine->UpdateIndex(*location);
+    }
+    if (loaded) {
+      *loaded = std::move(locations);
+    }
+  }
+}
+
+Str SerializeValue(const Object& object, SampleSink* samples) {
+  rapidjson::StringBuffer sb;
+  Serializer json(sb);
+  json.samples = samples;
+  json.SetIndent(' ', 0);
+  json.StartObject();
+  object.SerializeState(json, "value");
+  json.EndObject();
+  json.Flush();
+  if (sb.GetSize() <= 2) {  // "{}"
+    return {};
+  }
+  return Str(sb.GetString(), sb.GetSize());
+}
+
+void DeserializeValue(Location& l, StrView json, SampleSource* samples) {
+  if (json.empty() || l.object == nullptr) {
+    return;
+  }
+  ParseJson(json, samples, [&](Deserializer& d) {
+    Status status;
+    for (auto& key : ObjectView(d, status)) {
+      if (key == "value") {
+        l.object->DeserializeState(l, d);
+      }
+    }
+    if (!OK(status)) {
+      l.ReportError(status.ToStr());
+    }
+  });
+}
+
+}  // namespace automat::snapshot
@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+
+#include "status.hh"
+#include "str.hh"
+#include "vec.hh"
+
+namespace automat {
+
+struct Location;
+struct Machine;
+struct Object;
+struct SampleSink;
+struct SampleSource;
+
+namespace gui {
+struct Window;
+}  // namespace gui
+
+// Binary snapshots of the state of a Machine.
+//
+// JSON (see persistence.hh) is easy to diff & migrate but it's slow to parse when the state is
+// large. Snapshots keep the bulk of the state in fixed-layout sections that can be used directly
+// from a memory-mapped file (see `fs::RealFS::Map`):
+//
+//   Header   magic, version & a table of sections (kind, record count, offset & size)
+//   Strings  names, types & labels (deduplicated) and the JSON of the object values
+//   Machine  name of the Machine
+//   Locations  one record per Location: name, type, value & position
+//   Connections  one record per Connection: indices of the Locations & the label of the Argument
+//   SampleRuns & Samples  large arrays of numbers (such as the timestamps of Timeline tracks)
+//   Window   JSON of the window state
+//
+// Sections start at 8-byte aligned offsets. Numbers are stored in the native byte order, so
+// snapshots are meant to be loaded by the machine that wrote them. JSON remains the portable
+// format.
+//
+// Objects still serialize their own values through `Object::SerializeState`. Their large numeric
+// arrays can be moved to the Samples section through `Serializer::samples` (and loaded through
+// `Deserializer::samples`).
+namespace snapshot {
+
+// Incremented whenever the layout of the snapshots changes. Snapshots with a different version are
+// rejected (the JSON state should be used to migrate them).
+constexpr uint32_t kVersion = 1;
+
+// Serializes the Machine & (optionally) the window state.
+maf::Str Save(const Machine&, const gui::Window*);
+
+// True if the data starts with the header of a snapshot.
+bool IsSnapshot(maf::StrView data);
+
+// Restores the Machine held by `here` (and optionally the window state) from a snapshot. `data`
+// only needs to stay valid during this call. All records are validated before anything is loaded,
+// so if the snapshot is damaged, the Machine is left untouched. Errors of individual objects are
+// reported on their Locations. `loaded` receives the new Locations in the order in
+// which they were saved (the order of `Machine::locations`).
+void Load(maf::StrView data, Location& here, gui::Window*, maf::Status&,
+          maf::Vec<Location*>* loaded = nullptr);
+
+// JSON of the object's state, as an object with a single "value" key. Empty if the object has no
+// state. Large numeric arrays go to `samples` if it's given.
+maf::Str SerializeValue(const Object&, SampleSink* samples = nullptr);
+
+// Restores the state saved by `SerializeValue` into the object of the given Location. Errors are
+// reported on the Location. `samples` must match the SampleSink given to `SerializeValue`.
+void DeserializeValue(Location&, maf::StrView json, SampleSource* samples = nullptr);
+
+}  // namespace snapshot
+
+}  // namespace automat
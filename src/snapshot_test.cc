@@ -0,0 +1,131 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "snapshot.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+
+using namespace automat;
+using namespace maf;
+
+struct SnapshotTest : TestBase {
+  Location loaded_root = Location(nullptr);
+  Machine& loaded = *loaded_root.Create<Machine>();
+
+  Location* Loaded(StrView name) {
+    for (auto& location : loaded.locations) {
+      if (location->name == name) {
+        return location.get();
+      }
+    }
+    return nullptr;
+  }
+};
+
+TEST_F(SnapshotTest, RoundTrip) {
+  machine.name = "Saved";
+  Location& text = machine.Create<Text>("text");
+  text.SetText("hello");
+  text.position = Vec2(1.5, -2);
+  Location& test = machine.Create<EqualityTest>("test");
+  test.ConnectTo(text, EqualityTest::target_arg);
+
+  Str data = snapshot::Save(machine, nullptr);
+  ASSERT_TRUE(snapshot::IsSnapshot(data));
+  Status status;
+  snapshot::Load(data, loaded_root, nullptr, status);
+  ASSERT_TRUE(OK(status)) << status.ToStr();
+
+  EXPECT_EQ(loaded.name, "Saved");
+  ASSERT_EQ(loaded.locations.size(), 2);
+  Location* loaded_text = Loaded("text");
+  Location* loaded_test = Loaded("test");
+  ASSERT_NE(loaded_text, nullptr);
+  ASSERT_NE(loaded_test, nullptr);
+  EXPECT_EQ(loaded_text->GetText(), "hello");
+  EXPECT_EQ(loaded_text->position.x, 1.5f);
+  EXPECT_EQ(loaded_text->position.y, -2.f);
+  ASSERT_EQ(loaded_test->outgoing.size(), 1);
+  EXPECT_EQ(&(*loaded_test->outgoing.begin())->to, loaded_text);
+}
+
+// Connections that leave the saved Machine can't be restored so they're skipped.
+TEST_F(SnapshotTest, SkipsConnectionsToOtherMachines) {
+  Location& outside = loaded.Create<Text>("outside");
+  Location& test = machine.Create<EqualityTest>("test");
+  test.ConnectTo(outside, EqualityTest::target_arg);
+
+  Str data = snapshot::Save(machine, nullptr);
+  loaded.ClearLocations();
+  Status status;
+  snapshot::Load(data, loaded_root, nullptr, status);
+  ASSERT_TRUE(OK(status)) << status.ToStr();
+  ASSERT_NE(Loaded("test"), nullptr);
+  EXPECT_TRUE(Loaded("test")->outgoing.empty());
+}
+
+TEST_F(SnapshotTest, RejectsOtherVersions) {
+  machine.Create<Text>();
+  Str data = snapshot::Save(machine, nullptr);
+  data[8] += 1;  // version follows the 8-byte magic
+  Status status;
+  snapshot::Load(data, loaded_root, nullptr, status);
+  EXPECT_FALSE(OK(status));
+  EXPECT_TRUE(loaded.locations.empty());
+}
+
+// Track timestamps go through the Samples section.
+TEST_F(SnapshotTest, TimelineRoundTrip) {
+  Location& l = machine.Create<library::Timeline>("timeline");
+  auto& track = l.ThisAs<library::Timeline>()->AddOnOffTrack("track");
+  track.timestamps.Write() = {0.5, 1, 2.25};
+
+  Str data = snapshot::Save(machine, nullptr);
+  EXPECT_NE(data.find("timestamps_samples"), Str::npos);
+  Status status;
+  snapshot::Load(data, loaded_root, nullptr, status);
+  ASSERT_TRUE(OK(status)) << status.ToStr();
+
+  Location* loaded_timeline = Loaded("timeline");
+  ASSERT_NE(loaded_timeline, nullptr);
+  EXPECT_FALSE(loaded_timeline->HasError());
+  auto* timeline = loaded_timeline->ThisAs<library::Timeline>();
+  ASSERT_NE(timeline, nullptr);
+  ASSERT_EQ(timeline->tracks.size(), 1);
+  EXPECT_EQ(timeline->track_args[0]->name, "track");
+  EXPECT_EQ(*timeline->tracks[0]->timestamps, (Vec<time::T>{0.5, 1, 2.25}));
+}
+
+// Damaged snapshots are rejected before anything is loaded.
+TEST_F(SnapshotTest, RejectsStringsOutOfBounds) {
+  machine.Create<Text>("first");
+  machine.Create<Text>("second");
+  Str data = snapshot::Save(machine, nullptr);
+  // Point the name of the second Location past the end of the Strings section. The offset of the
+  // Locations section is in the third entry of the section table (after the 16-byte header).
+  uint64_t locations_offset;
+  memcpy(&locations_offset, data.data() + 16 + 2 * 24 + 8, sizeof(locations_offset));
+  uint32_t name_offset = data.size();
+  memcpy(data.data() + locations_offset + 32, &name_offset, sizeof(name_offset));
+
+  Status status;
+  snapshot::Load(data, loaded_root, nullptr, status);
+  EXPECT_FALSE(OK(status));
+  EXPECT_TRUE(loaded.locations.empty());
+}
+
+// Outside of snapshots (for example in the journal) the timestamps stay in the JSON.
+TEST_F(SnapshotTest, SamplesAreOnlyStoredInSnapshots) {
+  Location& l = machine.Create<library::Timeline>("timeline");
+  auto& track = l.ThisAs<library::Timeline>()->AddOnOffTrack("track");
+  track.timestamps.Write() = {0.5, 1, 2.25};
+
+  Str value = snapshot::SerializeValue(*l.object);
+  EXPECT_EQ(value.find("timestamps_samples"), Str::npos);
+  EXPECT_NE(value.find("timestamps"), Str::npos);
+}
@@ -0,0 +1,216 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "spatial_index.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+namespace automat {
+
+static int CellCoord(float v) {
+  // Clamped so that far away (or infinite) bounds don't overflow the cell coordinates.
+  return (int)std::clamp(floorf(v / SpatialIndex::kCellSize), -1e9f, 1e9f);
+}
+
+static uint64_t CellKey(int x, int y) { return (uint64_t)(uint32_t)x << 32 | (uint32_t)y; }
+
+static bool BoundsContain(const Rect& bounds, Vec2 point) {
+  return bounds.left <= point.x && point.x <= bounds.right && bounds.bottom <= point.y &&
+         point.y <= bounds.top;
+}
+
+void SpatialIndex::Link(Entry& entry) {
+  entry.x0 = CellCoord(entry.bounds.left);
+  entry.x1 = CellCoord(entry.bounds.right);
+  entry.y0 = CellCoord(entry.bounds.bottom);
+  entry.y1 = CellCoord(entry.bounds.top);
+  int64_t n_cells = int64_t(entry.x1 - entry.x0 + 1) * int64_t(entry.y1 - entry.y0 + 1);
+  entry.large = n_cells > kMaxCells;
+  if (entry.large) {
+    large.push_back(&entry);
+    return;
+  }
+  if (cells.empty()) {
+    min_x = entry.x0;
+    min_y = entry.y0;
+    max_x = entry.x1;
+    max_y = entry.y1;
+  } else {
+    min_x = std::min(min_x, entry.x0);
+    min_y = std::min(min_y, entry.y0);
+    max_x = std::max(max_x, entry.x1);
+    max_y = std::max(max_y, entry.y1);
+  }
+  for (int x = entry.x0; x <= entry.x1; ++x) {
+    for (int y = entry.y0; y <= entry.y1; ++y) {
+      cells[CellKey(x, y)].push_back(&entry);
+    }
+  }
+}
+
+void SpatialIndex::Unlink(Entry& entry) {
+  if (entry.large) {
+    large.erase(std::find(large.begin(), large.end(), &entry));
+    return;
+  }
+  for (int x = entry.x0; x <= entry.x1; ++x) {
+    for (int y = entry.y0; y <= entry.y1; ++y) {
+      auto it = cells.find(CellKey(x, y));
+      auto& cell = it->second;
+      *std::find(cell.begin(), cell.end(), &entry) = cell.back();
+      cell.pop_back();
+      if (cell.empty()) {
+        cells.erase(it);
+      }
+    }
+  }
+}
+
+void SpatialIndex::Insert(Location& location, Rect bounds) {
+  auto [it, inserted] = entries.try_emplace(&location);
+  Entry& entry = it->second;
+  if (!inserted) {
+    Unlink(entry);
+  }
+  entry.location = &location;
+  entry.bounds = bounds;
+  entry.z = next_z++;
+  entry.visited = query;
+  Link(entry);
+}
+
+void SpatialIndex::Update(Location& location, Rect bounds) {
+  auto it = entries.find(&location);
+  if (it == entries.end()) {
+    return;
+  }
+  Entry& entry = it->second;
+  if (CellCoord(bounds.left) == entry.x0 && CellCoord(bounds.right) == entry.x1 &&
+      CellCoord(bounds.bottom) == entry.y0 && CellCoord(bounds.top) == entry.y1) {
+    entry.bounds = bounds;  // same cells - common when objects are nudged a little
+    return;
+  }
+  Unlink(entry);
+  entry.bounds = bounds;
+  Link(entry);
+}
+
+void SpatialIndex::Remove(Location& location) {
+  auto it = entries.find(&location);
+  if (it == entries.end()) {
+    return;
+  }
+  Unlink(it->second);
+  entries.erase(it);
+}
+
+void SpatialIndex::SwapOrder(Location& a, Location& b) {
+  std::swap(entries.at(&a).z, entries.at(&b).z);
+}
+
+void SpatialIndex::Clear() {
+  entries.clear();
+  cells.clear();
+  large.clear();
+}
+
+void SpatialIndex::AtPoint(Vec2 point, std::vector<Location*>& out) {
+  std::vector<Entry*> hits;
+  if (auto it = cells.find(CellKey(CellCoord(point.x), CellCoord(point.y))); it != cells.end()) {
+    for (Entry* entry : it->second) {
+      if (BoundsContain(entry->bounds, point)) {
+        hits.push_back(entry);
+      }
+    }
+  }
+  for (Entry* entry : large) {
+    if (BoundsContain(entry->bounds, point)) {
+      hits.push_back(entry);
+    }
+  }
+  std::sort(hits.begin(), hits.end(), [](Entry* a, Entry* b) { return a->z > b->z; });
+  for (Entry* entry : hits) {
+    out.push_back(entry->location);
+  }
+}
+
+void* SpatialIndex::Nearby(Vec2 center, float radius, maf::Fn<void*(Location&)> callback) {
+  float radius2 = radius * radius;
+  ++query;
+  using Candidate = std::pair<float, Entry*>;
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+  auto consider = [&](Entry* entry) {
+    if (entry->visited == query) {
+      return;  // entries spanning several cells are seen several times
+    }
+    entry->visited = query;
+    float dist2 = entry->bounds.DistanceSquared(center);
+    if (dist2 <= radius2) {
+      candidates.push({dist2, entry});
+    }
+  };
+  // Report the candidates which are closer than any entry that wasn't considered yet.
+  auto flush = [&](float safe_dist2) -> void* {
+    while (!candidates.empty() && candidates.top().first <= safe_dist2) {
+      Entry* entry = candidates.top().second;
+      candidates.pop();
+      if (auto ret = callback(*entry->location)) {
+        return ret;
+      }
+    }
+    return nullptr;
+  };
+
+  for (Entry* entry : large) {
+    consider(entry);
+  }
+  if (!cells.empty()) {
+    int cx = CellCoord(center.x);
+    int cy = CellCoord(center.y);
+    // Rings beyond the occupied range or beyond the radius can't contain any candidates.
+    int64_t rings = std::max({(int64_t)cx - min_x, (int64_t)max_x - cx, (int64_t)cy - min_y,
+                              (int64_t)max_y - cy});
+    rings = std::min(rings, (int64_t)std::min(ceilf(radius / kCellSize), 2e9f) + 1);
+    double ring_cells = (2. * rings + 1) * (2. * rings + 1);
+    if (ring_cells > 4. * entries.size()) {
+      // Sparse grid (or a huge radius) - checking every entry is cheaper than checking every cell.
+      for (auto& [location, entry] : entries) {
+        consider(&entry);
+      }
+    } else {
+      auto scan = [&](int64_t x, int64_t y) {
+        if (x < min_x || x > max_x || y < min_y || y > max_y) {
+          return;
+        }
+        if (auto it = cells.find(CellKey(x, y)); it != cells.end()) {
+          for (Entry* entry : it->second) {
+            consider(entry);
+          }
+        }
+      };
+      for (int64_t r = 0; r <= rings; ++r) {
+        for (int64_t x = cx - r; x <= cx + r; ++x) {
+          scan(x, cy - r);
+          if (r > 0) {
+            scan(x, cy + r);
+          }
+        }
+        for (int64_t y = cy - r + 1; y <= cy + r - 1; ++y) {
+          scan(cx - r, y);
+          scan(cx + r, y);
+        }
+        // The center lies in cell (cx, cy) so everything outside of the scanned square is at least
+        // `r` cells away.
+        float safe_dist = r * kCellSize;
+        if (auto ret = flush(safe_dist * safe_dist)) {
+          return ret;
+        }
+      }
+    }
+  }
+  return flush(INFINITY);
+}
+
+}  // namespace automat
@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "fn.hh"
+#include "math.hh"
+
+namespace automat {
+
+struct Location;
+
+// Uniform grid over the bounding boxes of Locations.
+//
+// Each entry is registered in every cell that its bounds overlap. Point queries look at a single
+// cell. Nearest-neighbour queries scan the cells in rings of growing size around the query point &
+// report entries in the order of increasing distance. Entries that would span more than kMaxCells
+// cells are kept on a separate list which is checked by every query.
+//
+// The index never looks into the Locations - their bounds are provided by the caller (see
+// `Machine::UpdateIndex`). It also remembers the stacking order of the entries so that point
+// queries can return the topmost Location first.
+//
+// Not thread-safe.
+struct SpatialIndex {
+  static constexpr float kCellSize = 0.04;  // 4 cm
+  static constexpr int kMaxCells = 64;
+
+  // Add a new entry on top of all the other entries. If the location is already indexed, only its
+  // bounds are updated.
+  void Insert(Location&, Rect bounds);
+
+  // Change the bounds of an indexed location. Does nothing if the location isn't indexed.
+  void Update(Location&, Rect bounds);
+
+  // Does nothing if the location isn't indexed.
+  void Remove(Location&);
+
+  // Exchange the stacking order of two indexed locations.
+  void SwapOrder(Location&, Location&);
+
+  void Clear();
+
+  bool Contains(Location& location) const { return entries.contains(&location); }
+  size_t Size() const { return entries.size(); }
+
+  // Fills `out` with the locations whose bounds contain the point. Topmost first.
+  void AtPoint(Vec2 point, std::vector<Location*>& out);
+
+  // Calls `callback` for every location whose bounds are within `radius` from `center` - nearest
+  // first. Returns the first non-null value returned by the callback.
+  //
+  // The callback must not modify the index.
+  void* Nearby(Vec2 center, float radius, maf::Fn<void*(Location&)> callback);
+
+ private:
+  struct Entry {
+    Location* location;
+    Rect bounds;
+    int x0, y0, x1, y1;  // inclusive range of cells
+    bool large;
+    uint64_t z;        // stacking order - higher is on top
+    uint32_t visited;  // last query which looked at this entry
+  };
+
+  std::unordered_map<Location*, Entry> entries;
+  std::unordered_map<uint64_t, std::vector<Entry*>> cells;
+  std::vector<Entry*> large;
+  uint64_t next_z = 0;
+  uint32_t query = 0;
+
+  // Range of cells occupied since `cells` was last empty.
+  int min_x = 0, min_y = 0, max_x = -1, max_y = -1;
+
+  void Link(Entry&);
+  void Unlink(Entry&);
+};
+
+}  // namespace automat
@@ -0,0 +1,187 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "spatial_index.hh"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "base.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+// Square with its lower left corner at the origin of its Location.
+struct Box : Object {
+  static const Box proto;
+  float size = 1_cm;
+  string_view Name() const override { return "Box"; }
+  std::unique_ptr<Object> Clone() const override { return std::make_unique<Box>(*this); }
+  SkPath Shape(animation::Display*) const override {
+    return SkPath::Rect(Rect::MakeZeroWH(size, size));
+  }
+};
+
+const Box Box::proto;
+
+struct SpatialIndexTest : TestBase {
+  Location& CreateBox(Vec2 position) {
+    Location& l = machine.Create<Box>();
+    l.position = position;
+    machine.UpdateIndex(l);
+    return l;
+  }
+};
+
+TEST_F(SpatialIndexTest, LocationAtPointPicksTopmost) {
+  Location& a = CreateBox({0, 0});
+  Location& b = CreateBox({0, 0});
+  EXPECT_EQ(machine.LocationAtPoint({0.5_cm, 0.5_cm}), &b);
+  EXPECT_EQ(machine.LocationAtPoint({2_cm, 0.5_cm}), nullptr);
+
+  a.position = {1.5_cm, 0};
+  machine.UpdateIndex(a);
+  EXPECT_EQ(machine.LocationAtPoint({2_cm, 0.5_cm}), &a);
+
+  PositionBelow(a, b);  // `b` was created later so it's above `a`
+  a.position = {0, 0};
+  machine.UpdateIndex(a);
+  EXPECT_EQ(machine.LocationAtPoint({0.5_cm, 0.5_cm}), &a);
+
+  auto extracted = machine.Extract(a);
+  EXPECT_EQ(machine.LocationAtPoint({0.5_cm, 0.5_cm}), &b);
+  EXPECT_FALSE(machine.index.Contains(*extracted));
+}
+
+TEST_F(SpatialIndexTest, NearbyVisitsNearestFirst) {
+  std::vector<Location*> boxes;
+  for (float x : {30_cm, -10_cm, 1_cm, 50_cm, -3_cm}) {
+    boxes.push_back(&CreateBox({x, 0}));
+  }
+  std::vector<Location*> visited;
+  machine.Nearby({0.5_cm, 0.5_cm}, 20_cm, [&](Location& l) -> void* {
+    visited.push_back(&l);
+    return nullptr;
+  });
+  EXPECT_EQ(visited, (std::vector<Location*>{boxes[2], boxes[4], boxes[1]}));
+
+  void* found = machine.Nearby({45_cm, 0}, HUGE_VALF, [&](Location& l) -> void* { return &l; });
+  EXPECT_EQ(found, boxes[3]);
+}
+
+TEST_F(SpatialIndexTest, ShapeIsCachedUntilInvalidated) {
+  Location& l = CreateBox({0, 0});
+  auto rebuilds = shape_cache_stats.rebuilds;
+  EXPECT_EQ(machine.LocationAtPoint({0.5_cm, 0.5_cm}), &l);
+  EXPECT_EQ(machine.LocationAtPoint({0.6_cm, 0.6_cm}), &l);
+  EXPECT_EQ(shape_cache_stats.rebuilds, rebuilds);
+
+  l.As<Box>()->size = 2_cm;
+  l.InvalidateShape();
+  EXPECT_EQ(machine.LocationAtPoint({1.5_cm, 1.5_cm}), &l);
+  EXPECT_EQ(shape_cache_stats.rebuilds, rebuilds + 1);
+}
+
+// Replacing the object drops the cached shape, even if the new object lands at the address of the
+// old one.
+TEST_F(SpatialIndexTest, ShapeIsInvalidatedWhenObjectIsReplaced) {
+  Location& l = CreateBox({0, 0});
+  EXPECT_EQ(l.ObjectShape().getBounds().width(), 1_cm);
+  Box big;
+  big.size = 2_cm;
+  l.Clear();
+  EXPECT_TRUE(l.ObjectShape().isEmpty());
+  l.Create(big);
+  EXPECT_EQ(l.ObjectShape().getBounds().width(), 2_cm);
+  std::vector<Location*> indexed;
+  machine.index.AtPoint({1.5_cm, 1.5_cm}, indexed);
+  EXPECT_EQ(indexed, (std::vector<Location*>{&l}));
+
+  l.Create(Box::proto);
+  EXPECT_EQ(l.ObjectShape().getBounds().width(), 1_cm);
+  auto taken = l.Take();
+  EXPECT_TRUE(l.ObjectShape().isEmpty());
+  l.InsertHere(std::move(taken));
+  EXPECT_EQ(l.ObjectShape().getBounds().width(), 1_cm);
+}
+
+// The index is authoritative - objects that change their size must call `InvalidateShape` before
+// they can be found at their new extent.
+TEST_F(SpatialIndexTest, ResizeIsVisibleAfterInvalidateShape) {
+  Location& l = CreateBox({0, 0});
+  l.As<Box>()->size = 2_cm;
+  EXPECT_EQ(machine.LocationAtPoint({1.5_cm, 1.5_cm}), nullptr);
+  l.InvalidateShape();
+  EXPECT_EQ(machine.LocationAtPoint({1.5_cm, 1.5_cm}), &l);
+  std::vector<Location*> indexed;
+  machine.index.AtPoint({1.5_cm, 1.5_cm}, indexed);
+  EXPECT_EQ(indexed, (std::vector<Location*>{&l}));
+
+  l.As<Box>()->size = 1_cm;
+  l.InvalidateShape();
+  EXPECT_EQ(machine.LocationAtPoint({1.5_cm, 1.5_cm}), nullptr);
+}
+
+// Compare the index against the linear scans that Machine used before. Disabled by default - run
+// with `--gtest_also_run_disabled_tests --gtest_filter=*Benchmark*`.
+TEST_F(SpatialIndexTest, DISABLED_Benchmark10k) {
+  using Clock = std::chrono::steady_clock;
+  constexpr int kLocations = 10'000;
+  constexpr int kQueries = 1'000;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> coord(-2, 2);  // 4 x 4 meters
+  for (int i = 0; i < kLocations; ++i) {
+    CreateBox({coord(rng), coord(rng)});
+  }
+  std::vector<Vec2> points(kQueries);
+  for (auto& point : points) {
+    point = {coord(rng), coord(rng)};
+  }
+  auto bounds = [](Location& l) {
+    return Rect(l.object->Shape(nullptr).getBounds()).MoveBy(l.position);
+  };
+  auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+  std::vector<Location*> linear_hits(kQueries);
+  std::vector<float> linear_nearest(kQueries);
+  auto t0 = Clock::now();
+  for (int i = 0; i < kQueries; ++i) {
+    for (auto& l : machine.locations) {
+      Vec2 local_point = (points[i] - l->position) / l->scale;
+      if (l->object->Shape(nullptr).contains(local_point.x, local_point.y)) {
+        linear_hits[i] = l.get();
+        break;
+      }
+    }
+  }
+  auto t1 = Clock::now();
+  for (int i = 0; i < kQueries; ++i) {
+    linear_nearest[i] = HUGE_VALF;
+    for (auto& l : machine.locations) {
+      linear_nearest[i] = std::min(linear_nearest[i], bounds(*l).DistanceSquared(points[i]));
+    }
+  }
+  auto t2 = Clock::now();
+
+  std::vector<Location*> index_hits(kQueries);
+  std::vector<float> index_nearest(kQueries);
+  auto i0 = Clock::now();
+  for (int i = 0; i < kQueries; ++i) {
+    index_hits[i] = machine.LocationAtPoint(points[i]);
+  }
+  auto i1 = Clock::now();
+  for (int i = 0; i < kQueries; ++i) {
+    auto* nearest = (Location*)machine.Nearby(points[i], HUGE_VALF, [](Location& l) { return &l; });
+    index_nearest[i] = bounds(*nearest).DistanceSquared(points[i]);
+  }
+  auto i2 = Clock::now();
+
+  EXPECT_EQ(linear_hits, index_hits);
+  EXPECT_EQ(linear_nearest, index_nearest);
+  printf("%d locations  %d points [ms]  %d nearest [ms]\n", kLocations, kQueries, kQueries);
+  printf("linear scan      %14.2f  %15.2f\n", ms(t1 - t0), ms(t2 - t1));
+  printf("spatial index    %14.2f  %15.2f\n", ms(i1 - i0), ms(i2 - i1));
+}
@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "stats.hh"
+
+#include "argument.hh"
+#include "base.hh"
+#include "bulk_edit.hh"
+#include "dataflow.hh"
+#include "format.hh"
+#include "journal.hh"
+#include "location.hh"
+#include "log.hh"
+#include "offload.hh"
+#include "root.hh"
+#include "tasks.hh"
+#include "timer_thread.hh"
+#include "window.hh"
+
+using namespace maf;
+
+namespace automat {
+
+void DumpStats() {
+  if (auto jitter = GetTimerJitter(); jitter.count) {
+    LOG << "Timer jitter: " << jitter.Format("timers");
+  }
+  for (int lane = 0; lane < kPriorities; ++lane) {
+    if (queue.latency[lane].count) {
+      LOG << "Task latency (" << PriorityName((Priority)lane)
+          << "): " << queue.latency[lane].Format("tasks");
+    }
+  }
+  if (auto offload_stats = offload::GetStats(); offload_stats.submitted) {
+    LOG << "Offload queue wait: " << offload_stats.queue_wait.Format("jobs");
+    LOG << "Offload run time: " << offload_stats.run_time.Format("jobs");
+  }
+  if (auto dataflow_stats = dataflow::GetStats(); dataflow_stats.waves) {
+    LOG << f("Dataflow: %lu waves, %lu updates delivered, %lu merged, %lu unchanged locations "
+             "skipped",
+             dataflow_stats.waves, dataflow_stats.updates, dataflow_stats.merged,
+             dataflow_stats.skipped);
+  }
+  if (auto bulk_stats = bulk_edit::GetStats(); bulk_stats.commits) {
+    LOG << f("Bulk edits: %lu commits, %lu connections, %lu of %lu requested updates scheduled",
+             bulk_stats.commits, bulk_stats.connections, bulk_stats.updates_scheduled,
+             bulk_stats.updates_requested);
+  }
+  if (auto journal_stats = journal::GetStats(); journal_stats.records) {
+    LOG << f("Journal: %lu records, %lu KiB, %lu compactions", journal_stats.records,
+             journal_stats.bytes / 1024, journal_stats.compactions);
+    LOG << "Journal record time: " << journal_stats.record_time.Format("records");
+  }
+  if (auto lookups = argument_cache_stats.hits + argument_cache_stats.misses) {
+    LOG << f("Argument cache: %lu hits, %lu misses (%.1f%% hit rate)", argument_cache_stats.hits,
+             argument_cache_stats.misses, 100. * argument_cache_stats.hits / lookups);
+  }
+  if (shape_cache_stats.hits && gui::window && gui::window->frames_drawn) {
+    LOG << f("Shape cache: %lu hits, %lu rebuilds, %.1f path constructions avoided per frame",
+             shape_cache_stats.hits, shape_cache_stats.rebuilds,
+             (double)shape_cache_stats.hits / gui::window->frames_drawn);
+  }
+  LOG << "Memory: " << root_machine->MemoryReport();
+}
+
+}  // namespace automat
@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+namespace automat {
+
+// Logs the statistics collected while running (task latency, timer jitter, caches, journal, etc.).
+//
+// Called after the Automat thread is stopped - at the end of a headless run & on exit when Automat
+// is started with `--stats`.
+void DumpStats();
+
+}  // namespace automat
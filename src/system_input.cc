@@ -0,0 +1,9 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "system_input.hh"
+
+namespace automat::gui {
+
+std::unique_ptr<SystemInput> system_input = std::make_unique<SystemInput>();
+
+}  // namespace automat::gui
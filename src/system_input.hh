@@ -0,0 +1,30 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <memory>
+
+#include "keyboard.hh"
+#include "widget.hh"
+
+namespace automat::gui {
+
+// Keyboard & mouse of the operating system - used to grab global hotkeys, to watch the raw key
+// events (keylogging) & to send synthetic input.
+//
+// The main function of the platform installs its own implementation (see linux_main.cc). The
+// default one does nothing, which is what the headless mode needs.
+struct SystemInput {
+  virtual ~SystemInput() = default;
+
+  virtual void GrabKey(AnsiKey, bool ctrl, bool alt, bool shift, bool windows) {}
+  virtual void UngrabKey(AnsiKey) {}
+  // Starts or stops the delivery of the raw key events of all of the keyboards.
+  virtual void WatchRawKeys(bool enabled) {}
+  virtual void SendKey(AnsiKey, bool down) {}
+  virtual void SendButton(PointerButton, bool down) {}
+};
+
+extern std::unique_ptr<SystemInput> system_input;
+
+}  // namespace automat::gui
@@ -0,0 +1,16 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "task_pool.hh"
+
+namespace automat::task_pool {
+
+// Blocks up to 256 bytes are pooled. Beyond 4096 free blocks per size class, blocks are released.
+using TaskPool = ThreadPool<16, 16, 4096>;
+
+void* Alloc(size_t size) { return TaskPool::Alloc(size); }
+
+void Free(void* ptr, size_t size) { TaskPool::Free(ptr, size); }
+
+Stats& ThreadStats() { return TaskPool::ThreadStats(); }
+
+}  // namespace automat::task_pool
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "size_class_pool.hh"
+
+// Per-thread pool of memory blocks for transient Tasks.
+//
+// Tasks such as UpdateTask or ErroredTask are allocated & released at a very high rate (every
+// update of every observer creates a new one). Instead of going through the general-purpose
+// allocator each time, released tasks are kept on intrusive free lists (one per 16-byte size class)
+// and reused by the next allocation of a similar size.
+//
+// Blocks may be released on a different thread than the one which allocated them (for example
+// when a task is sent to the Automat thread through `events`). They simply end up on the free list
+// of the releasing thread.
+namespace automat::task_pool {
+
+struct Stats {
+  uint64_t allocated = 0;  // allocations that went through the general-purpose allocator
+  uint64_t reused = 0;     // allocations served from the free lists
+  uint64_t released = 0;   // blocks returned to the general-purpose allocator
+  uint64_t last_run_loop_reused = 0;  // allocations saved during the last `RunLoop`
+};
+
+// Free lists & statistics of a single thread. See `ThreadPool`.
+template <size_t kGranularity, size_t kSizeClasses>
+struct ThreadState {
+  SizeClassPool<kGranularity, kSizeClasses> blocks;
+  Stats stats;
+  bool destroyed = false;
+
+  ~ThreadState() {
+    blocks.Drain([](void* block) { ::operator delete(block); });
+    destroyed = true;
+  }
+};
+
+// Per-thread SizeClassPool backed by the general-purpose allocator. Blocks that are too large for
+// the size classes, or that don't fit on the free lists (`kMaxFreeBlocks` per class), go straight to
+// the heap.
+//
+// Every instantiation has its own pool on each thread. Tasks use the one behind `Alloc` & `Free`
+// below. Coroutine frames use another one, with larger size classes (see coroutine.cc).
+template <size_t kGranularity, size_t kSizeClasses, int kMaxFreeBlocks>
+struct ThreadPool {
+  using Blocks = SizeClassPool<kGranularity, kSizeClasses>;
+
+  static void* Alloc(size_t size) {
+    auto& state = State();
+    size_t size_class = Blocks::SizeClass(size);
+    if (size_class >= kSizeClasses || state.destroyed) {
+      return ::operator new(size);
+    }
+    if (void* block = state.blocks.Pop(size_class)) {
+      ++state.stats.reused;
+      return block;
+    }
+    ++state.stats.allocated;
+    // Round up so that the block can be reused by anything from the same size class.
+    return ::operator new(Blocks::BlockSize(size_class));
+  }
+
+  static void Free(void* ptr, size_t size) {
+    if (ptr == nullptr) {
+      return;
+    }
+    auto& state = State();
+    size_t size_class = Blocks::SizeClass(size);
+    if (size_class >= kSizeClasses || state.destroyed ||
+        state.blocks.FreeCount(size_class) >= kMaxFreeBlocks) {
+      if (size_class < kSizeClasses) {
+        ++state.stats.released;
+      }
+      ::operator delete(ptr);
+      return;
+    }
+    state.blocks.Push(ptr, size_class);
+  }
+
+  // Statistics of the current thread.
+  static Stats& ThreadStats() { return State().stats; }
+
+ private:
+  static ThreadState<kGranularity, kSizeClasses>& State() {
+    static thread_local ThreadState<kGranularity, kSizeClasses> state;
+    return state;
+  }
+};
+
+void* Alloc(size_t size);
+void Free(void* ptr, size_t size);
+
+// Statistics of the current thread.
+Stats& ThreadStats();
+
+}  // namespace automat::task_pool
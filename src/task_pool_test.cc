@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "task_pool.hh"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace automat;
+
+TEST(TaskPoolTest, ReusesBlocksOfTheSameSizeClass) {
+  auto& stats = task_pool::ThreadStats();
+  void* a = task_pool::Alloc(40);
+  task_pool::Free(a, 40);
+  uint64_t reused_before = stats.reused;
+  // 40 & 48 bytes fall into the same 16-byte size class.
+  void* b = task_pool::Alloc(48);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(reused_before + 1, stats.reused);
+  // Blocks from other size classes are not mixed.
+  void* c = task_pool::Alloc(100);
+  EXPECT_NE(b, c);
+  task_pool::Free(b, 48);
+  task_pool::Free(c, 100);
+}
+
+TEST(TaskPoolTest, LargeBlocksBypassThePool) {
+  auto& stats = task_pool::ThreadStats();
+  uint64_t allocated_before = stats.allocated;
+  void* large = task_pool::Alloc(4096);
+  task_pool::Free(large, 4096);
+  EXPECT_EQ(allocated_before, stats.allocated);
+}
+
+// Blocks released on another thread end up on the free list of that thread.
+TEST(TaskPoolTest, FreeOnAnotherThread) {
+  void* block = task_pool::Alloc(64);
+  uint64_t main_reused_before = task_pool::ThreadStats().reused;
+  void* reused_by_other = nullptr;
+  uint64_t other_reused = 0;
+  std::thread([&] {
+    task_pool::Free(block, 64);
+    reused_by_other = task_pool::Alloc(64);
+    other_reused = task_pool::ThreadStats().reused;
+    task_pool::Free(reused_by_other, 64);
+    // The pool of this thread releases the block when the thread exits.
+  }).join();
+  EXPECT_EQ(block, reused_by_other);
+  EXPECT_EQ(1, other_reused);
+  EXPECT_EQ(main_reused_before, task_pool::ThreadStats().reused);
+}
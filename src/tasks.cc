@@ -2,30 +2,167 @@
 // SPDX-License-Identifier: MIT
 #include "tasks.hh"
 
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "audio.hh"
 #include "base.hh"
+#include "dataflow.hh"
+#include "executor.hh"
+#include "task_pool.hh"
 #include "time.hh"
 
 using namespace maf;
 
 namespace automat {
 
-Task::Task(Location* target) : target(target), predecessors(), successors(global_successors) {
-  for (Task* successor : successors) {
-    successor->predecessors.push_back(this);
+namespace {
+
+// Mutexes guarding the links between the SuccessorLists & their tasks. Each task is guarded by one
+// of them, picked by its address, so that unrelated tasks rarely contend.
+constexpr int kTaskMutexes = 64;
+struct alignas(64) TaskMutex {
+  std::mutex mutex;
+};
+TaskMutex task_mutexes[kTaskMutexes];
+
+// Calls `f` for the task of every node that wasn't destroyed yet, while holding its mutex.
+template <typename F>
+void ForEachTask(SuccessorList* list, F&& f) {
+  for (auto* node = list; node; node = node->next) {
+    Task* task = node->task.load(std::memory_order_acquire);
+    if (task == nullptr) {
+      continue;
+    }
+    std::lock_guard lock(SuccessorList::MutexFor(task));
+    // The task may have been destroyed before the mutex was taken.
+    if (node->task.load(std::memory_order_relaxed) == task) {
+      f(*task);
+    }
+  }
+}
+
+}  // namespace
+
+std::mutex& SuccessorList::MutexFor(Task* task) {
+  return task_mutexes[(reinterpret_cast<uintptr_t>(task) >> 6) % kTaskMutexes].mutex;
+}
+
+SuccessorList::SuccessorList(Task* task, SuccessorList* next) : task(task), next(next) {
+  std::lock_guard lock(MutexFor(task));
+  next_for_task = task->referenced_by.load(std::memory_order_relaxed);
+  task->referenced_by.store(this, std::memory_order_release);
+}
+
+SuccessorList::~SuccessorList() {
+  Task* t = task.load(std::memory_order_acquire);
+  if (t == nullptr) {
+    return;
+  }
+  std::lock_guard lock(MutexFor(t));
+  if (task.load(std::memory_order_relaxed) != t) {
+    return;  // the task was destroyed in the meantime
+  }
+  SuccessorList* head = t->referenced_by.load(std::memory_order_relaxed);
+  if (head == this) {
+    t->referenced_by.store(next_for_task, std::memory_order_release);
+    return;
+  }
+  for (auto* node = head; node; node = node->next_for_task) {
+    if (node->next_for_task == this) {
+      node->next_for_task = next_for_task;
+      return;
+    }
+  }
+}
+
+SuccessorList* SuccessorList::Acquire(SuccessorList* list) {
+  if (list) {
+    list->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  return list;
+}
+
+void SuccessorList::Release(SuccessorList* list) {
+  while (list && list->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete std::exchange(list, list->next);
+  }
+}
+
+void SuccessorList::AddPredecessor(SuccessorList* list) {
+  ForEachTask(list, [](Task& task) {
+    task.pending_predecessors.fetch_add(1, std::memory_order_relaxed);
+  });
+}
+
+void SuccessorList::PredecessorFinished(SuccessorList* list) {
+  for (auto* node = list; node; node = node->next) {
+    Task* task = node->task.load(std::memory_order_acquire);
+    if (task == nullptr) {
+      continue;
+    }
+    {
+      std::lock_guard lock(MutexFor(task));
+      if (node->task.load(std::memory_order_relaxed) != task ||
+          task->pending_predecessors.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        continue;
+      }
+      // Keeps the task alive until it's scheduled (see `~Task`).
+      task->schedulers.fetch_add(1, std::memory_order_relaxed);
+    }
+    task->Schedule();
+    task->schedulers.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+Task::Task(Location* target)
+    : target(target),
+      target_incarnation(target ? target->incarnation : 0),
+      successors(SuccessorList::Acquire(global_successors)) {
+  SuccessorList::AddPredecessor(successors);
+}
+
+Task::~Task() {
+  // Nodes may only be added by the owners of live tasks so when there are none, there is no need
+  // to lock.
+  if (referenced_by.load(std::memory_order_acquire)) {
+    {
+      std::lock_guard lock(SuccessorList::MutexFor(this));
+      SuccessorList* node = referenced_by.exchange(nullptr, std::memory_order_relaxed);
+      while (node) {
+        node->task.store(nullptr, std::memory_order_relaxed);
+        node = std::exchange(node->next_for_task, nullptr);
+      }
+    }
+    // Predecessors that found this task ready may still be scheduling it. No new ones can start.
+    while (schedulers.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
   }
+  SuccessorList::Release(successors);
 }
 
+void* Task::operator new(std::size_t size) { return task_pool::Alloc(size); }
+
+void Task::operator delete(void* ptr, std::size_t size) { task_pool::Free(ptr, size); }
+
 void Task::Schedule() {
   if (NoScheduling(target)) {
     return;
   }
+  if (executor::OnWorkerThread()) {
+    executor::ScheduleFromWorker(*this);
+    return;
+  }
   if (log_executed_tasks) {
     LOG << "Scheduling " << Format();
   }
-  assert(!scheduled);
-  scheduled = true;
-  queue.emplace_back(this);
+  [[maybe_unused]] bool was_scheduled = scheduled.exchange(true, std::memory_order_acq_rel);
+  assert(!was_scheduled);
+  queue.Push(this, queue.LaneFor(*this));
 }
 
 void Task::PreExecute() {
@@ -33,39 +170,163 @@ void Task::PreExecute() {
     LOG << Format();
     LOG_Indent();
   }
-  if (!successors.empty()) {
+  if (successors) {
     global_successors = successors;
   }
 }
 
 void Task::PostExecute() {
-  if (!global_successors.empty()) {
+  if (successors) {
     assert(global_successors == successors);
-    global_successors.clear();
-    for (Task* successor : successors) {
-      auto& pred = successor->predecessors;
-      auto it = std::find(pred.begin(), pred.end(), this);
-      assert(it != pred.end());
-      pred.erase(it);
-      if (pred.empty()) {
-        successor->Schedule();
-      }
-    }
+    global_successors = nullptr;
+    ReleaseSuccessors();
   }
   if (log_executed_tasks) {
     LOG_Unindent();
   }
 }
 
+void Task::ReleaseSuccessors() {
+  // Dependencies are fulfilled only once. Tasks that are executed again (like RunTask) don't
+  // notify their old successors.
+  SuccessorList* list = std::exchange(successors, nullptr);
+  SuccessorList::PredecessorFinished(list);
+  SuccessorList::Release(list);
+}
+
+void Task::PredecessorFinished() {
+  if (pending_predecessors.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    Schedule();
+  }
+}
+
 std::string Task::Format() { return "Task()"; }
 
+const char* PriorityName(Priority priority) {
+  switch (priority) {
+    case Priority::Input:
+      return "input";
+    case Priority::Timer:
+      return "timer";
+    case Priority::Dataflow:
+      return "dataflow";
+  }
+  return "unknown";
+}
+
+void TaskQueue::Push(Task* task, Priority lane) {
+  lanes[(int)lane].push_back({task, time::SteadyClock::now()});
+}
+
+Priority TaskQueue::LaneFor(const Task& task) const { return std::min(task.priority, current); }
+
+void TaskQueue::Promote(Task* task, Priority from, Priority to) {
+  assert(to < from);
+  auto& lane = lanes[(int)from];
+  auto it = std::find_if(lane.begin(), lane.end(), [&](const Entry& e) { return e.task == task; });
+  if (it == lane.end()) {
+    return;
+  }
+  Entry entry = *it;
+  lane.erase(it);
+  lanes[(int)to].push_back(entry);
+}
+
+Task* TaskQueue::Pop(Priority* lane_out) {
+  int lane = 0;
+  while (lane < kPriorities && lanes[lane].empty()) {
+    ++lane;
+  }
+  if (lane == kPriorities) {
+    return nullptr;
+  }
+  for (int lower = kPriorities - 1; lower > lane; --lower) {
+    if (passed_over[lower] >= kStarvationLimit && !lanes[lower].empty()) {
+      lane = lower;
+      break;
+    }
+  }
+  for (int lower = lane + 1; lower < kPriorities; ++lower) {
+    passed_over[lower] = lanes[lower].empty() ? 0 : passed_over[lower] + 1;
+  }
+  passed_over[lane] = 0;
+  Entry entry = lanes[lane].front();
+  lanes[lane].pop_front();
+  auto waited = time::SteadyClock::now() - entry.enqueued;
+  latency[lane].Add(std::chrono::duration<double, std::micro>(waited).count());
+  if (lane_out) {
+    *lane_out = (Priority)lane;
+  }
+  return entry.task;
+}
+
+void TaskQueue::Remove(Location& target) {
+  std::vector<Task*> removed;
+  // Released successors may be scheduled right away - possibly for the same target - so this is
+  // repeated until no task is left.
+  do {
+    removed.clear();
+    for (auto& lane : lanes) {
+      std::erase_if(lane, [&](const Entry& entry) {
+        if (entry.task->target != &target) {
+          return false;
+        }
+        removed.push_back(entry.task);
+        return true;
+      });
+    }
+    for (Task* task : removed) {
+      task->scheduled = false;
+      task->ReleaseSuccessors();
+    }
+  } while (!removed.empty());
+}
+
+bool TaskQueue::empty() const {
+  for (auto& lane : lanes) {
+    if (!lane.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t TaskQueue::size() const {
+  size_t n = 0;
+  for (auto& lane : lanes) {
+    n += lane.size();
+  }
+  return n;
+}
+
+void TaskQueue::ResetLatency() {
+  for (auto& histogram : latency) {
+    histogram = LatencyHistogram();
+  }
+}
+
+static bool TargetIsThreadSafe(Location* target) {
+  return target && target->ThisAs<ThreadSafe>() != nullptr;
+}
+
 std::string RunTask::Format() { return f("RunTask(%s)", target->ToStr().c_str()); }
 
 void ScheduleNext(Location& source) {
   audio::Play(source.object->NextSound());
-  source.last_finished = time::SteadyClock::now();
+  source.last_finished = time::SteadyNow();
   // TODO: maybe there is a better way to do this...
-  next_arg.InvalidateConnectionWidgets(source);  // so that the "next" connection flashes
+  if (executor::OnWorkerThread()) {
+    // Connection widgets belong to the Automat thread. The flash doesn't take part in the
+    // dependencies of the current task.
+    auto* old_global_successors = std::exchange(global_successors, nullptr);
+    auto flash = std::make_unique<FunctionTask>(
+        &source, [](Location& here) { next_arg.InvalidateConnectionWidgets(here); });
+    global_successors = old_global_successors;
+    flash->priority = Priority::Input;
+    events.send(std::move(flash));
+  } else {
+    next_arg.InvalidateConnectionWidgets(source);  // so that the "next" connection flashes
+  }
 
   next_arg.LoopLocations<bool>(source, [](Location& next) {
     next.ScheduleRun();
@@ -73,6 +334,8 @@ void ScheduleNext(Location& source) {
   });
 }
 
+bool RunTask::IsThreadSafe() { return TargetIsThreadSafe(target); }
+
 void RunTask::Execute() {
   PreExecute();
   target->Run();
@@ -93,7 +356,25 @@ std::string UpdateTask::Format() {
   return f("UpdateTask(%s, %s)", target->ToStr().c_str(), updated->ToStr().c_str());
 }
 
+bool UpdateTask::IsThreadSafe() { return TargetIsThreadSafe(target); }
+
+uint64_t coalesced_updates = 0;
+
 void UpdateTask::Execute() {
+  if (leads_wave) {
+    PreExecute();
+    dataflow::ExecuteWave(*this);
+    PostExecute();
+    delete this;
+    return;
+  }
+  if (coalescing) {
+    // From now on, new updates must be delivered by a new task.
+    auto& pending = target->pending_updates;
+    auto it = std::find(pending.begin(), pending.end(), this);
+    assert(it != pending.end());
+    pending.erase(it);
+  }
   PreExecute();
   target->Updated(*updated);
   PostExecute();
@@ -112,6 +393,8 @@ std::string ErroredTask::Format() {
   return f("ErroredTask(%s, %s)", target->ToStr().c_str(), errored->ToStr().c_str());
 }
 
+bool ErroredTask::IsThreadSafe() { return TargetIsThreadSafe(target); }
+
 void ErroredTask::Execute() {
   PreExecute();
   target->Errored(*errored);
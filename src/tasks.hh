@@ -2,35 +2,165 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <mutex>
 #include <string>
-#include <vector>
+
+#include "latency_histogram.hh"
+#include "time.hh"
 
 namespace automat {
 
 struct Location;
+struct Task;
+
+// Immutable, reference-counted list of tasks that wait for other tasks to finish.
+//
+// A single list is shared by the task that owns it, by all of the tasks spawned while that task
+// executes (through `global_successors`) and by `NextGuard`s, so it's never copied. Each node holds
+// a reference to the next one so lists may share their tails. Reference counting is atomic so lists
+// may be passed between the executor's threads.
+//
+// Each task knows the nodes that point at it (see `Task::referenced_by`) so that it can unlink
+// itself from all of them when it's destroyed. The links between a task & its nodes are guarded by
+// the task's own mutex (see `MutexFor`) - there is no global lock.
+struct SuccessorList {
+  std::atomic<int> refs = 1;
+  // Cleared when the task is destroyed.
+  std::atomic<Task*> task;
+  SuccessorList* next;
+  // Next node that points at the same task. Guarded by `MutexFor(task)`.
+  SuccessorList* next_for_task = nullptr;
+
+  SuccessorList(Task* task, SuccessorList* next = nullptr);
+  ~SuccessorList();
+
+  // All of the functions below accept `nullptr`. `Acquire` returns its argument.
+  static SuccessorList* Acquire(SuccessorList*);
+  static void Release(SuccessorList*);
+  // Adds a pending predecessor to every task of the list.
+  static void AddPredecessor(SuccessorList*);
+  // Tells every task of the list that one of its predecessors has finished. Tasks that become ready
+  // are scheduled outside of their mutexes.
+  static void PredecessorFinished(SuccessorList*);
+
+  // Mutex that guards `task`, `next_for_task` & `Task::referenced_by` of the given task. Tasks share
+  // a small, fixed set of mutexes.
+  static std::mutex& MutexFor(Task*);
+};
 
 // Schedules all of the Locations pointed by the "next" argument from the "source" Location.
 void ScheduleNext(Location& source);
 
+// Lanes of the task queue, from the most urgent one. See `TaskQueue`.
+enum class Priority : uint8_t {
+  Input,     // user input & UI, sent through `RunOnAutomatThread`
+  Timer,     // timers that fired
+  Dataflow,  // everything else - runs, updates & errors caused by other tasks
+};
+constexpr int kPriorities = 3;
+const char* PriorityName(Priority);
+
 struct Task {
   Location* target;
-  std::vector<Task*> predecessors;
-  std::vector<Task*> successors;
-  bool scheduled = false;
+  // `Location::incarnation` of the target. Tasks sent through `events` may arrive after their target
+  // was destroyed (and its memory reused) - this is how they're recognized.
+  uint64_t target_incarnation;
+  // Join counter - number of tasks (and `NextGuard`s) that must finish before this task is
+  // scheduled.
+  std::atomic<int> pending_predecessors = 0;
+  // Tasks that wait for this task (and all of the tasks that it spawns) to finish. Released in
+  // `PostExecute` (or when the task is removed from the queue).
+  SuccessorList* successors;
+  // Nodes of the SuccessorLists that point at this task. Modified under
+  // `SuccessorList::MutexFor(this)`.
+  std::atomic<SuccessorList*> referenced_by = nullptr;
+  // Number of threads that are scheduling this task after its last predecessor finished. The
+  // destructor waits for them.
+  std::atomic<int> schedulers = 0;
+  // Set while the task waits in one of the queues. Persistent tasks (like `Location::run_task`) may
+  // be scheduled by several worker threads at once so it's claimed with an atomic exchange.
+  std::atomic<bool> scheduled = false;
+  // Lane of the task queue. Tasks scheduled while a more urgent task executes go to its lane
+  // instead, so that actions triggered by a key press aren't delayed by the background work. This
+  // only works for one hop - tasks scheduled by such actions go to their own lane again.
+  Priority priority = Priority::Dataflow;
   Task(Location* target);
-  virtual ~Task() {}
+  virtual ~Task();
+
+  // Most tasks are short-lived so they're allocated from a per-thread pool. See task_pool.hh.
+  static void* operator new(std::size_t size);
+  static void operator delete(void* ptr, std::size_t size);
+
   // Add this task to the task queue.
   void Schedule();
   void PreExecute();
   void PostExecute();
+  // Lets the successors of this task proceed without executing it. Used when the task is dropped.
+  void ReleaseSuccessors();
+
+  // Called by predecessors when they finish. Schedules the task once all of them are done.
+  void PredecessorFinished();
   virtual std::string Format();
   virtual void Execute() = 0;
+
+  // Task that is recorded by the tracer (see trace.hh) when this one executes. Tasks that only wrap
+  // other tasks return the wrapped one.
+  virtual Task& Traced() { return *this; }
+
+  // Whether this task may be executed on one of the executor's worker threads. See executor.hh.
+  virtual bool IsThreadSafe() { return false; }
+};
+
+// Queue of the tasks waiting for the Automat thread.
+//
+// Tasks are kept in separate FIFO lanes (one for each `Priority`). The most urgent non-empty lane
+// is served first. To avoid starvation, a lane that was passed over `kStarvationLimit` times in a
+// row is served before the more urgent lanes.
+//
+// The time that each task spends in the queue is recorded in the per-lane `latency` histograms.
+//
+// Not thread-safe. Other threads send their tasks through `events`.
+struct TaskQueue {
+  static constexpr int kStarvationLimit = 16;
+
+  struct Entry {
+    Task* task;
+    time::SteadyClock::time_point enqueued;
+  };
+  std::deque<Entry> lanes[kPriorities];
+  // Number of tasks executed from the more urgent lanes while this lane was waiting.
+  int passed_over[kPriorities] = {};
+  LatencyHistogram latency[kPriorities];
+  // Lane that newly scheduled tasks inherit. It's the lane of the currently executing task, unless
+  // that task inherited its lane itself (see `Task::priority`).
+  Priority current = Priority::Dataflow;
+
+  void Push(Task*, Priority);
+  void Push(Task* task) { Push(task, task->priority); }
+  // Lane that `Task::Schedule` puts the task in.
+  Priority LaneFor(const Task&) const;
+  // Moves a task that waits in the lane `from` to the back of the more urgent lane `to`. The time
+  // that it already spent in the queue still counts towards its latency.
+  void Promote(Task*, Priority from, Priority to);
+  // Returns nullptr when the queue is empty.
+  Task* Pop(Priority* lane = nullptr);
+  // Drops the tasks targeting the given Location (without deleting them). Their successors are
+  // released.
+  void Remove(Location& target);
+  bool empty() const;
+  size_t size() const;
+  void ResetLatency();
 };
 
 struct RunTask : Task {
   RunTask(Location* target) : Task(target) {}
   std::string Format() override;
+  bool IsThreadSafe() override;
   void Execute() override;
 };
 
@@ -40,10 +170,21 @@ struct CancelTask : Task {
   void Execute() override;
 };
 
+// Number of UpdateTasks that were dropped because an identical task was already pending. Updates
+// merged into a dataflow wave are counted separately (see `dataflow::Stats`).
+extern uint64_t coalesced_updates;
+
 struct UpdateTask : Task {
   Location* updated;
+  // Whether this task is registered in the `pending_updates` of its target.
+  bool coalescing = false;
+  // Lane of the task queue that a coalescing task waits in.
+  Priority lane = Priority::Dataflow;
+  // Whether this task delivers a whole wave of updates instead. See dataflow.hh.
+  bool leads_wave = false;
   UpdateTask(Location* target, Location* updated) : Task(target), updated(updated) {}
   std::string Format() override;
+  bool IsThreadSafe() override;
   void Execute() override;
 };
 
@@ -59,6 +200,7 @@ struct ErroredTask : Task {
   Location* errored;
   ErroredTask(Location* target, Location* errored) : Task(target), errored(errored) {}
   std::string Format() override;
+  bool IsThreadSafe() override;
   void Execute() override;
 };
 
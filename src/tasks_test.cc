@@ -0,0 +1,172 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "tasks.hh"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "base.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+struct NopTask : Task {
+  NopTask() : Task(nullptr) {}
+  void Execute() override {}
+};
+
+TEST(TaskQueueTest, UrgentLanesFirst) {
+  TaskQueue queue;
+  NopTask input, timer, dataflow;
+  queue.Push(&dataflow, Priority::Dataflow);
+  queue.Push(&timer, Priority::Timer);
+  queue.Push(&input, Priority::Input);
+  EXPECT_EQ(3, queue.size());
+  Priority lane;
+  EXPECT_EQ(&input, queue.Pop(&lane));
+  EXPECT_EQ(Priority::Input, lane);
+  EXPECT_EQ(&timer, queue.Pop(&lane));
+  EXPECT_EQ(Priority::Timer, lane);
+  EXPECT_EQ(&dataflow, queue.Pop(&lane));
+  EXPECT_EQ(Priority::Dataflow, lane);
+  EXPECT_EQ(nullptr, queue.Pop());
+  EXPECT_TRUE(queue.empty());
+  for (auto& histogram : queue.latency) {
+    EXPECT_EQ(1, histogram.count);
+  }
+}
+
+TEST(TaskQueueTest, LowerLanesDontStarve) {
+  TaskQueue queue;
+  NopTask background;
+  NopTask input[100];
+  queue.Push(&background, Priority::Dataflow);
+  for (auto& task : input) {
+    queue.Push(&task, Priority::Input);
+  }
+  int position = 0;
+  while (queue.Pop() != &background) {
+    ++position;
+  }
+  EXPECT_EQ(TaskQueue::kStarvationLimit, position);
+}
+
+struct TasksTest : TestBase {
+  static constexpr int kBackground = 1000;
+  int executed = 0;
+  std::vector<std::unique_ptr<FunctionTask>> background;
+
+  TasksTest() {
+    for (int i = 0; i < kBackground; ++i) {
+      background.emplace_back(new FunctionTask(&root, [this](Location&) { ++executed; }));
+      background.back()->Schedule();
+    }
+  }
+};
+
+// Input arrives from another thread while the Automat thread is busy with background work.
+TEST_F(TasksTest, InputOvertakesBackgroundWork) {
+  int input_position = -1;
+  int action_position = -1;
+  FunctionTask action(&root, [&](Location&) { action_position = executed; });
+  auto input = std::make_unique<FunctionTask>(&root, [&](Location&) {
+    input_position = executed;
+    action.Schedule();  // inherits the lane of the input
+  });
+  input->priority = Priority::Input;
+  events.send(std::move(input));
+  RunLoop();
+  EXPECT_EQ(kBackground, executed);
+  EXPECT_EQ(0, input_position);
+  EXPECT_EQ(0, action_position);
+  EXPECT_EQ(Priority::Dataflow, action.priority);
+  EXPECT_EQ(Priority::Dataflow, queue.current);
+}
+
+// Lanes are inherited for one hop only. Work caused by the action waits for the background work.
+TEST_F(TasksTest, LaneIsInheritedOnce) {
+  int action_position = -1;
+  int followup_position = -1;
+  FunctionTask followup(&root, [&](Location&) { followup_position = executed; });
+  FunctionTask action(&root, [&](Location&) {
+    action_position = executed;
+    followup.Schedule();
+  });
+  auto input = std::make_unique<FunctionTask>(&root, [&](Location&) { action.Schedule(); });
+  input->priority = Priority::Input;
+  events.send(std::move(input));
+  RunLoop();
+  EXPECT_EQ(0, action_position);
+  EXPECT_EQ(kBackground, followup_position);
+}
+
+struct EventsTest : TestBase {};
+
+// Tasks that were on their way through `events` when their target was destroyed are dropped. The
+// order of the remaining tasks is preserved.
+TEST_F(EventsTest, TasksOfDestroyedTargetsAreDropped) {
+  std::vector<int> order;
+  auto doomed = std::make_unique<Location>(&root);
+  events.send(std::make_unique<FunctionTask>(&root, [&](Location&) { order.push_back(1); }));
+  events.send(std::make_unique<FunctionTask>(doomed.get(), [&](Location&) { order.push_back(2); }));
+  events.send(std::make_unique<FunctionTask>(&root, [&](Location&) { order.push_back(3); }));
+  doomed.reset();
+  EXPECT_EQ(3, events.size());
+  RunLoop();
+  EXPECT_EQ((std::vector<int>{1, 3}), order);
+  EXPECT_TRUE(dead_targets.empty());
+}
+
+// Task that was taken by another thread before its target was destroyed, but sent only after
+// `events` was drained, is still dropped.
+TEST_F(EventsTest, TombstonesWaitForSendsInFlight) {
+  int executed = 0;
+  auto doomed = std::make_unique<Location>(&root);
+  auto sending = std::make_unique<SendGuard>();
+  auto late = std::make_unique<FunctionTask>(doomed.get(), [&](Location&) { ++executed; });
+  doomed.reset();
+  RunLoop();
+  EXPECT_EQ(1, dead_targets.size());
+  events.send(std::move(late));
+  sending.reset();
+  RunLoop();
+  EXPECT_EQ(0, executed);
+  EXPECT_TRUE(dead_targets.empty());
+}
+
+// Successor that is destroyed before its predecessors finish is unlinked from their lists.
+TEST_F(EventsTest, DestroyedSuccessorIsUnlinked) {
+  int executed = 0;
+  auto waiting = std::make_unique<FunctionTask>(&root, [&](Location&) { ++executed; });
+  std::unique_ptr<FunctionTask> spawned;
+  {
+    NextGuard next_guard({waiting.get()});
+    spawned = std::make_unique<FunctionTask>(&root, [&](Location&) { ++executed; });
+  }
+  EXPECT_EQ(1, waiting->pending_predecessors.load());
+  EXPECT_NE(nullptr, waiting->referenced_by.load());
+  waiting.reset();
+  spawned->Schedule();
+  RunLoop();
+  EXPECT_EQ(1, executed);
+}
+
+// Tasks removed from the queue (because their target was destroyed) let their successors run.
+TEST_F(EventsTest, RemovedTaskReleasesSuccessors) {
+  int successor_runs = 0;
+  FunctionTask successor(&root, [&](Location&) { ++successor_runs; });
+  auto doomed = std::make_unique<Location>(&root);
+  std::unique_ptr<FunctionTask> removed;
+  {
+    NextGuard next_guard({&successor});
+    removed = std::make_unique<FunctionTask>(doomed.get(), [](Location&) {});
+    removed->Schedule();
+  }
+  EXPECT_EQ(1, successor.pending_predecessors.load());
+  doomed.reset();
+  EXPECT_EQ(0, successor.pending_predecessors.load());
+  RunLoop();
+  EXPECT_EQ(1, successor_runs);
+}
@@ -4,6 +4,43 @@
 
 namespace automat::time {
 
+std::atomic<bool> virtual_time = false;
+std::atomic<T> virtual_now = 0;
+std::atomic<T> steady_offset = 0;
+
+void EnableVirtualTime() {
+  if (VirtualTimeEnabled()) {
+    return;
+  }
+  virtual_now = SteadyNow().time_since_epoch().count();
+  virtual_time = true;
+}
+
+void DisableVirtualTime() {
+  if (!VirtualTimeEnabled()) {
+    return;
+  }
+  Duration offset = SteadyPoint(Duration(virtual_now)) - SteadyPoint(SteadyClock::now());
+  if (offset > SteadyOffset()) {
+    steady_offset = offset.count();
+  }
+  virtual_time = false;
+}
+
+void AdvanceVirtualTime(SteadyPoint time) {
+  T new_now = time.time_since_epoch().count();
+  T old_now = virtual_now.load(std::memory_order_relaxed);
+  while (old_now < new_now &&
+         !virtual_now.compare_exchange_weak(old_now, new_now, std::memory_order_relaxed)) {
+  }
+}
+
+void ResetClock() {
+  virtual_time = false;
+  virtual_now = 0;
+  steady_offset = 0;
+}
+
 SystemPoint SystemFromSteady(SteadyPoint steady) { return SystemNow() + (steady - SteadyNow()); }
 SteadyPoint SteadyFromSystem(SystemPoint system) { return SteadyNow() + (system - SystemNow()); }
 
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <atomic>
 #include <chrono>
 
 namespace automat::time {
@@ -15,8 +16,41 @@ using SteadyPoint = std::chrono::time_point<SteadyClock, Duration>;
 
 constexpr SystemPoint kZero = {};
 
+// Virtual time.
+//
+// `SteadyNow` is the clock of the whole runtime (timers, Timeline, TimerDelay, etc.). Normally it
+// follows the SteadyClock. When virtual time is enabled, it stops and moves forward only through
+// `AdvanceVirtualTime`. The timer thread does this by jumping straight to the next deadline whenever
+// the Automat thread runs out of work (see `JumpToNextTimer` in timer_thread.hh). This allows
+// long schedules to be simulated much faster than in real time.
+//
+// The clock never goes back. Once virtual time is disabled, `SteadyNow` continues from the last
+// virtual time point.
+void EnableVirtualTime();
+void DisableVirtualTime();
+// Moves the virtual clock forward. Earlier time points are ignored.
+void AdvanceVirtualTime(SteadyPoint);
+
+// Disables virtual time & moves `SteadyNow` back to the SteadyClock. This breaks the guarantee that
+// the clock never goes back so it's only meant for tests. See also `ResetTimers`.
+void ResetClock();
+
+extern std::atomic<bool> virtual_time;
+extern std::atomic<T> virtual_now;    // seconds since the SteadyClock epoch
+extern std::atomic<T> steady_offset;  // seconds between `SteadyNow` & the SteadyClock
+
+inline bool VirtualTimeEnabled() { return virtual_time.load(std::memory_order_relaxed); }
+
+// Difference between `SteadyNow` & the SteadyClock. Used to wait for deadlines in real time.
+inline Duration SteadyOffset() { return Duration(steady_offset.load(std::memory_order_relaxed)); }
+
 inline SystemPoint SystemNow() { return SystemClock::now(); }
-inline SteadyPoint SteadyNow() { return SteadyClock::now(); }
+inline SteadyPoint SteadyNow() {
+  if (VirtualTimeEnabled()) {
+    return SteadyPoint(Duration(virtual_now.load(std::memory_order_relaxed)));
+  }
+  return SteadyPoint(SteadyClock::now()) + SteadyOffset();
+}
 
 SystemPoint SystemFromSteady(SteadyPoint steady);
 SteadyPoint SteadyFromSystem(SystemPoint system);
@@ -2,14 +2,24 @@
 // SPDX-License-Identifier: MIT
 #include "timer_thread.hh"
 
+#include <algorithm>
+#include <cmath>
 #include <condition_variable>
-#include <map>
 #include <thread>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
 
 #include "base.hh"
 #include "tasks.hh"
 #include "thread_name.hh"
 #include "time.hh"
+#include "timing_wheel.hh"
 
 namespace automat {
 
@@ -19,7 +29,164 @@ static std::jthread timer_thread;
 static std::mutex mtx;
 static std::condition_variable cv;
 
-static std::multimap<SteadyPoint, std::unique_ptr<Task>> tasks;
+// Deadlines are rounded up to the nearest tick.
+constexpr Duration kTickDuration = std::chrono::microseconds(10);
+
+// In high precision mode, the timer thread busy-waits for this long before each deadline.
+constexpr Duration kSpinDuration = std::chrono::microseconds(200);
+
+static bool high_precision = false;  // protected by mtx
+
+static std::mutex jitter_mtx;
+static TimerJitter jitter;  // protected by jitter_mtx
+
+#if defined(__linux__)
+static int timer_fd = -1;
+static int wake_fd = -1;  // eventfd used to interrupt the `poll` in `WaitPrecise`
+#endif
+
+// Must be called with `mtx` locked.
+static void Wake() {
+  cv.notify_all();
+#if defined(__linux__)
+  if (wake_fd != -1) {
+    uint64_t one = 1;
+    (void)!write(wake_fd, &one, sizeof(one));
+  }
+#endif
+}
+
+static void SpinUntil(SteadyPoint deadline) {
+  while (SteadyClock::now() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+static TimingWheel::Tick TickFloor(SteadyPoint time) {
+  return std::floor(time.time_since_epoch() / kTickDuration);
+}
+
+static TimingWheel::Tick TickCeil(SteadyPoint time) {
+  return std::ceil(time.time_since_epoch() / kTickDuration);
+}
+
+static SteadyPoint TimeFromTick(TimingWheel::Tick tick) {
+  return SteadyPoint(tick * kTickDuration);
+}
+
+static void TimerFinished(Location& here, SteadyPoint scheduled_time) {
+  TimerNotificationReceiver* timer = here.As<TimerNotificationReceiver>();
+  if (timer == nullptr) {
+    ERROR << "Timer notification sent to an object which cannot receive it: " << here.Name();
+    return;
+  }
+  timer->OnTimerNotification(here, scheduled_time);
+}
+
+struct TimerFinishedTask : Task {
+  time::SteadyPoint scheduled_time;
+  TimerFinishedTask(Location* target, time::SteadyPoint scheduled_time)
+      : Task(target), scheduled_time(scheduled_time) {
+    priority = Priority::Timer;
+  }
+  std::string Format() override { return "TimerFinishedTask"; }
+  void Execute() override {
+    PreExecute();
+    TimerFinished(*target, scheduled_time);
+    PostExecute();
+  }
+};
+
+struct ScheduledTimer : TimingWheel::Entry {
+  SteadyPoint time;
+  std::unique_ptr<Task> task;
+  // Intrusive list of timers scheduled for the same Location.
+  ScheduledTimer* prev_here = nullptr;
+  ScheduledTimer* next_here = nullptr;
+};
+
+static TimingWheel wheel(TickFloor(SteadyNow()));
+
+// Index of the timers scheduled for each Location. Allows cancelling without scanning the wheel.
+static std::unordered_map<Location*, ScheduledTimer*> timers_by_location;
+
+static void Unindex(ScheduledTimer& timer) {
+  if (timer.prev_here) {
+    timer.prev_here->next_here = timer.next_here;
+  } else {
+    auto it = timers_by_location.find(timer.task->target);
+    if (timer.next_here) {
+      it->second = timer.next_here;
+    } else {
+      timers_by_location.erase(it);
+    }
+  }
+  if (timer.next_here) {
+    timer.next_here->prev_here = timer.prev_here;
+  }
+}
+
+static void Cancel(ScheduledTimer& timer) {
+  wheel.Remove(timer);
+  Unindex(timer);
+  delete &timer;
+}
+
+static ScheduledTimer* FindScheduledAt(Location& here, SteadyPoint time) {
+  auto it = timers_by_location.find(&here);
+  if (it == timers_by_location.end()) {
+    return nullptr;
+  }
+  for (ScheduledTimer* timer = it->second; timer; timer = timer->next_here) {
+    if (timer->time == time) {
+      return timer;
+    }
+  }
+  return nullptr;
+}
+
+// Sleeps until shortly before the `deadline` and then spins until it passes. Returns early when
+// woken up by `Wake`. Must be called with `mtx` locked.
+static void WaitPrecise(std::unique_lock<std::mutex>& lck, SteadyPoint deadline) {
+  SteadyPoint sleep_until = deadline - kSpinDuration;
+#if defined(__linux__)
+  itimerspec spec = {};
+  if (deadline != SteadyPoint::max()) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sleep_until.time_since_epoch());
+    // steady_clock is based on CLOCK_MONOTONIC, just like the timerfd. Zero would disarm it.
+    spec.it_value.tv_sec = std::max<int64_t>(ns.count(), 1) / 1'000'000'000;
+    spec.it_value.tv_nsec = std::max<int64_t>(ns.count(), 1) % 1'000'000'000;
+  }
+  timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+  lck.unlock();
+  pollfd fds[2] = {{.fd = timer_fd, .events = POLLIN}, {.fd = wake_fd, .events = POLLIN}};
+  poll(fds, 2, -1);
+  uint64_t n;
+  if (fds[1].revents & POLLIN) {
+    (void)!read(wake_fd, &n, sizeof(n));
+  } else if (fds[0].revents & POLLIN) {
+    (void)!read(timer_fd, &n, sizeof(n));
+    SpinUntil(deadline);
+  }
+  lck.lock();
+#else
+  if (deadline == SteadyPoint::max()) {
+    cv.wait(lck);
+  } else if (cv.wait_until(lck, sleep_until) == std::cv_status::timeout) {
+    lck.unlock();
+    SpinUntil(deadline);
+    lck.lock();
+  }
+#endif
+}
+
+// Must be called with `mtx` locked.
+static void Expire(TimingWheel::Entry& entry, deque<unique_ptr<Task>>& ready_tasks) {
+  auto& timer = static_cast<ScheduledTimer&>(entry);
+  Unindex(timer);
+  ready_tasks.emplace_back(std::move(timer.task));
+  delete &timer;
+}
 
 static void TimerThread(std::stop_token automat_stop_token) {
   SetThreadName("Timer");
@@ -27,37 +194,58 @@ static void TimerThread(std::stop_token automat_stop_token) {
   std::stop_callback on_automat_stop(automat_stop_token, [&] {
     std::unique_lock<std::mutex> lck(mtx);
     stop = true;
-    cv.notify_all();
+    Wake();
   });
 
   while (true) {
     std::unique_lock<std::mutex> lck(mtx);
-    if (tasks.empty()) {
+    auto next_tick = wheel.NextTick();
+    // Deadlines are expressed in `SteadyNow` time, which may be ahead of the SteadyClock.
+    SteadyPoint real_deadline = next_tick == TimingWheel::kNever
+                                    ? SteadyPoint::max()
+                                    : TimeFromTick(next_tick) - SteadyOffset();
+    if (VirtualTimeEnabled()) {
+      // Virtual time moves only through `JumpToNextTimer`. The timeout allows the thread to notice
+      // when virtual time is disabled.
+      cv.wait_for(lck, std::chrono::milliseconds(100));
+    } else if (high_precision) {
+      WaitPrecise(lck, real_deadline);
+    } else if (next_tick == TimingWheel::kNever) {
       // LOG << "Timer thread waiting";
       cv.wait(lck);
     } else {
-      // LOG << "Timer thread waiting until " << tasks.begin()->first.time_since_epoch().count()
-      //     << " (" << tasks.size() << " tasks)";
-      auto wake_time = tasks.begin()->first;
-      cv.wait_until(lck, wake_time);
+      // LOG << "Timer thread waiting until tick " << next_tick << " (" << wheel.Size()
+      //     << " tasks)";
+      cv.wait_until(lck, real_deadline);
     }
     if (stop) {
       break;
     }
+    // All of the timers that expired in the meantime are delivered in a single batch. Their
+    // Locations may be destroyed before the tasks are sent.
+    SendGuard sending;
     deque<unique_ptr<Task>> ready_tasks;
-    auto now = SteadyClock::now();
-    while (!tasks.empty() && tasks.begin()->first <= now) {
-      ready_tasks.emplace_back(std::move(tasks.begin()->second));
-      tasks.erase(tasks.begin());
-    }
+    wheel.Advance(TickFloor(SteadyNow()),
+                  [&](TimingWheel::Entry& entry) { Expire(entry, ready_tasks); });
 
     lck.unlock();
 
+    TimerJitter batch_jitter;
+    bool measure_jitter = !VirtualTimeEnabled();
     while (!ready_tasks.empty()) {
-      // LOG << "Timer thread executing task " << tasks.begin()->second->Format();
+      // LOG << "Timer thread executing task " << ready_tasks.front()->Format();
+      if (measure_jitter) {
+        auto* task = static_cast<TimerFinishedTask*>(ready_tasks.front().get());
+        Duration error = SteadyNow() - task->scheduled_time;
+        batch_jitter.Add(std::chrono::duration<double, std::micro>(error).count());
+      }
       events.send(std::move(ready_tasks.front()));
       ready_tasks.pop_front();
     }
+    if (batch_jitter.count) {
+      std::lock_guard<std::mutex> jitter_lck(jitter_mtx);
+      jitter.Add(batch_jitter);
+    }
   }
 }
 
@@ -66,73 +254,146 @@ void StartTimeThread(std::stop_token automat_stop_token) {
   timer_thread.detach();
 }
 
-static void TimerFinished(Location& here, SteadyPoint scheduled_time) {
-  TimerNotificationReceiver* timer = here.As<TimerNotificationReceiver>();
-  if (timer == nullptr) {
-    ERROR << "Timer notification sent to an object which cannot receive it: " << here.Name();
-    return;
+// Must be called with `mtx` locked.
+static void Schedule(Location& here, SteadyPoint time) {
+  auto* timer = new ScheduledTimer();
+  timer->time = time;
+  timer->task.reset(new TimerFinishedTask(&here, time));
+  auto& head = timers_by_location[&here];
+  if (head) {
+    head->prev_here = timer;
   }
-  timer->OnTimerNotification(here, scheduled_time);
+  timer->next_here = head;
+  head = timer;
+  wheel.Insert(*timer, TickCeil(time));
 }
 
-struct TimerFinishedTask : Task {
-  time::SteadyPoint scheduled_time;
-  TimerFinishedTask(Location* target, time::SteadyPoint scheduled_time)
-      : Task(target), scheduled_time(scheduled_time) {}
-  std::string Format() override { return "TimerFinishedTask"; }
-  void Execute() override {
-    PreExecute();
-    TimerFinished(*target, scheduled_time);
-    PostExecute();
-  }
-};
-
 void ScheduleAt(Location& here, SteadyPoint time) {
   std::unique_lock<std::mutex> lck(mtx);
-  tasks.emplace(time, new TimerFinishedTask(&here, time));
-  cv.notify_all();
+  Schedule(here, time);
+  Wake();
 }
 
 void CancelScheduledAt(Location& here) {
   std::unique_lock<std::mutex> lck(mtx);
-  for (auto it = tasks.begin(); it != tasks.end();) {
-    if (it->second->target == &here) {
-      it = tasks.erase(it);
-    } else {
-      ++it;
-    }
+  auto it = timers_by_location.find(&here);
+  if (it == timers_by_location.end()) {
+    return;
   }
-  cv.notify_all();
+  ScheduledTimer* timer = it->second;
+  timers_by_location.erase(it);
+  while (timer) {
+    ScheduledTimer* next = timer->next_here;
+    wheel.Remove(*timer);
+    delete timer;
+    timer = next;
+  }
+  Wake();
 }
 
 void CancelScheduledAt(Location& here, SteadyPoint time) {
   std::unique_lock<std::mutex> lck(mtx);
-  auto [a, b] = tasks.equal_range(time);
-  for (auto it = a; it != b; ++it) {
-    if (it->second->target == &here) {
-      tasks.erase(it);
-      break;
-    }
+  if (auto* timer = FindScheduledAt(here, time)) {
+    Cancel(*timer);
   }
-  cv.notify_all();
+  Wake();
 }
 
 void RescheduleAt(Location& here, SteadyPoint old_time, SteadyPoint new_time) {
   std::unique_lock<std::mutex> lck(mtx);
-  auto [a, b] = tasks.equal_range(old_time);
-  for (auto it = a; it != b; ++it) {
-    if (it->second->target == &here) {
-      tasks.erase(it);
-      break;
-    }
+  if (auto* timer = FindScheduledAt(here, old_time)) {
+    Cancel(*timer);
   }
-  if (new_time <= SteadyClock::now()) {
-    cv.notify_all();
+  if (new_time <= SteadyNow()) {
+    Wake();
     TimerFinished(here, new_time);
   } else {
-    tasks.emplace(new_time, new TimerFinishedTask(&here, new_time));
-    cv.notify_all();
+    Schedule(here, new_time);
+    Wake();
+  }
+}
+
+bool JumpToNextTimer() {
+  if (!VirtualTimeEnabled()) {
+    return false;
+  }
+  deque<unique_ptr<Task>> ready_tasks;
+  {
+    std::unique_lock<std::mutex> lck(mtx);
+    // `NextTick` may point at a cascade of a higher level of the wheel, so it may take a couple of
+    // steps to reach the actual deadline.
+    while (ready_tasks.empty() && !wheel.Empty()) {
+      auto next_tick = wheel.NextTick();
+      wheel.Advance(next_tick, [&](TimingWheel::Entry& entry) { Expire(entry, ready_tasks); });
+      AdvanceVirtualTime(TimeFromTick(next_tick));
+    }
+  }
+  if (ready_tasks.empty()) {
+    return false;
+  }
+  while (!ready_tasks.empty()) {
+    events.send(std::move(ready_tasks.front()));
+    ready_tasks.pop_front();
+  }
+  return true;
+}
+
+void ResetTimers() {
+  std::unique_lock<std::mutex> lck(mtx);
+  for (auto& [location, first] : timers_by_location) {
+    for (ScheduledTimer* timer = first; timer;) {
+      ScheduledTimer* next = timer->next_here;
+      wheel.Remove(*timer);
+      delete timer;
+      timer = next;
+    }
   }
+  timers_by_location.clear();
+  wheel = TimingWheel(TickFloor(SteadyNow()));
+  Wake();
+}
+
+int ScheduledTimerCount() {
+  std::unique_lock<std::mutex> lck(mtx);
+  return wheel.Size();
+}
+
+void SetHighPrecisionTimers(bool enabled) {
+  std::unique_lock<std::mutex> lck(mtx);
+#if defined(__linux__)
+  if (enabled && timer_fd == -1) {
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (timer_fd == -1 || wake_fd == -1) {
+      ERROR << "Couldn't create timerfd / eventfd for high precision timers";
+      if (timer_fd != -1) {
+        close(timer_fd);
+      }
+      if (wake_fd != -1) {
+        close(wake_fd);
+      }
+      timer_fd = wake_fd = -1;
+      return;
+    }
+  }
+#endif
+  high_precision = enabled;
+  Wake();
+}
+
+bool HighPrecisionTimers() {
+  std::unique_lock<std::mutex> lck(mtx);
+  return high_precision;
+}
+
+TimerJitter GetTimerJitter() {
+  std::lock_guard<std::mutex> lck(jitter_mtx);
+  return jitter;
+}
+
+void ResetTimerJitter() {
+  std::lock_guard<std::mutex> lck(jitter_mtx);
+  jitter = TimerJitter();
 }
 
 }  // namespace automat
\ No newline at end of file
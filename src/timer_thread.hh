@@ -4,6 +4,7 @@
 
 #include <stop_token>
 
+#include "latency_histogram.hh"
 #include "time.hh"
 
 namespace automat {
@@ -23,4 +24,29 @@ void CancelScheduledAt(Location&);
 void CancelScheduledAt(Location&, time::SteadyPoint);
 void RescheduleAt(Location& here, time::SteadyPoint old_time, time::SteadyPoint new_time);
 
+// Number of timers that haven't fired yet.
+int ScheduledTimerCount();
+
+// Virtual time only (see time.hh). Moves the clock to the next deadline & sends the timers that
+// expired to the Automat thread. Returns false if there are no timers or virtual time is disabled.
+bool JumpToNextTimer();
+
+// Cancels all of the timers & restarts the wheel at the current `SteadyNow`. Tests call it after
+// `time::ResetClock`, once the timer wheel was moved forward by virtual time.
+void ResetTimers();
+
+// By default the timer thread sleeps on a condition variable so timers may fire late by the
+// scheduler slack (usually around 1ms). In high precision mode the timer thread sleeps on a timerfd
+// (on Linux) and busy-waits for the last moments before each deadline. This makes timers accurate
+// to a few microseconds at the cost of some CPU time.
+void SetHighPrecisionTimers(bool);
+bool HighPrecisionTimers();
+
+// Histogram of timer delivery errors - the time between the scheduled deadline and the moment when
+// the timer notification was sent to the Automat thread.
+using TimerJitter = LatencyHistogram;
+
+TimerJitter GetTimerJitter();
+void ResetTimerJitter();
+
 }  // namespace automat
\ No newline at end of file
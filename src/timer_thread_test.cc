@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "timer_thread.hh"
+
+#include <gtest/gtest.h>
+
+#include "base.hh"
+#include "library_timer.hh"
+#include "test_base.hh"
+
+using namespace automat;
+using namespace std::chrono_literals;
+
+struct VirtualTimeTest : TestBase {
+  VirtualTimeTest() { time::EnableVirtualTime(); }
+  // Other tests expect the real clock, without the virtual time that passed here.
+  ~VirtualTimeTest() {
+    time::ResetClock();
+    ResetTimers();
+  }
+
+  // Executes the timers as the Automat thread would.
+  void RunTimers() {
+    while (JumpToNextTimer()) {
+      while (auto task = events.try_recv<Task>()) {
+        task->Execute();
+      }
+      RunLoop();
+    }
+  }
+};
+
+TEST_F(VirtualTimeTest, WeekLongTimerDelay) {
+  Location& delay = machine.Create<library::TimerDelay>();
+  delay.As<library::TimerDelay>()->duration.value = 7 * 24h;
+  auto start = time::SteadyNow();
+  delay.ScheduleRun();
+  RunLoop();
+  EXPECT_NE(nullptr, delay.long_running);
+  RunTimers();
+  EXPECT_EQ(nullptr, delay.long_running);
+  EXPECT_GE(delay.last_finished - start, 7 * 24h);
+  EXPECT_LT(delay.last_finished - start, 7 * 24h + 1ms);
+}
+
+TEST_F(VirtualTimeTest, ClockNeverGoesBack) {
+  auto before = time::SteadyNow();
+  time::AdvanceVirtualTime(before + 1h);
+  time::AdvanceVirtualTime(before);
+  EXPECT_EQ(before + 1h, time::SteadyNow());
+  time::DisableVirtualTime();
+  EXPECT_GE(time::SteadyNow(), before + 1h);
+}
@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "timing_wheel.hh"
+
+#include <bit>
+#include <cassert>
+
+namespace automat {
+
+static int Digit(TimingWheel::Tick tick, int level) {
+  return (tick >> (level * TimingWheel::kBits)) & (TimingWheel::kSlots - 1);
+}
+
+void TimingWheel::Link(Entry*& head, Entry& entry) {
+  entry.prev = nullptr;
+  entry.next = head;
+  if (head) {
+    head->prev = &entry;
+  }
+  head = &entry;
+}
+
+void TimingWheel::Place(Entry& entry) {
+  if (entry.tick <= now) {
+    entry.level = kOverdue;
+    Link(overdue, entry);
+    return;
+  }
+  for (int level = 0; level < kLevels; ++level) {
+    int higher = (level + 1) * kBits;
+    if ((entry.tick >> higher) == (now >> higher)) {
+      int slot = Digit(entry.tick, level);
+      entry.level = level;
+      entry.slot = slot;
+      Link(slots[level][slot], entry);
+      occupied[level] |= uint64_t(1) << slot;
+      return;
+    }
+  }
+  entry.level = kOverflow;
+  Link(overflow, entry);
+}
+
+void TimingWheel::Insert(Entry& entry, Tick tick) {
+  assert(!entry.IsLinked());
+  entry.tick = tick;
+  Place(entry);
+  ++size;
+}
+
+void TimingWheel::Remove(Entry& entry) {
+  assert(entry.IsLinked());
+  Entry** head;
+  if (entry.level == kOverdue) {
+    head = &overdue;
+  } else if (entry.level == kOverflow) {
+    head = &overflow;
+  } else {
+    head = &slots[entry.level][entry.slot];
+  }
+  if (entry.prev) {
+    entry.prev->next = entry.next;
+  } else {
+    *head = entry.next;
+  }
+  if (entry.next) {
+    entry.next->prev = entry.prev;
+  }
+  if (*head == nullptr && entry.level >= 0) {
+    occupied[entry.level] &= ~(uint64_t(1) << entry.slot);
+  }
+  entry.prev = entry.next = nullptr;
+  entry.level = kUnlinked;
+  --size;
+}
+
+TimingWheel::Tick TimingWheel::NextTick() const {
+  if (overdue) {
+    return now;
+  }
+  // Slots at lower levels always come before the slots at higher levels so the first non-empty
+  // level determines the result.
+  for (int level = 0; level < kLevels; ++level) {
+    int digit = Digit(now, level);
+    uint64_t later = digit == kSlots - 1 ? 0 : occupied[level] & (~uint64_t(0) << (digit + 1));
+    if (later) {
+      int higher = (level + 1) * kBits;
+      Tick base = (now >> higher) << higher;
+      return base | (Tick(std::countr_zero(later)) << (level * kBits));
+    }
+  }
+  if (overflow) {
+    int top = kLevels * kBits;
+    return ((now >> top) + 1) << top;
+  }
+  return kNever;
+}
+
+void TimingWheel::Cascade(Entry* list) {
+  while (list) {
+    Entry* entry = list;
+    list = list->next;
+    Place(*entry);
+  }
+}
+
+void TimingWheel::Advance(Tick new_now, maf::Fn<void(Entry&)> expired) {
+  while (true) {
+    Tick next = NextTick();
+    if (next > new_now) {
+      break;
+    }
+    now = next;
+    // Redistribute the slots that start at the current tick - from the top level down so that the
+    // cascaded entries can be cascaded again by the lower levels.
+    int top = kLevels * kBits;
+    if (overflow && (now & ((Tick(1) << top) - 1)) == 0) {
+      Entry* list = overflow;
+      overflow = nullptr;
+      Cascade(list);
+    }
+    for (int level = kLevels - 1; level > 0; --level) {
+      if ((now & ((Tick(1) << (level * kBits)) - 1)) != 0) {
+        continue;  // not at the start of a slot at this level
+      }
+      int slot = Digit(now, level);
+      if (occupied[level] & (uint64_t(1) << slot)) {
+        Entry* list = slots[level][slot];
+        slots[level][slot] = nullptr;
+        occupied[level] &= ~(uint64_t(1) << slot);
+        Cascade(list);
+      }
+    }
+    // Level 0 entries of the current slot (and the cascaded ones) are due now.
+    int slot = Digit(now, 0);
+    if (occupied[0] & (uint64_t(1) << slot)) {
+      Entry* list = slots[0][slot];
+      slots[0][slot] = nullptr;
+      occupied[0] &= ~(uint64_t(1) << slot);
+      while (list) {
+        Entry* entry = list;
+        list = list->next;
+        entry->level = kOverdue;
+        Link(overdue, *entry);
+      }
+    }
+    while (overdue) {
+      Entry* entry = overdue;
+      Remove(*entry);
+      expired(*entry);
+    }
+  }
+  if (new_now > now) {
+    now = new_now;
+  }
+}
+
+}  // namespace automat
@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include "fn.hh"
+
+namespace automat {
+
+// Hierarchical timing wheel.
+//
+// Keeps track of deadlines expressed in integer ticks. Insertion & removal are O(1). Finding the
+// next deadline is O(kLevels) thanks to per-level occupancy bitmasks.
+//
+// The wheel has kLevels levels, each with kSlots slots. Slot `s` at level `L` holds entries whose
+// tick has digit `s` at position `L` (in base kSlots) and shares all of the higher digits with
+// the current tick. When the current tick reaches the start of a slot at a higher level, its
+// entries are cascaded into the lower levels. Entries that don't fit within the top level are kept
+// on an overflow list until the top level wraps around.
+//
+// Entries are intrusive - the wheel doesn't allocate any memory on its own.
+//
+// Not thread-safe.
+struct TimingWheel {
+  using Tick = int64_t;
+
+  static constexpr int kBits = 6;
+  static constexpr int kSlots = 1 << kBits;
+  static constexpr int kLevels = 6;
+  static constexpr Tick kNever = std::numeric_limits<Tick>::max();
+
+  struct Entry {
+    Tick tick = 0;
+    Entry* prev = nullptr;
+    Entry* next = nullptr;
+    int8_t level = kUnlinked;
+    uint8_t slot = 0;
+
+    bool IsLinked() const { return level != kUnlinked; }
+  };
+
+  TimingWheel(Tick now = 0) : now(now) {}
+
+  // Schedule the entry to expire at the given tick. Entries scheduled in the past will expire
+  // during the next call to `Advance`.
+  void Insert(Entry&, Tick tick);
+
+  // Unschedule the entry. Entry must be linked.
+  void Remove(Entry&);
+
+  // Advance the current tick & call `expired` for every entry whose tick is lower or equal to
+  // `new_now`. Entries are unlinked before the callback so it's fine to delete them there.
+  void Advance(Tick new_now, maf::Fn<void(Entry&)> expired);
+
+  // Returns the next tick at which `Advance` may expire or cascade some entries. This is a lower
+  // bound of the earliest deadline. Returns kNever if the wheel is empty.
+  Tick NextTick() const;
+
+  Tick Now() const { return now; }
+  bool Empty() const { return size == 0; }
+  int Size() const { return size; }
+
+ private:
+  static constexpr int8_t kUnlinked = -1;
+  static constexpr int8_t kOverdue = -2;
+  static constexpr int8_t kOverflow = -3;
+
+  Tick now;
+  int size = 0;
+  Entry* slots[kLevels][kSlots] = {};
+  uint64_t occupied[kLevels] = {};
+  Entry* overdue = nullptr;
+  Entry* overflow = nullptr;
+
+  void Link(Entry*& head, Entry&);
+  void Place(Entry&);
+  void Cascade(Entry* list);
+};
+
+}  // namespace automat
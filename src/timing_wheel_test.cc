@@ -0,0 +1,172 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "timing_wheel.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace automat;
+
+using Tick = TimingWheel::Tick;
+
+TEST(TimingWheelTest, ExpiresInOrderOfTicks) {
+  TimingWheel wheel(1000);
+  TimingWheel::Entry a, b, c;
+  wheel.Insert(a, 1005);
+  wheel.Insert(b, 1000 + 64 * 64 + 3);  // two levels up
+  wheel.Insert(c, 1070);
+  std::vector<TimingWheel::Entry*> expired;
+  auto collect = [&](TimingWheel::Entry& e) { expired.push_back(&e); };
+  wheel.Advance(1004, collect);
+  EXPECT_TRUE(expired.empty());
+  wheel.Advance(1005, collect);
+  ASSERT_EQ(expired.size(), 1);
+  EXPECT_EQ(expired[0], &a);
+  wheel.Advance(1069, collect);
+  EXPECT_EQ(expired.size(), 1);
+  wheel.Advance(10000, collect);
+  ASSERT_EQ(expired.size(), 3);
+  EXPECT_EQ(expired[1], &c);
+  EXPECT_EQ(expired[2], &b);
+  EXPECT_TRUE(wheel.Empty());
+  EXPECT_EQ(wheel.NextTick(), TimingWheel::kNever);
+}
+
+TEST(TimingWheelTest, Remove) {
+  TimingWheel wheel;
+  TimingWheel::Entry a, b;
+  wheel.Insert(a, 100);
+  wheel.Insert(b, 100);
+  wheel.Remove(a);
+  EXPECT_FALSE(a.IsLinked());
+  int expired = 0;
+  wheel.Advance(100, [&](TimingWheel::Entry& e) {
+    EXPECT_EQ(&e, &b);
+    ++expired;
+  });
+  EXPECT_EQ(expired, 1);
+}
+
+TEST(TimingWheelTest, PastAndFarFutureDeadlines) {
+  TimingWheel wheel(1'000'000);
+  TimingWheel::Entry past, far;
+  wheel.Insert(past, 5);
+  Tick far_tick = Tick(1) << (TimingWheel::kLevels * TimingWheel::kBits + 3);
+  wheel.Insert(far, far_tick);
+  EXPECT_EQ(wheel.NextTick(), 1'000'000);
+  std::vector<Tick> expired;
+  auto collect = [&](TimingWheel::Entry& e) { expired.push_back(e.tick); };
+  wheel.Advance(1'000'000, collect);
+  EXPECT_EQ(expired, std::vector<Tick>{5});
+  wheel.Advance(far_tick - 1, collect);
+  EXPECT_EQ(expired.size(), 1);
+  wheel.Advance(far_tick, collect);
+  EXPECT_EQ(expired, (std::vector<Tick>{5, far_tick}));
+}
+
+TEST(TimingWheelTest, MatchesSortedOrder) {
+  std::mt19937_64 rng(1234);
+  TimingWheel wheel(rng() % 1'000'000);
+  constexpr int kEntries = 10000;
+  std::vector<TimingWheel::Entry> entries(kEntries);
+  std::multiset<Tick> expected;
+  for (auto& entry : entries) {
+    // Mix of short & long deadlines to exercise all of the levels.
+    Tick delay = rng() % (Tick(1) << (rng() % 40));
+    wheel.Insert(entry, wheel.Now() + delay);
+    expected.insert(entry.tick);
+  }
+  for (int i = 0; i < kEntries; i += 3) {
+    expected.erase(expected.find(entries[i].tick));
+    wheel.Remove(entries[i]);
+  }
+  std::vector<Tick> expired;
+  Tick now = wheel.Now();
+  while (!wheel.Empty()) {
+    // Jump straight to the next deadline, sometimes overshooting it.
+    Tick next = wheel.NextTick();
+    ASSERT_GE(next, now);
+    now = next + (rng() % 4 == 0 ? rng() % 100 : 0);
+    wheel.Advance(now, [&](TimingWheel::Entry& e) {
+      EXPECT_LE(e.tick, now);
+      expired.push_back(e.tick);
+    });
+  }
+  EXPECT_TRUE(std::is_sorted(expired.begin(), expired.end()));
+  EXPECT_EQ(expired, std::vector<Tick>(expected.begin(), expected.end()));
+}
+
+// Benchmark against the std::multimap that timer_thread.cc used before the timing wheel. Disabled by
+// default - run with `--gtest_also_run_disabled_tests --gtest_filter=*Benchmark*`.
+TEST(TimingWheelTest, DISABLED_Benchmark100k) {
+  using Clock = std::chrono::steady_clock;
+  constexpr int kTimers = 100'000;
+  constexpr int kCancels = 100;
+  std::mt19937_64 rng(42);
+  std::vector<Tick> ticks(kTimers);
+  for (auto& tick : ticks) {
+    tick = 1 + rng() % 600'000;  // up to 1 minute at 100us ticks
+  }
+  std::vector<int> cancels(kCancels);
+  for (auto& cancel : cancels) {
+    cancel = rng() % kTimers;
+  }
+  auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+  // Multimap. Each timer is identified by an owner pointer, just like Locations.
+  std::multimap<Tick, int*> map;
+  std::vector<int> owners(kTimers);
+  auto t0 = Clock::now();
+  for (int i = 0; i < kTimers; ++i) {
+    map.emplace(ticks[i], &owners[i]);
+  }
+  auto t1 = Clock::now();
+  for (int i : cancels) {
+    for (auto it = map.begin(); it != map.end();) {  // CancelScheduledAt(Location&)
+      if (it->second == &owners[i]) {
+        it = map.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  auto t2 = Clock::now();
+  int map_expired = 0;
+  while (!map.empty()) {
+    map.erase(map.begin());
+    ++map_expired;
+  }
+  auto t3 = Clock::now();
+
+  // Timing wheel.
+  TimingWheel wheel;
+  std::vector<TimingWheel::Entry> entries(kTimers);
+  auto w0 = Clock::now();
+  for (int i = 0; i < kTimers; ++i) {
+    wheel.Insert(entries[i], ticks[i]);
+  }
+  auto w1 = Clock::now();
+  for (int i : cancels) {
+    if (entries[i].IsLinked()) {
+      wheel.Remove(entries[i]);
+    }
+  }
+  auto w2 = Clock::now();
+  int wheel_expired = 0;
+  while (!wheel.Empty()) {
+    wheel.Advance(wheel.NextTick(), [&](TimingWheel::Entry&) { ++wheel_expired; });
+  }
+  auto w3 = Clock::now();
+
+  EXPECT_EQ(map_expired, wheel_expired);
+  printf("%d timers      insert [ms]  %d cancels [ms]  expire [ms]\n", kTimers, kCancels);
+  printf("multimap      %11.2f  %15.2f  %11.2f\n", ms(t1 - t0), ms(t2 - t1), ms(t3 - t2));
+  printf("timing wheel  %11.2f  %15.2f  %11.2f\n", ms(w1 - w0), ms(w2 - w1), ms(w3 - w2));
+}
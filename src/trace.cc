@@ -0,0 +1,204 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "trace.hh"
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+#include "base.hh"
+#include "virtual_fs.hh"
+
+using namespace maf;
+
+namespace automat::trace {
+
+std::atomic<bool> enabled = false;
+
+namespace {
+
+struct Event {
+  // Index (plus one) of the event stored in this slot. Written last so that readers can detect
+  // slots that are being overwritten.
+  std::atomic<uint64_t> seq = 0;
+  int64_t begin_ns;
+  int64_t end_ns;
+  const std::type_info* type;
+  uint32_t thread;
+  int32_t queue_depth;
+  char target[sizeof(TaskScope::target)];
+};
+
+struct Ring {
+  std::unique_ptr<Event[]> events;
+  size_t capacity;
+  std::atomic<uint64_t> next = 0;
+
+  Ring(size_t capacity) : events(new Event[capacity]), capacity(capacity) {}
+};
+
+std::mutex ring_mutex;
+std::atomic<Ring*> ring = nullptr;
+// Rings are never freed because other threads may still be writing to them.
+std::vector<std::unique_ptr<Ring>> rings;
+
+std::atomic<uint32_t> next_thread = 0;
+thread_local uint32_t thread_index = next_thread.fetch_add(1, std::memory_order_relaxed);
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string TypeName(const std::type_info& type) {
+  std::string name = type.name();
+#if __has_include(<cxxabi.h>)
+  int status = 0;
+  if (char* demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status)) {
+    name = demangled;
+    free(demangled);
+  }
+#endif
+  // "automat::UpdateTask" => "UpdateTask"
+  if (auto pos = name.rfind("::"); pos != std::string::npos) {
+    name = name.substr(pos + 2);
+  }
+  return name;
+}
+
+}  // namespace
+
+void Start(size_t capacity) {
+  std::lock_guard lock(ring_mutex);
+  enabled = false;
+  Ring* r = ring.load();
+  if (r == nullptr || r->capacity != capacity) {
+    r = rings.emplace_back(new Ring(capacity)).get();
+  } else {
+    for (size_t i = 0; i < r->capacity; ++i) {
+      r->events[i].seq.store(0, std::memory_order_relaxed);
+    }
+    r->next = 0;
+  }
+  ring = r;
+  enabled = true;
+}
+
+void Stop() { enabled = false; }
+
+uint64_t RecordedEvents() {
+  Ring* r = ring.load(std::memory_order_acquire);
+  return r ? r->next.load(std::memory_order_relaxed) : 0;
+}
+
+TaskScope::TaskScope(Task& task, size_t queue_depth) : active(Enabled()) {
+  if (!active) {
+    return;
+  }
+  this->queue_depth = queue_depth;
+  type = &typeid(task);
+  std::string_view name;
+  if (task.target) {
+    name = task.target->name;
+    if (name.empty() && task.target->object) {
+      name = task.target->object->Name();
+    }
+  }
+  size_t n = std::min(name.size(), sizeof(target) - 1);
+  memcpy(target, name.data(), n);
+  target[n] = 0;
+  begin_ns = NowNs();
+}
+
+TaskScope::~TaskScope() {
+  if (!active) {
+    return;
+  }
+  int64_t end_ns = NowNs();
+  Ring* r = ring.load(std::memory_order_acquire);
+  if (r == nullptr) {
+    return;
+  }
+  uint64_t index = r->next.fetch_add(1, std::memory_order_relaxed);
+  Event& event = r->events[index % r->capacity];
+  event.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  event.begin_ns = begin_ns;
+  event.end_ns = end_ns;
+  event.type = type;
+  event.thread = thread_index;
+  event.queue_depth = queue_depth;
+  memcpy(event.target, target, sizeof(target));
+  event.seq.store(index + 1, std::memory_order_release);
+}
+
+std::string ToJSON() {
+  rapidjson::StringBuffer sb;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+  writer.StartObject();
+  writer.Key("displayTimeUnit");
+  writer.String("ns");
+  writer.Key("traceEvents");
+  writer.StartArray();
+  if (Ring* r = ring.load(std::memory_order_acquire)) {
+    uint64_t end = r->next.load(std::memory_order_acquire);
+    uint64_t begin = end > r->capacity ? end - r->capacity : 0;
+    for (uint64_t index = begin; index < end; ++index) {
+      Event& slot = r->events[index % r->capacity];
+      if (slot.seq.load(std::memory_order_acquire) != index + 1) {
+        continue;  // still being written or already overwritten
+      }
+      Event event;
+      event.begin_ns = slot.begin_ns;
+      event.end_ns = slot.end_ns;
+      event.type = slot.type;
+      event.thread = slot.thread;
+      event.queue_depth = slot.queue_depth;
+      memcpy(event.target, slot.target, sizeof(event.target));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != index + 1) {
+        continue;
+      }
+      writer.StartObject();
+      writer.Key("name");
+      writer.String(TypeName(*event.type).c_str());
+      writer.Key("cat");
+      writer.String("task");
+      writer.Key("ph");
+      writer.String("X");
+      writer.Key("ts");
+      writer.Double(event.begin_ns / 1000.0);
+      writer.Key("dur");
+      writer.Double((event.end_ns - event.begin_ns) / 1000.0);
+      writer.Key("pid");
+      writer.Uint(1);
+      writer.Key("tid");
+      writer.Uint(event.thread);
+      writer.Key("args");
+      writer.StartObject();
+      writer.Key("target");
+      writer.String(event.target);
+      writer.Key("queue_depth");
+      writer.Int(event.queue_depth);
+      writer.EndObject();
+      writer.EndObject();
+    }
+  }
+  writer.EndArray();
+  writer.EndObject();
+  return sb.GetString();
+}
+
+void Dump(const Path& path, Status& status) { fs::real.Write(path, ToJSON(), status); }
+
+}  // namespace automat::trace
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+
+#include "path.hh"
+#include "status.hh"
+
+namespace automat {
+struct Task;
+}  // namespace automat
+
+// Low-overhead tracing of task execution.
+//
+// While tracing is enabled, every executed task records its begin & end time, type, target and the
+// depth of the queue it came from into a fixed-size ring buffer. The buffer can be exported as
+// Chrome trace-event JSON and opened in https://ui.perfetto.dev or chrome://tracing.
+//
+// Unlike `LogTasksGuard`, nothing is formatted while tracing. Each task costs a couple of clock
+// reads and a short copy.
+namespace automat::trace {
+
+extern std::atomic<bool> enabled;
+
+inline bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+// Starts recording. Previously recorded events are discarded. Only the most recent `capacity`
+// events are kept.
+void Start(size_t capacity = 1 << 16);
+void Stop();
+
+// Total number of events recorded since the last `Start` (including the overwritten ones).
+uint64_t RecordedEvents();
+
+// Records the execution of a task on the current thread. Does nothing when tracing is disabled.
+//
+// Everything that identifies the task is captured in the constructor because tasks often delete
+// themselves in `Execute`.
+struct TaskScope {
+  bool active;
+  int64_t begin_ns;
+  int32_t queue_depth;
+  const std::type_info* type;
+  char target[40];
+
+  TaskScope(Task&, size_t queue_depth);
+  ~TaskScope();
+};
+
+// Chrome trace-event JSON with the events that are currently in the buffer. Events that are being
+// overwritten while this runs are skipped.
+std::string ToJSON();
+
+void Dump(const maf::Path&, maf::Status&);
+
+}  // namespace automat::trace
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: Copyright 2024 Automat Authors
+// SPDX-License-Identifier: MIT
+#include "trace.hh"
+
+#include <gtest/gtest.h>
+
+#include "base.hh"
+#include "library.hh"
+#include "test_base.hh"
+
+using namespace automat;
+
+struct TraceTest : TestBase {
+  Location& text = machine.Create<Text>("text");
+  Location& observer = machine.Create<Text>("observer");
+  TraceTest() {
+    observer.ObserveUpdates(text);
+    RunLoop();
+  }
+  ~TraceTest() { trace::Stop(); }
+};
+
+TEST_F(TraceTest, RecordsTasks) {
+  trace::Start();
+  text.ScheduleUpdate();
+  RunLoop();
+  trace::Stop();
+  EXPECT_EQ(1, trace::RecordedEvents());
+  auto json = trace::ToJSON();
+  EXPECT_NE(std::string::npos, json.find(R"("name":"UpdateTask")"));
+  EXPECT_NE(std::string::npos, json.find(R"("target":"observer")"));
+  EXPECT_NE(std::string::npos, json.find(R"("ph":"X")"));
+
+  // Nothing is recorded once tracing stops.
+  text.ScheduleUpdate();
+  RunLoop();
+  EXPECT_EQ(1, trace::RecordedEvents());
+}
+
+TEST_F(TraceTest, KeepsMostRecentEvents) {
+  trace::Start(4);
+  for (int i = 0; i < 10; ++i) {
+    text.ScheduleUpdate();
+    RunLoop();
+  }
+  EXPECT_EQ(10, trace::RecordedEvents());
+  auto json = trace::ToJSON();
+  int events = 0;
+  for (size_t pos = 0; (pos = json.find(R"("ph":"X")", pos)) != std::string::npos; ++pos) {
+    ++events;
+  }
+  EXPECT_EQ(4, events);
+}
+
+// Tasks received from other threads are wrapped before they're executed. Only the original task is
+// recorded.
+TEST_F(TraceTest, RecordsEventsOnce) {
+  trace::Start();
+  events.send(std::make_unique<FunctionTask>(&text, [](Location&) {}));
+  RunLoop();
+  trace::Stop();
+  EXPECT_EQ(1, trace::RecordedEvents());
+  EXPECT_NE(std::string::npos, trace::ToJSON().find(R"("name":"FunctionTask")"));
+}
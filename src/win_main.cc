@@ -20,7 +20,6 @@
 #include <memory>
 #include <thread>
 
-#include "automat.hh"
 #include "backtrace.hh"
 #include "hid.hh"
 #include "library.hh"  // IWYU pragma: export
@@ -43,6 +43,7 @@ constexpr float kTrashRadius = 3_cm;
 
 void Window::Draw(SkCanvas& canvas) {
   display.timer.Tick();
+  ++frames_drawn;
   gui::DrawContext draw_ctx(display, canvas, draw_cache);
   draw_ctx.path.push_back(this);
   canvas.save();
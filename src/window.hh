@@ -138,6 +138,7 @@ struct Window final : Widget, DropTarget {
   mutable animation::Display display;
 
   std::deque<float> fps_history;
+  uint64_t frames_drawn = 0;
 
   std::vector<Pointer*> pointers;
   std::vector<Keyboard*> keyboards;
@@ -3,7 +3,7 @@
 # SPDX-License-Identifier: MIT
 
 if __name__ == '__main__':
-  import subprocess, shutil
+  import subprocess, shutil, sys
   from pathlib import Path
 
   root = Path(__file__).parent.parent.resolve()
@@ -16,12 +16,22 @@ if __name__ == '__main__':
   subprocess.run(['python', str(run_path), 'link release_automat.exe'])
   shutil.copy(test_state_path, state_path)
 
-  p = subprocess.Popen([str(automat_path)])
+  # Pass `--precise-timers` to this script to benchmark the high precision timer mode.
+  args = [str(automat_path), '--stats']
+  args += [arg for arg in sys.argv[1:] if arg == '--precise-timers']
+  p = subprocess.Popen(args, stdout=subprocess.PIPE, text=True)
+  jitter = None
+  for line in p.stdout:
+    print(line, end='')
+    if 'Timer jitter: ' in line:
+      jitter = line.split('Timer jitter: ', 1)[1].strip()
   p.wait()
 
   print('Done!')
 
-  # TODO: Analyze resulting `automat_state.json`
-  #    - drop any odd events at the end
-  #    - use the first event as the basis to find expected delivery times
-  #    - calculate the mean squared error
\ No newline at end of file
+  # Automat measures the delivery error of every timer (scheduled time vs the moment when the timer
+  # notification was sent to the Automat thread) and logs a summary on exit (with `--stats`).
+  if jitter:
+    print(f'Timer delivery error: {jitter}')
+  else:
+    print('No timers fired')
@@ -2,7 +2,7 @@
 # SPDX-FileCopyrightText: Copyright 2024 Automat Authors
 # SPDX-License-Identifier: MIT
 
-import shutil, subprocess
+import shutil, subprocess, sys
 from pathlib import Path
 
 tests_path = Path(__file__).parent.resolve()
@@ -12,6 +12,14 @@ run_path = root_path / 'run.py'
 
 # TODO: turn this into build graph
 
+if '--headless' in sys.argv:
+  # Measure task throughput without a display or GPU.
+  subprocess.run(['python', str(run_path), 'link release_automat_headless'], check=True)
+  subprocess.run([str(build_path / 'release_automat_headless'),
+                  '--state', str(tests_path / 'perf_bench.json')],
+                 check=True)
+  sys.exit(0)
+
 shutil.copy(tests_path / 'perf_bench.json', build_path / 'automat_state.json')
 subprocess.run(['python', str(run_path), 'link debug_automat'], check=True)
 subprocess.run(['time', 'perf',  'record', '--call-graph', 'fp', '--user-callchains', 'build/debug_automat'])